@@ -132,6 +132,7 @@ set(header_rpcore_util
     "${PROJECT_SOURCE_DIR}/render_pipeline/rpcore/util/generic.hpp"
     "${PROJECT_SOURCE_DIR}/render_pipeline/rpcore/util/line_node.hpp"
     "${PROJECT_SOURCE_DIR}/render_pipeline/rpcore/util/instancing_node.hpp"
+    "${PROJECT_SOURCE_DIR}/render_pipeline/rpcore/util/frame_profiler.hpp"
     "${PROJECT_SOURCE_DIR}/render_pipeline/rpcore/util/movement_controller.hpp"
     "${PROJECT_SOURCE_DIR}/render_pipeline/rpcore/util/points_node.hpp"
     "${PROJECT_SOURCE_DIR}/render_pipeline/rpcore/util/post_process_region.hpp"
@@ -145,8 +146,10 @@ set(header_rpcore_util
 )
 
 set(header_rplibs
+    "${PROJECT_SOURCE_DIR}/render_pipeline/rplibs/hash.hpp"
     "${PROJECT_SOURCE_DIR}/render_pipeline/rplibs/ordered_map.hpp"
     "${PROJECT_SOURCE_DIR}/render_pipeline/rplibs/py_to_cpp.hpp"
+    "${PROJECT_SOURCE_DIR}/render_pipeline/rplibs/thread_pool.hpp"
 )
 
 set(render_pipeline_headers
@@ -255,6 +258,8 @@ set(source_rpcore
     "${PROJECT_SOURCE_DIR}/src/rpcore/render_target.cpp"
     "${PROJECT_SOURCE_DIR}/src/rpcore/rpobject.cpp"
     "${PROJECT_SOURCE_DIR}/src/rpcore/stage_manager.cpp"
+    "${PROJECT_SOURCE_DIR}/src/rpcore/stage_graph.hpp"
+    "${PROJECT_SOURCE_DIR}/src/rpcore/stage_graph.cpp"
 )
 
 set(source_rpcore_gui
@@ -332,6 +337,7 @@ set(source_rpcore_util
     "${PROJECT_SOURCE_DIR}/src/rpcore/util/cubemap_filter.cpp"
     "${PROJECT_SOURCE_DIR}/src/rpcore/util/display_shader_builder.cpp"
     "${PROJECT_SOURCE_DIR}/src/rpcore/util/display_shader_builder.hpp"
+    "${PROJECT_SOURCE_DIR}/src/rpcore/util/frame_profiler.cpp"
     "${PROJECT_SOURCE_DIR}/src/rpcore/util/generic.cpp"
     "${PROJECT_SOURCE_DIR}/src/rpcore/util/line_node.cpp"
     "${PROJECT_SOURCE_DIR}/src/rpcore/util/ies_profile_loader.cpp"
@@ -343,6 +349,8 @@ set(source_rpcore_util
     "${PROJECT_SOURCE_DIR}/src/rpcore/util/primitives.cpp"
     "${PROJECT_SOURCE_DIR}/src/rpcore/util/rpgeomnode.cpp"
     "${PROJECT_SOURCE_DIR}/src/rpcore/util/rprender_state.cpp"
+    "${PROJECT_SOURCE_DIR}/src/rpcore/util/shader_define_tracker.cpp"
+    "${PROJECT_SOURCE_DIR}/src/rpcore/util/shader_define_tracker.hpp"
     "${PROJECT_SOURCE_DIR}/src/rpcore/util/shader_input_blocks.cpp"
     "${PROJECT_SOURCE_DIR}/src/rpcore/util/smooth_connected_curve.hpp"
     "${PROJECT_SOURCE_DIR}/src/rpcore/util/smooth_connected_curve.cpp"
@@ -351,6 +359,7 @@ set(source_rpcore_util
 )
 
 set(source_rplibs
+    "${PROJECT_SOURCE_DIR}/src/rplibs/thread_pool.cpp"
     "${PROJECT_SOURCE_DIR}/src/rplibs/yaml.cpp"
     "${PROJECT_SOURCE_DIR}/src/rplibs/yaml.hpp"
 )
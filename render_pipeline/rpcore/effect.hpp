@@ -59,8 +59,38 @@ public:
 
 public:
     static std::shared_ptr<Effect> load(RenderPipeline& pipeline, const Filename& filename, const OptionType& options);
+
+    /**
+     * Loads many effects at once. The sources of the shaders of the effects
+     * which are not loaded yet are constructed on the worker threads. The
+     * files are read and written, and the shader objects are created on the
+     * calling thread.
+     *
+     * The result has the same order as @p sources, and has nullptr for the
+     * effects which could not be loaded.
+     */
+    static std::vector<std::shared_ptr<Effect>> load_many(RenderPipeline& pipeline, const std::vector<SourceType>& sources);
+
+    /**
+     * Removes the loaded effects and the parsed templates from the cache,
+     * so that the next load reads and generates them again.
+     */
+    static void clear_cache();
+
+    /** Returns the paths of the shaders generated for the loaded effects. */
+    static std::vector<Filename> get_cached_shader_files();
+
     static const OptionType& get_default_options();
 
+    /** Returns the number of loads which returned an effect that was already loaded. */
+    static size_t get_num_memory_cache_hits();
+
+    /** Returns the number of loads which reused the shaders generated in a previous run. */
+    static size_t get_num_disk_cache_hits();
+
+    /** Returns the number of loads which generated the shaders from the templates. */
+    static size_t get_num_cache_misses();
+
     static const std::vector<PassType>& get_passes();
     static void add_pass(const PassType& pass, bool flag);
 
@@ -119,6 +119,9 @@ public:
 
     GPUCommandQueue* get_cmd_queue() const;
 
+    /** Returns the internal light manager, ex) to query the shadow update statistics. */
+    InternalLightManager* get_internal_mgr() const;
+
 private:
     RenderPipeline& pipeline_;
     LVecBase2i tile_size_;
@@ -150,4 +153,9 @@ inline GPUCommandQueue* LightManager::get_cmd_queue() const
     return cmd_queue_.get();
 }
 
+inline InternalLightManager* LightManager::get_internal_mgr() const
+{
+    return internal_mgr_.get();
+}
+
 }
@@ -62,12 +62,16 @@ public:
     /**
      * Loads a texture from the given filename and dimensions. If only
      * one dimensions is specified, the other dimensions are assumed to be
-     * equal. This internally loads the texture into ram, splits it into smaller
-     * sub-images, and then calls the load_3d_texture from the Panda loader
+     * equal. This internally loads the texture into ram, and copies the
+     * sub-images to the pages of a 3D texture. The 3D texture is stored
+     * as txo in the write path and loaded from it while the source is unchanged.
      */
     static Texture* load_sliced_3d_texture(const Filename& filename, int tile_size_x, int tile_size_y, int num_tiles);
 
     RPLoader();
+
+private:
+    static constexpr const char* sliced_texture_cache_dir_ = "/$$rptemp/texture_cache";
 };
 
 // ************************************************************************************************
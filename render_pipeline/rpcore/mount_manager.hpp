@@ -45,6 +45,15 @@ public:
     const Filename& get_write_path() const;
     void set_write_path(const Filename& pth);
 
+    /**
+     * Returns true if /$$rptemp is mounted on a directory of the file system,
+     * so that the caches written there are kept for the next run.
+     *
+     * Without a write path, /$$rptemp is a ramdisk and the disk caches are
+     * not used.
+     */
+    static bool is_write_path_persistent();
+
     const Filename& get_base_path() const;
 
     /**
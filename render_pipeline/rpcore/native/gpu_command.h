@@ -78,11 +78,16 @@ class GPUCommand
 
         inline static bool get_uses_integer_packing();
 
+        inline CommandType get_command_type() const;
+        inline int get_int(size_t index) const;
+        inline const float* get_data() const;
+
         void write_to(const PTA_uchar &dest, size_t command_index);
         void write(std::ostream &out) const;
 
     private:
         inline float convert_int_to_float(int v) const;
+        inline int convert_float_to_int(float v) const;
 
         CommandType _command_type;
         size_t _current_index;
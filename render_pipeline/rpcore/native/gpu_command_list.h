@@ -30,7 +30,10 @@
 #include "pandabase.h"
 #include "gpu_command.h"
 
-#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include <render_pipeline/rpcore/config.hpp>
 
 namespace rpcore {
 
@@ -38,8 +41,15 @@ namespace rpcore {
  * @brief Class to store a list of commands.
  * @details This is a class to store a list of GPUCommands. It provides
  *   functionality to only provide the a given amount of commands at one time.
+ *
+ *   The commands are stored in a ring buffer with the same layout as the
+ *   command buffer on the GPU, so they can be copied with a single memcpy
+ *   (or two, when the ring buffer wraps around).
+ *
+ *   When a light is stored several times before the command got written,
+ *   only the last data is kept, see GPUCommandList::add_command.
  */
-class GPUCommandList
+class RENDER_PIPELINE_DECL GPUCommandList
 {
     PUBLISHED:
         GPUCommandList();
@@ -48,10 +58,28 @@ class GPUCommandList
         size_t get_num_commands();
         size_t write_commands_to(const PTA_uchar &dest, size_t limit = 32);
 
+        size_t get_num_coalesced_commands() const;
+
         MAKE_PROPERTY(num_commands, get_num_commands);
+        MAKE_PROPERTY(num_coalesced_commands, get_num_coalesced_commands);
 
     protected:
-        std::queue<GPUCommand> _commands;
+        float* get_command_data(size_t sequence);
+        void grow_storage();
+
+        // Ring buffer of commands, each with GPU_COMMAND_ENTRIES floats
+        std::vector<float> _data;
+        size_t _capacity;
+        size_t _head;
+        size_t _num_commands;
+
+        // Number of commands written so far, which is also the sequence
+        // number of the first command in the ring buffer.
+        size_t _num_written;
+
+        // Sequence numbers of queued CMD_store_light commands, per light slot
+        std::unordered_map<int, size_t> _queued_light_stores;
+        size_t _num_coalesced;
 };
 
 }
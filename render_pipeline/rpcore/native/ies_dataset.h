@@ -32,6 +32,8 @@
 #include "texture.h"
 #include "pnmImage.h"
 
+#include <render_pipeline/rpcore/config.hpp>
+
 NotifyCategoryDecl(iesdataset, EXPORT_CLASS, EXPORT_TEMPL);
 
 namespace rpcore {
@@ -44,7 +46,7 @@ namespace rpcore {
  *   and horizontal angles, as well as a set of candela values, which then are
  *   lineary interpolated onto a 2D LUT Texture.
  */
-class IESDataset
+class RENDER_PIPELINE_DECL IESDataset
 {
     PUBLISHED:
         IESDataset();
@@ -54,6 +56,7 @@ class IESDataset
         void set_candela_values(const PTA_float &candela_values);
 
         void generate_dataset_texture_into(Texture* dest_tex, size_t z) const;
+        void generate_dataset_image(PNMImage& dest) const;
 
     public:
         float get_candela_value(float vertical_angle, float horizontal_angle) const;
@@ -61,6 +64,21 @@ class IESDataset
         float get_vertical_candela_value(size_t horizontal_angle_idx, float vertical_angle) const;
 
     private:
+        /**
+         * Position of an angle in the angle array: the index of the upper
+         * enclosing angle and the interpolation factor to it. An index of 0
+         * means that the angle is out of the range, and the value is zero.
+         */
+        struct AngleSample {
+            size_t index;
+            float lerp;
+        };
+
+        AngleSample find_vertical_sample(float vertical_angle) const;
+        AngleSample find_horizontal_sample(float horizontal_angle) const;
+        float sample_vertical(size_t horizontal_angle_idx, const AngleSample& vertical) const;
+        float sample(const AngleSample& vertical, const AngleSample& horizontal) const;
+
         PTA_float _vertical_angles;
         PTA_float _horizontal_angles;
         PTA_float _candela_values;
@@ -35,6 +35,8 @@
 #include "pointer_slot_storage.h"
 #include "gpu_command_list.h"
 
+#include <array>
+
 #define MAX_LIGHT_COUNT 65535
 #define MAX_SHADOW_SOURCES 2048
 
@@ -49,7 +51,7 @@ namespace rpcore {
  *   the light and shadow slots, and also communicates with the GPU with the
  *   GPUCommandQueue to store light and shadow source data.
  */
-class InternalLightManager {
+class RENDER_PIPELINE_DECL InternalLightManager {
     PUBLISHED:
         InternalLightManager();
 
@@ -77,6 +79,29 @@ class InternalLightManager {
 
         inline void set_command_list(GPUCommandList *cmd_list);
 
+    public:
+        /** Statistics of the shadow source updates in the last frame. */
+        struct ShadowUpdateStats {
+            static constexpr size_t NUM_AGE_BUCKETS = 8;
+
+            // Dirty sources in the update distance
+            size_t num_candidates = 0;
+            size_t num_updated = 0;
+
+            // Candidates which did not fit into the update slots or tiles
+            size_t num_skipped = 0;
+
+            // Atlas tiles of the updated sources
+            size_t num_update_tiles = 0;
+
+            // Skipped sources by frames since their last update. Bucket 0 has
+            // 0 ~ 1 frames, and bucket k has 2^k ~ 2^(k+1)-1 frames. The last
+            // bucket has all older sources.
+            std::array<size_t, NUM_AGE_BUCKETS> stale_age_histogram{};
+        };
+
+        inline const ShadowUpdateStats& get_shadow_update_stats() const;
+
     protected:
         void gpu_update_light(RPLight* light);
         void gpu_update_source(ShadowSource* source);
@@ -85,6 +110,13 @@ class InternalLightManager {
 
         void setup_shadows(RPLight* light);
         bool compare_shadow_sources(const ShadowSource* a, const ShadowSource* b) const;
+        PN_stdfloat compute_shadow_score(const ShadowSource* source, size_t cost) const;
+
+        struct ShadowSourceCandidate {
+            ShadowSource* source;
+            size_t cost;
+            PN_stdfloat score;
+        };
 
         void update_lights();
         void update_shadow_sources();
@@ -97,6 +129,9 @@ class InternalLightManager {
 
         LPoint3 _camera_pos;
         PN_stdfloat _shadow_update_distance;
+
+        size_t _frame_index;
+        ShadowUpdateStats _shadow_update_stats;
 };
 
 }
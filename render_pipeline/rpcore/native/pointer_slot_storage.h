@@ -38,22 +38,66 @@ class PointerSlotStorage {};
 
 
 #include "pandabase.h"
+
+#include <algorithm>
 #include <array>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 namespace rpcore {
 
+namespace pointer_slot_storage_detail {
+
+/** Returns the index of the lowest set bit. @p value must not be zero. */
+inline int find_lowest_bit(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+/** Returns the index of the highest set bit. @p value must not be zero. */
+inline int find_highest_bit(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+}
+
 /**
  * @brief Class to keep a list of pointers and nullpointers.
  * @details This class stores a fixed size list of pointers, whereas pointers
  *   may be a nullptr as well. It provides functionality to find free slots,
  *   and also to find free consecutive slots, as well as taking care of reserving slots.
  *
+ *   Besides the pointers, a bitmask of used slots is kept, so that searching
+ *   free slots works on 64 slots at once instead of testing each pointer.
+ *
  * @tparam T* Pointer-Type
  * @tparam SIZE Size of the storage
  */
 template < typename T, int SIZE >
 class PointerSlotStorage
 {
+    static_assert(SIZE > 0, "PointerSlotStorage requires at least one slot.");
+
+    static constexpr int BITS_PER_WORD = 64;
+    static constexpr int NUM_WORDS = (SIZE + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    static constexpr uint64_t FULL_WORD = ~uint64_t(0);
+
 public:
     /**
      * @brief Constructs a new PointerSlotStorage
@@ -62,7 +106,16 @@ public:
      */
     PointerSlotStorage() {
         _data.fill(nullptr);
-        _max_index = 0;
+        _used_mask.fill(0);
+
+        // Mark the padding bits of the last word as used, so they are never
+        // returned as free slots.
+        const int num_padding_bits = NUM_WORDS * BITS_PER_WORD - SIZE;
+        if (num_padding_bits > 0) {
+            _used_mask[NUM_WORDS - 1] = FULL_WORD << (BITS_PER_WORD - num_padding_bits);
+        }
+
+        _max_index = -1;
         _num_entries = 0;
     }
 
@@ -101,9 +154,9 @@ public:
      * @return true if a slot was found, otherwise false
      */
     bool find_slot(int &slot) const {
-        for (int i = 0; i < SIZE; ++i) {
-            if (_data[i] == nullptr) {
-                slot = i;
+        for (int w = 0; w < NUM_WORDS; ++w) {
+            if (_used_mask[w] != FULL_WORD) {
+                slot = w * BITS_PER_WORD + pointer_slot_storage_detail::find_lowest_bit(~_used_mask[w]);
                 return true;
             }
         }
@@ -133,15 +186,60 @@ public:
             return find_slot(slot);
         }
 
-        // Try to find consecutive slots otherwise
-        for (int i = 0; i < SIZE; ++i) {
-            bool any_taken = false;
-            for (int k = 0; !any_taken && k < num_consecutive; ++k) {
-                any_taken = _data[i + k] != nullptr;
+        // Walk over the runs of free bits. A run may span over multiple words.
+        int run_start = 0;
+        int run_length = 0;
+        for (int w = 0; w < NUM_WORDS; ++w) {
+            const uint64_t free_bits = ~_used_mask[w];
+
+            if (free_bits == 0) {
+                run_length = 0;
+                continue;
             }
-            if (!any_taken) {
-                slot = i;
-                return true;
+
+            if (free_bits == FULL_WORD) {
+                if (run_length == 0)
+                    run_start = w * BITS_PER_WORD;
+                run_length += BITS_PER_WORD;
+                if (run_length >= num_consecutive) {
+                    slot = run_start;
+                    return true;
+                }
+                continue;
+            }
+
+            int bit = 0;
+            while (bit < BITS_PER_WORD) {
+                const uint64_t remaining = free_bits >> bit;
+                if (remaining == 0) {
+                    // only used slots are left in this word
+                    run_length = 0;
+                    break;
+                }
+
+                if ((remaining & 1) == 0) {
+                    // skip used slots, which breaks the current run
+                    run_length = 0;
+                    bit += pointer_slot_storage_detail::find_lowest_bit(remaining);
+                    continue;
+                }
+
+                // length of the free run, "~remaining" is never zero because
+                // the shift fills in used bits from the top
+                const int length = (std::min)(pointer_slot_storage_detail::find_lowest_bit(~remaining), BITS_PER_WORD - bit);
+                if (run_length == 0)
+                    run_start = w * BITS_PER_WORD + bit;
+                run_length += length;
+                if (run_length >= num_consecutive) {
+                    slot = run_start;
+                    return true;
+                }
+
+                bit += length;
+
+                // the run only continues in the next word when it reaches the end
+                if (bit < BITS_PER_WORD)
+                    run_length = 0;
             }
         }
         return false;
@@ -158,11 +256,12 @@ public:
         nassertv(slot >= 0 && slot < SIZE);
         nassertv(_data[slot] != nullptr); // Slot was already empty!
         _data[slot] = nullptr;
+        _used_mask[slot / BITS_PER_WORD] &= ~(uint64_t(1) << (slot % BITS_PER_WORD));
         _num_entries--;
 
         // Update maximum index
         if (slot == _max_index) {
-            while (_max_index >= 0 && !_data[_max_index--]) {}
+            update_max_index(slot / BITS_PER_WORD);
         }
     }
 
@@ -196,6 +295,7 @@ public:
         nassertv(ptr != nullptr); // nullptr passed as argument!
         _max_index = (std::max)(_max_index, slot);
         _data[slot] = ptr;
+        _used_mask[slot / BITS_PER_WORD] |= uint64_t(1) << (slot % BITS_PER_WORD);
         _num_entries++;
     }
 
@@ -229,9 +329,31 @@ public:
     }
 
 private:
+    /**
+     * @brief Searches the new maximum index
+     * @details This searches the highest used slot, starting at the given word
+     *   and going downwards. The padding bits of the last word are ignored.
+     *
+     * @param start_word Word to start the search at
+     */
+    void update_max_index(int start_word) {
+        for (int w = start_word; w >= 0; --w) {
+            uint64_t used_bits = _used_mask[w];
+            if (w == NUM_WORDS - 1 && SIZE % BITS_PER_WORD != 0)
+                used_bits &= (uint64_t(1) << (SIZE % BITS_PER_WORD)) - 1;
+
+            if (used_bits != 0) {
+                _max_index = w * BITS_PER_WORD + pointer_slot_storage_detail::find_highest_bit(used_bits);
+                return;
+            }
+        }
+        _max_index = -1;
+    }
+
     int _max_index;
     size_t _num_entries;
     InternalContainer _data;
+    std::array<uint64_t, NUM_WORDS> _used_mask;
 };
 
 }
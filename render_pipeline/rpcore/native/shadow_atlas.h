@@ -30,6 +30,12 @@
 #include "pandabase.h"
 #include "lvecBase4.h"
 
+#include <cstdint>
+#include <set>
+#include <vector>
+
+#include <render_pipeline/rpcore/config.hpp>
+
 NotifyCategoryDecl(shadowatlas, EXPORT_CLASS, EXPORT_TEMPL);
 
 namespace rpcore {
@@ -38,19 +44,43 @@ namespace rpcore {
  * @brief Class which manages distributing shadow maps in an atlas.
  * @details This class manages the shadow atlas. It handles finding and reserving
  *   space for new shadow maps.
+ *
+ *   The search for free space depends on the AllocationStrategy:
+ *     AS_tile_scan: Scans the tiles for the first free region, which works
+ *       with any region size.
+ *     AS_quadtree: Buddy allocator on a quadtree of power-of-two blocks. Regions
+ *       are padded to the next power-of-two square, so this fits best for
+ *       power-of-two resolutions.
  */
-class ShadowAtlas
+class RENDER_PIPELINE_DECL ShadowAtlas
 {
 PUBLISHED:
-    ShadowAtlas(size_t size, size_t tile_size = 32);
+    enum AllocationStrategy
+    {
+        AS_tile_scan,
+        AS_quadtree,
+    };
+
+    ShadowAtlas(size_t size, size_t tile_size = 32, AllocationStrategy strategy = AS_tile_scan);
     ~ShadowAtlas();
 
+    inline AllocationStrategy get_allocation_strategy() const;
+    MAKE_PROPERTY(allocation_strategy, get_allocation_strategy);
+
     inline int get_num_used_tiles() const;
     inline float get_coverage() const;
 
     MAKE_PROPERTY(num_used_tiles, get_num_used_tiles);
     MAKE_PROPERTY(coverage, get_coverage);
 
+    inline int get_num_wasted_tiles() const;
+    int get_largest_free_region() const;
+    float get_fragmentation() const;
+
+    MAKE_PROPERTY(num_wasted_tiles, get_num_wasted_tiles);
+    MAKE_PROPERTY(largest_free_region, get_largest_free_region);
+    MAKE_PROPERTY(fragmentation, get_fragmentation);
+
 public:
     LVecBase4i find_and_reserve_region(size_t tile_width, size_t tile_height);
     void free_region(const LVecBase4i& region);
@@ -67,12 +97,31 @@ protected:
 
     inline bool region_is_free(size_t x, size_t y, size_t w, size_t h) const;
     void reserve_region(size_t x, size_t y, size_t w, size_t h);
+    void release_region(size_t x, size_t y, size_t w, size_t h);
+
+    inline int find_blocked_row(size_t x, size_t y, size_t w, size_t h) const;
+    LVecBase4i scan_for_region(size_t tile_width, size_t tile_height);
+
+    inline size_t get_block_size(size_t tile_width, size_t tile_height) const;
+    inline size_t get_block_level(size_t block_size) const;
+    inline static uint32_t make_block_key(size_t x, size_t y);
+    LVecBase4i quadtree_find_region(size_t tile_width, size_t tile_height);
+    void quadtree_free_region(const LVecBase4i& region);
 
+    AllocationStrategy _strategy;
     size_t _size;
     size_t _num_tiles;
     size_t _tile_size;
     size_t _num_used_tiles;
-    bool* _flags;
+    size_t _num_wasted_tiles;
+
+    // Bitmask of the reserved tiles, one row of tiles after another.
+    size_t _words_per_row;
+    std::vector<uint64_t> _flags;
+
+    // Free blocks of the quadtree for each level. Level 0 is the whole atlas,
+    // and the block key is encoded with ShadowAtlas::make_block_key.
+    std::vector<std::set<uint32_t>> _free_blocks;
 };
 
 }
@@ -36,6 +36,8 @@
 #include "displayRegion.h"
 #include "graphicsOutput.h"
 
+#include <limits>
+
 #include "tag_state_manager.h"
 #include "shadow_source.h"
 #include "shadow_atlas.h"
@@ -44,13 +46,14 @@ NotifyCategoryDecl(shadowmanager, EXPORT_CLASS, EXPORT_TEMPL);
 
 namespace rpcore {
 
-class ShadowManager  : public ReferenceCount
+class RENDER_PIPELINE_DECL ShadowManager  : public ReferenceCount
 {
     PUBLISHED:
         ShadowManager();
         ~ShadowManager();
 
         inline void set_max_updates(size_t max_updates);
+        inline void set_max_update_tiles(size_t max_update_tiles);
         inline void set_scene(NodePath scene_parent);
         inline void set_tag_state_manager(TagStateManager* tag_mgr);
         inline void set_atlas_graphics_output(GraphicsOutput* graphics_output);
@@ -59,9 +62,16 @@ class ShadowManager  : public ReferenceCount
         inline size_t get_atlas_size() const;
         MAKE_PROPERTY(atlas_size, get_atlas_size, set_atlas_size);
 
+        inline void set_atlas_allocation_strategy(ShadowAtlas::AllocationStrategy strategy);
+        inline ShadowAtlas::AllocationStrategy get_atlas_allocation_strategy() const;
+        MAKE_PROPERTY(atlas_allocation_strategy, get_atlas_allocation_strategy, set_atlas_allocation_strategy);
+
         inline size_t get_num_update_slots_left() const;
         MAKE_PROPERTY(num_update_slots_left, get_num_update_slots_left);
 
+        inline size_t get_num_update_tiles_left() const;
+        MAKE_PROPERTY(num_update_tiles_left, get_num_update_tiles_left);
+
         inline ShadowAtlas* get_atlas() const;
         MAKE_PROPERTY(atlas, get_atlas);
 
@@ -73,7 +83,10 @@ class ShadowManager  : public ReferenceCount
 
     private:
         size_t _max_updates;
+        size_t _max_update_tiles;
+        size_t _num_queued_tiles;
         size_t _atlas_size;
+        ShadowAtlas::AllocationStrategy _atlas_allocation_strategy;
         NodePath _scene_parent;
 
         pvector<PT(Camera)> _cameras;
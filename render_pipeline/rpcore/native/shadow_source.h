@@ -64,6 +64,7 @@ public:
     inline void set_perspective_lens(float fov, float near_plane,
                                      float far_plane, LVecBase3f pos, LVecBase3f direction);
     inline void set_matrix_lens(const LMatrix4f& mvp);
+    inline void set_last_update_frame(size_t frame);
 
     inline bool has_region() const;
     inline bool has_slot() const;
@@ -76,6 +77,7 @@ public:
     inline const LMatrix4f& get_mvp() const;
     inline const LVecBase4i& get_region() const;
     inline const LVecBase4f& get_uv_region() const;
+    inline size_t get_last_update_frame() const;
 
     inline const BoundingSphere& get_bounds() const;
 
@@ -86,6 +88,7 @@ private:
     LMatrix4f _mvp;
     LVecBase4i _region;
     LVecBase4f _region_uv;
+    size_t _last_update_frame;
 
     BoundingSphere _bounds;
 };
@@ -70,6 +70,9 @@ public:
     /** Sets the control points on the curves. */
     void set_control_points(const std::vector<std::vector<LVecBase2>>& control_points);
 
+    /** Returns the number of changes of the control points, to find out when the curves are modified. */
+    size_t get_version() const { return _version; }
+
     /** Serializes the setting to a yaml string. */
     std::string serialize() const;
 
@@ -79,6 +82,7 @@ protected:
     std::string _description;
 
     std::array<SmoothConnectedCurve*, 3> _curves;
+    size_t _version = 0;
 };
 
 /** Setting type storing a single scalar. */
@@ -22,6 +22,8 @@
 
 #pragma once
 
+#include <future>
+
 #include <render_pipeline/rpcore/effect.hpp>
 #include <render_pipeline/rpcore/rpobject.hpp>
 
@@ -45,6 +47,7 @@ namespace rpcore {
 class StageManager;
 class RenderStage;
 class TaskScheduler;
+class FrameProfiler;
 class MountManager;
 class TagStateManager;
 class LightManager;
@@ -67,6 +70,14 @@ public:
 
     static constexpr const char* reload_shaders_event_name = "RP_reload_shaders";
 
+    /** Statistics of the last maintenance of the render and transform state caches. */
+    struct StateCacheStats
+    {
+        int num_states_before = 0;      ///< Number of the cached states before the maintenance.
+        int num_states_after = 0;       ///< Number of the cached states after the maintenance.
+        double duration_ms = 0;         ///< Time spent in the maintenance.
+    };
+
 public:
     static boost::string_view get_version();
     static bool get_version(int& major, int& minor, int& patch);
@@ -105,6 +116,15 @@ public:
      */
     void reload_shaders();
 
+    /**
+     * Reloads only the shaders which use the defines changed after the last
+     * reload, for example by the shader runtime settings of the plugins.
+     * The used defines are found from the shader files and their includes.
+     * The effects are reloaded only if one of them uses a changed define,
+     * and in that case the applied effects are lost as in reload_shaders().
+     */
+    void reload_changed_shaders();
+
     /**
      * Setups all required pipeline settings and configuration which have
      * to be set before the showbase is setup. This is called by create(),
@@ -163,6 +183,14 @@ public:
         const Effect::OptionType& options = {}, int sort = 30);
     void set_effect(const NodePath& nodepath, const Effect::SourceType& source, int sort = 30);
 
+    /**
+     * Sets effects to many nodepaths at once, as set_effect does for each item.
+     * Each item has the nodepath, the effect source and the sort.
+     * The effects which are not loaded yet are generated in parallel, so
+     * use this when a scene with many different effects is loaded.
+     */
+    void set_effects(const std::vector<std::pair<NodePath, std::pair<Effect::SourceType, int>>>& effects);
+
     /**
      * Clear applied effect on the node path.
      */
@@ -192,6 +220,19 @@ public:
      */
     void prepare_scene(const NodePath& scene);
 
+    /**
+     * Same as prepare_scene(), but the scene graph is searched and the geoms
+     * are processed on the thread of the "RP_PrepareScene" task chain while
+     * frames are rendered.
+     * The lights and effects are applied in a task on the main thread, and
+     * the returned future is ready after that.
+     *
+     * The scene must not be attached to the rendered scene graph or be
+     * modified until the future is ready. If the pipeline is destroyed
+     * before, the future has a broken promise.
+     */
+    std::future<void> prepare_scene_async(const NodePath& scene);
+
     void compute_render_resolution(float resolution_scale);
     void compute_render_resolution(int width, int height);
     void compute_render_resolution(float resolution_scale, int width, int height);
@@ -216,9 +257,12 @@ public:
     LightManager* get_light_mgr() const;
     PluginManager* get_plugin_mgr() const;
     TaskScheduler* get_task_scheduler() const;
+    FrameProfiler* get_profiler() const;
     DayTimeManager* get_daytime_mgr() const;
     Debugger* get_debugger() const;
 
+    const StateCacheStats& get_state_cache_stats() const;
+
 private:
     class Impl;
     std::unique_ptr<Impl> impl_;
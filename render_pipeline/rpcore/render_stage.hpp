@@ -130,6 +130,9 @@ public:
     void handle_window_resize();
     virtual void set_dimensions() {}
 
+    /** Returns the files of all shaders loaded by this stage. */
+    const std::vector<Filename>& get_shader_files() const;
+
 protected:
     const std::unordered_map<std::string, std::unique_ptr<RenderTarget>>& get_targets() const;
 
@@ -144,6 +147,7 @@ private:
     std::unordered_map<std::string, std::unique_ptr<RenderTarget>> targets_;
     const std::string stage_id_;
     bool active_ = true;
+    mutable std::vector<Filename> shader_files_;
 };
 
 // ************************************************************************************************
@@ -163,6 +167,11 @@ inline bool RenderStage::get_disabled() const
     return disabled_;
 }
 
+inline const std::vector<Filename>& RenderStage::get_shader_files() const
+{
+    return shader_files_;
+}
+
 inline const std::unordered_map<std::string, std::unique_ptr<RenderTarget>>& RenderStage::get_targets() const
 {
     return targets_;
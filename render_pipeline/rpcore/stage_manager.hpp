@@ -24,6 +24,7 @@
 
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
 
 #include <render_pipeline/rpcore/rpobject.hpp>
@@ -95,6 +96,12 @@ public:
      */
     void write_autoconfig();
 
+    /**
+     * Returns the names of the defines which are added, removed or changed
+     * after the last write_autoconfig().
+     */
+    std::unordered_set<std::string> get_changed_defines() const;
+
 private:
     class Impl;
     std::unique_ptr<Impl> impl_;
@@ -0,0 +1,155 @@
+/**
+ * Render Pipeline C++
+ *
+ * Copyright (c) 2016-2017 Center of Human-centered Interaction for Coexistence.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <pStatCollector.h>
+
+#include <render_pipeline/rpcore/rpobject.hpp>
+
+class Filename;
+
+namespace rpcore {
+
+/**
+ * Records the CPU time of the stages, plugins and managers in each frame.
+ *
+ * Each scope has a PStats collector, and the durations of the last frames
+ * are kept in a ring buffer to query rolling statistics or to export them
+ * as a Chrome trace. The profiler is used from the main thread only.
+ */
+class RENDER_PIPELINE_DECL FrameProfiler : public RPObject
+{
+public:
+    struct Stats
+    {
+        double min_ms = 0;
+        double avg_ms = 0;
+        double p99_ms = 0;
+        double max_ms = 0;
+
+        /** Number of the frames in which the scope ran. */
+        size_t num_frames = 0;
+    };
+
+    /** Measures the time until the end of the scope. */
+    class Scope
+    {
+    public:
+        Scope(FrameProfiler* profiler, size_t scope_id);
+        Scope(const Scope&) = delete;
+        ~Scope();
+
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        FrameProfiler* profiler_;
+        size_t scope_id_;
+        std::chrono::steady_clock::time_point start_time_;
+    };
+
+    /** Keeps the records of @p num_frames frames. If it is 0, nothing is recorded. */
+    explicit FrameProfiler(size_t num_frames);
+
+    bool is_enabled() const;
+
+    /**
+     * Returns the id of the scope with the given name, and creates the scope
+     * on the first call. Names with ':' are shown as a hierarchy in PStats.
+     */
+    size_t register_scope(const std::string& name);
+
+    /** Finishes the current frame and starts to record a new frame. */
+    void begin_frame();
+
+    std::vector<std::string> get_scope_names() const;
+
+    /** Returns the statistics of the scope over the recorded frames, except the current frame. */
+    Stats get_stats(const std::string& name) const;
+
+    /**
+     * Writes the recorded frames in the Chrome trace event format, which can
+     * be opened in chrome://tracing or Perfetto.
+     */
+    bool export_chrome_trace(const Filename& path) const;
+
+private:
+    struct Event
+    {
+        size_t scope_id;
+        int64_t start_us;
+        int64_t duration_us;
+    };
+
+    struct ScopeData
+    {
+        std::string name;
+        PStatCollector collector;
+
+        /** Total time in each recorded frame, or negative if the scope did not run. */
+        std::vector<double> frame_ms;
+    };
+
+    void record(size_t scope_id, std::chrono::steady_clock::time_point start_time, std::chrono::steady_clock::time_point end_time);
+
+    size_t num_frames_;
+    size_t current_frame_ = 0;
+    std::chrono::steady_clock::time_point epoch_;
+
+    std::vector<ScopeData> scopes_;
+    std::unordered_map<std::string, size_t> scope_ids_;
+
+    /** Events of each recorded frame, used as a ring buffer. */
+    std::vector<std::vector<Event>> frame_events_;
+};
+
+// ************************************************************************************************
+
+inline FrameProfiler::Scope::Scope(FrameProfiler* profiler, size_t scope_id):
+    profiler_(profiler && profiler->is_enabled() ? profiler : nullptr), scope_id_(scope_id)
+{
+    if (!profiler_)
+        return;
+
+    profiler_->scopes_[scope_id_].collector.start();
+    start_time_ = std::chrono::steady_clock::now();
+}
+
+inline FrameProfiler::Scope::~Scope()
+{
+    if (!profiler_)
+        return;
+
+    profiler_->record(scope_id_, start_time_, std::chrono::steady_clock::now());
+    profiler_->scopes_[scope_id_].collector.stop();
+}
+
+inline bool FrameProfiler::is_enabled() const
+{
+    return num_frames_ > 0;
+}
+
+}
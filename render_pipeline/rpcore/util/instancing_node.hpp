@@ -40,6 +40,9 @@ class RenderPipeline;
  *
  * But model matrix of instanced nodes is calculated by
  * "world_matrix_to_instanced_node * local_transform[index] * local_transform_of_child_of_instanced_node * vertex".
+ *
+ * Only the changed range of the transforms is copied when uploading, and the bounds of the instanced node
+ * include all instances. With CPU culling, the visible instances are compacted into the buffer every frame.
  */
 class RENDER_PIPELINE_DECL InstancingNode
 {
@@ -81,6 +84,21 @@ public:
     /** Upload transform buffer texture to GPU. */
     void upload_transforms();
 
+    /**
+     * Enable culling of each instance by the frustum of @p camera on CPU every frame.
+     * If @p camera is empty, the default camera of ShowBase is used.
+     *
+     * The culled instances are removed from the single transform buffer, which is also used by
+     * the shadow passes. So instances outside of the frustum do not cast shadows, and their shadows
+     * pop in when they enter it. If the shadows of the instances matter, use a camera whose lens covers
+     * the shadow casters (for example, a wider field of view or a farther far plane) or disable culling.
+     */
+    void set_culling(bool enable, const NodePath& camera=NodePath());
+    bool is_culling_enabled() const;
+
+    /** Get the count of visible instances, which is the count of instances without culling. */
+    int get_visible_instance_count() const;
+
     /**
      * Get child matrix relative to other with instancing transform.
      * child.get_mat(instanced_node) * get_transform(instance_index) * instanced_node.get_mat(other)
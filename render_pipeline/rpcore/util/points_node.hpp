@@ -62,6 +62,15 @@ public:
 
     std::vector<LPoint3>& modify_positions();
 
+    /**
+     * Get the positions from @p begin to @p begin + @p count to modify them.
+     *
+     * Only the modified ranges are uploaded by upload_positions(),
+     * so a window of streamed points can be written without uploading all points.
+     * The pointer is valid until the count of points is changed.
+     */
+    LPoint3* modify_positions(int begin, int count);
+
     /** Set the position on the point_index-th point. */
     void set_position(const LPoint3& positions, int point_index);
 
@@ -73,12 +82,25 @@ public:
      */
     void set_positions(const std::vector<LPoint3>& positions);
 
-    /** Upload transform buffer texture to GPU. */
+    /** Set the positions by taking the ownership of @p positions. */
+    void set_positions(std::vector<LPoint3>&& positions);
+
+    /** Upload the modified positions to GPU. */
     void upload_positions();
 
     /** Get the total count of points. */
     int get_point_count() const;
 
+    /** Get the count of points which the vertex memory can hold. */
+    int get_capacity() const;
+
+    /**
+     * Reserve the vertex memory for @p capacity points.
+     *
+     * Without this, the vertex memory grows geometrically when the count of points exceeds the capacity.
+     */
+    void reserve(int capacity);
+
     /** Get the active count of points. */
     int get_active_point_count() const;
 
@@ -121,6 +121,9 @@ public:
      *
      * The size among @p vertices, @p normals and @p texcoords should be same.
      * And the size should be same as the original size.
+     *
+     * If the columns consist of float32 components, the data is copied directly into the arrays
+     * (on multiple threads for large meshes). Otherwise, GeomVertexWriter is used.
      */
     bool modify_vertex_data(const std::vector<LVecBase3f>& vertices,
         const std::vector<LVecBase3f>& normals,
@@ -137,6 +137,33 @@ public:
         PTA_LMatrix4f
     };
 
+    /**
+     * Typed handle of an input, which is returned by register_pta and get_handle.
+     * Updating an input with the handle writes the value directly into the
+     * array of the input, without looking up the name.
+     *
+     * The handle is valid until the input is registered again.
+     */
+    template <class PTA>
+    class Handle
+    {
+    public:
+        using ElementType = typename PTA::value_type;
+
+        Handle() = default;
+
+        bool is_valid() const { return data_ != nullptr; }
+        size_t get_size() const { return size_; }
+
+    private:
+        friend class GroupedInputBlock;
+
+        Handle(ElementType* data, size_t size): data_(data), size_(size) {}
+
+        ElementType* data_ = nullptr;
+        size_t size_ = 0;
+    };
+
 public:
     // Keeps track of the global allocated input blocks to be able to assign
     // a unique binding to all of them
@@ -150,6 +177,17 @@ public:
     /** Registers a new input, type should be a glsl type. */
     void register_pta(const std::string& name, const std::string& input_type);
 
+    /**
+     * Registers a new input with the glsl type of the PTA type,
+     * and returns the handle of it. ex) register_pta<PTA_LMatrix4f>("proj_mat")
+     */
+    template <class PTA>
+    Handle<PTA> register_pta(const std::string& name);
+
+    /** Returns the handle of an existing input. */
+    template <class PTA>
+    Handle<PTA> get_handle(const std::string& name);
+
     /** Converts a PtaXXX to a glsl type. */
     const std::string& pta_to_glsl_type(PTA_ID which) const;
 
@@ -172,15 +210,28 @@ public:
     void update_input(const std::string& name, const LMatrix3f& value, size_t index=0);
     void update_input(const std::string& name, const LMatrix4f& value, size_t index=0);
 
+    /** Updates an existing input using the handle. */
+    template <class PTA, class T>
+    void update_input(const Handle<PTA>& handle, const T& value, size_t index=0);
+
     /** Returns the value of an existing input. */
     const PTA_Types& get_input(const std::string& name) const;
 
+    template <class PTA>
+    const typename Handle<PTA>::ElementType& get_input(const Handle<PTA>& handle, size_t index=0) const;
+
     /** Generates the GLSL shader code to use the UBO. */
     std::string generate_shader_code() const;
 
     const std::string& get_name() const;
 
 private:
+    /** Registers the input, and returns the stored array or nullptr if the name or the type is invalid. */
+    PTA_Types* do_register_pta(const std::string& name, PTA_ID pta_id);
+
+    template <class PTA>
+    static Handle<PTA> make_handle(PTA_Types& pta);
+
     const std::string name_;
 
     std::unordered_map<std::string, PTA_Types> ptas_;
@@ -229,6 +280,38 @@ inline void GroupedInputBlock::update_input(const std::string& name, const LMatr
     boost::get<PTA_LMatrix4f&>(ptas_.at(name))[index] = value;
 }
 
+template <class PTA, class T>
+inline void GroupedInputBlock::update_input(const Handle<PTA>& handle, const T& value, size_t index)
+{
+    handle.data_[index] = value;
+}
+
+template <class PTA>
+inline const typename GroupedInputBlock::Handle<PTA>::ElementType& GroupedInputBlock::get_input(const Handle<PTA>& handle, size_t index) const
+{
+    return handle.data_[index];
+}
+
+template <class PTA>
+GroupedInputBlock::Handle<PTA> GroupedInputBlock::register_pta(const std::string& name)
+{
+    PTA_Types* pta = do_register_pta(name, static_cast<PTA_ID>(PTA_Types(PTA()).which()));
+    return pta ? make_handle<PTA>(*pta) : Handle<PTA>();
+}
+
+template <class PTA>
+GroupedInputBlock::Handle<PTA> GroupedInputBlock::get_handle(const std::string& name)
+{
+    return make_handle<PTA>(ptas_.at(name));
+}
+
+template <class PTA>
+GroupedInputBlock::Handle<PTA> GroupedInputBlock::make_handle(PTA_Types& pta)
+{
+    PTA& array = boost::get<PTA&>(pta);
+    return Handle<PTA>(&array[0], array.size());
+}
+
 inline const std::string& GroupedInputBlock::get_name() const
 {
     return name_;
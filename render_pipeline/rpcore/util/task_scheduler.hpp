@@ -22,6 +22,8 @@
 
 #pragma once
 
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 
 #include <render_pipeline/rpcore/rpobject.hpp>
@@ -37,9 +39,19 @@ namespace rpcore {
 class RENDER_PIPELINE_DECL TaskScheduler : public RPObject
 {
 public:
+    /** Interned id of a task, see get_task_id(). */
+    using TaskID = size_t;
+
     TaskScheduler();
 
+    /**
+     * Returns the id of a given task, which makes is_scheduled a bit test.
+     * If the task is not in the config, an error is reported once.
+     */
+    TaskID get_task_id(const std::string& task_name) const;
+
     /** Returns whether a given task is supposed to run this frame. */
+    bool is_scheduled(TaskID task_id) const;
     bool is_scheduled(const std::string& task_name) const;
 
     void step();
@@ -54,19 +66,38 @@ private:
     /** Loads the tasks distribution configuration. */
     void load_config();
 
-    /**
-     * Checks whether the given task is scheduled at some point. This can
-     * be used to check whether any task is missing in the task scheduler config.
-     */
-    void check_missing_schedule(const std::string& task_name) const;
+    /** Rebuilds the scheduled task bits of the frames from the frame tasks. */
+    void update_frame_bits();
+
+    size_t frame_index_ = 0;
+
+    /** Tasks of each frame in the cycle. */
+    std::vector<std::vector<TaskID>> frame_tasks_;
 
-    int frame_index_;
-    std::vector<std::vector<std::string>> tasks_;
+    /** Bits of the scheduled tasks in each frame. */
+    std::vector<std::vector<uint64_t>> frame_bits_;
+
+    /** Number of the tasks in the config. The tasks interned later have greater ids. */
+    size_t num_config_tasks_ = 0;
+
+    mutable std::unordered_map<std::string, TaskID> task_ids_;
 };
 
+inline bool TaskScheduler::is_scheduled(TaskID task_id) const
+{
+    if (task_id >= num_config_tasks_ || frame_bits_.empty())
+        return false;
+    return (frame_bits_[frame_index_][task_id / 64] & (uint64_t(1) << (task_id % 64))) != 0;
+}
+
+inline bool TaskScheduler::is_scheduled(const std::string& task_name) const
+{
+    return is_scheduled(get_task_id(task_name));
+}
+
 inline size_t TaskScheduler::get_num_scheduled_tasks() const
 {
-    return tasks_[frame_index_].size();
+    return frame_tasks_.empty() ? 0 : frame_tasks_[frame_index_].size();
 }
 
 }
@@ -0,0 +1,69 @@
+/**
+ * Render Pipeline C++
+ *
+ * Copyright (c) 2016-2017 Center of Human-centered Interaction for Coexistence.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace rplibs {
+
+/**
+ * 64-bit FNV-1a hash.
+ *
+ * Unlike std::hash, the result is the same on every platform and every run,
+ * so it can be used for keys of files which are stored on a disk.
+ */
+class FNV1aHash
+{
+public:
+    void update(const void* data, size_t size)
+    {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        for (size_t k = 0; k < size; ++k)
+        {
+            state_ ^= bytes[k];
+            state_ *= 1099511628211ull;
+        }
+    }
+
+    /** Hashes the string with its length, so that ("ab", "c") and ("a", "bc") differ. */
+    void update(const std::string& str)
+    {
+        update(static_cast<uint64_t>(str.size()));
+        update(str.data(), str.size());
+    }
+
+    void update(uint64_t value)
+    {
+        unsigned char bytes[8];
+        for (int k = 0; k < 8; ++k)
+            bytes[k] = static_cast<unsigned char>(value >> (k * 8));
+        update(bytes, sizeof(bytes));
+    }
+
+    uint64_t get_digest() const { return state_; }
+
+private:
+    uint64_t state_ = 14695981039346656037ull;
+};
+
+}    // namespace rplibs
@@ -0,0 +1,108 @@
+/**
+ * Render Pipeline C++
+ *
+ * Copyright (c) 2016-2017 Center of Human-centered Interaction for Coexistence.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <render_pipeline/rpcore/config.hpp>
+
+namespace rplibs {
+
+/**
+ * Simple pool of worker threads for CPU work of the pipeline.
+ *
+ * The work must not use Panda3D objects which are shared with the main thread,
+ * unless they are protected.
+ */
+class RENDER_PIPELINE_DECL ThreadPool
+{
+public:
+    /** Returns the pool shared in the pipeline, which is created on the first call. */
+    static ThreadPool& get_global_pool();
+
+    /** Creates the pool. If @p num_threads is 0, the number of hardware threads minus one is used. */
+    explicit ThreadPool(size_t num_threads = 0);
+    ThreadPool(const ThreadPool&) = delete;
+
+    /** Finishes the queued jobs and joins the threads. */
+    ~ThreadPool();
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t get_num_threads() const;
+
+    /** Queues a job, and returns the future of its result. */
+    template <class Func>
+    auto submit(Func&& func) -> std::future<decltype(func())>;
+
+    /**
+     * Calls @p func(begin, end) on chunks of [0, @p count) with @p grain_size items,
+     * using the workers and the calling thread, and waits for all chunks.
+     *
+     * Chunks are processed in any order. If a chunk throws, the first exception is
+     * rethrown after all chunks are finished.
+     */
+    void parallel_for(size_t count, size_t grain_size, const std::function<void(size_t, size_t)>& func);
+
+private:
+    void enqueue(std::function<void()> job);
+    void run_worker();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> jobs_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stopping_ = false;
+};
+
+// ************************************************************************************************
+
+inline size_t ThreadPool::get_num_threads() const
+{
+    return workers_.size();
+}
+
+template <class Func>
+auto ThreadPool::submit(Func&& func) -> std::future<decltype(func())>
+{
+    using ResultType = decltype(func());
+
+    // std::function requires copyable callable.
+    auto task = std::make_shared<std::packaged_task<ResultType()>>(std::forward<Func>(func));
+    auto result = task->get_future();
+
+    if (workers_.empty())
+        (*task)();
+    else
+        enqueue([task]() { (*task)(); });
+
+    return result;
+}
+
+}
@@ -39,7 +39,9 @@
 
 #include <throw_event.h>
 
-#include <list>
+#include <atomic>
+#include <deque>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include <functional>
@@ -54,20 +56,25 @@ class DirectObject;
  * Wrapper of Panda3D EventHandler.
  *
  * This is used to accept std::function as hook or hook with DirectObject.
- * Messenger is NOT thread-safe except send() functions with queuing.
+ *
+ * Event names can be interned to EventID by get_event_id(), and the functions with EventID
+ * do not look up the name. Sending with EventID calls only the acceptors of Messenger
+ * (not other hooks of EventHandler), and queued events are stored in a lock-free queue
+ * which is dispatched by process_queued_events() once per frame.
+ *
+ * Messenger is NOT thread-safe except get_event_id() and send() functions with queuing.
  */
 class RENDER_PIPELINE_DECL Messenger
 {
 public:
     using EventName = std::string;
+    using EventID = size_t;
     using EventFunction = std::function<void(const Event*)>;
 
     using AcceptorType = std::pair<EventFunction, bool>;    //  { function, persistent }
     using AcceptorMap = std::unordered_map<const DirectObject*, AcceptorType>;
-    using CallbacksType = std::unordered_map<EventName, AcceptorMap>;
 
     using EventSetType = std::unordered_set<EventName>;
-    using ObjectEventsType = std::unordered_map<const DirectObject*, EventSetType>;
 
 public:
     static Messenger* get_global_instance();
@@ -76,13 +83,26 @@ public:
 
     ~Messenger();
 
+    /**
+     * Returns the interned ID of @p event_name.
+     *
+     * The ID is valid during the lifetime of Messenger. This function is thread-safe.
+     */
+    EventID get_event_id(const EventName& event_name);
+
+    /** Returns the event name of the interned ID. */
+    const EventName& get_event_name(EventID event_id) const;
+
     size_t get_num_listners() const;
     size_t get_num_listners(const EventName& event_name) const;
+    size_t get_num_listners(EventID event_id) const;
     size_t get_num_listners(const DirectObject* object) const;
 
     /**
      * Returns a future that is triggered by the given event name.  This
      * will function only once.
+     *
+     * The future is not triggered by send() with EventID.
      */
     AsyncFuture* get_future(const EventName& event_name) const;
 
@@ -91,29 +111,35 @@ public:
      */
     void accept(const EventName& event_name, const EventFunction& method, const DirectObject* object,
         bool persistent = true);
+    void accept(EventID event_id, const EventFunction& method, const DirectObject* object,
+        bool persistent = true);
 
     /** Ignore the event has @event_name binding to DirectObject. */
     void ignore(const EventName& event_name, const DirectObject* object);
+    void ignore(EventID event_id, const DirectObject* object);
 
     /**
      * Ignore all events has @event_name.
      */
     void ignore_all(const EventName& event_name);
+    void ignore_all(EventID event_id);
 
     /** Ignore all events binding to DirectObject. */
     void ignore_all(const DirectObject* object);
 
     /** Returns the list of all events accepted by the indicated object. */
-    const EventSetType& get_all_accepting(const DirectObject* object) const;
+    EventSetType get_all_accepting(const DirectObject* object) const;
 
     /** Is this object accepting this event? */
     bool is_accepting(const EventName& event_name, const DirectObject* object) const;
+    bool is_accepting(EventID event_id, const DirectObject* object) const;
 
     /** Return objects accepting the given event. */
-    const AcceptorMap& who_accepts(const EventName& event_name) const;
+    AcceptorMap who_accepts(const EventName& event_name) const;
 
     /** Is this object ignoring this event? */
     bool is_ignoring(const EventName& event_name, const DirectObject* object) const;
+    bool is_ignoring(EventID event_id, const DirectObject* object) const;
 
     void send(const EventName& event_name, bool queuing = false);
     void send(const EventName& event_name, const EventParameter& p1, bool queuing = false);
@@ -122,6 +148,27 @@ public:
     void send(const EventName& event_name, const EventParameter& p1,
         const EventParameter& p2, const EventParameter& p3, bool queuing = false);
 
+    /**
+     * Send the event with interned ID.
+     *
+     * If @p queuing is true, this can be called on any thread and the event is dispatched
+     * in process_queued_events(). Otherwise, the acceptors are called immediately.
+     */
+    void send(EventID event_id, bool queuing = false);
+    void send(EventID event_id, const EventParameter& p1, bool queuing = false);
+    void send(EventID event_id, const EventParameter& p1,
+        const EventParameter& p2, bool queuing = false);
+    void send(EventID event_id, const EventParameter& p1,
+        const EventParameter& p2, const EventParameter& p3, bool queuing = false);
+
+    /**
+     * Dispatch all events queued by send() with EventID in sending order.
+     *
+     * This should be called on the main thread, and ShowBase calls it every frame.
+     * @return  The number of dispatched events.
+     */
+    size_t process_queued_events();
+
     /** Start fresh with a clear dict. */
     void clear();
 
@@ -130,44 +177,79 @@ public:
     std::vector<EventName> get_events() const;
 
 private:
+    struct Acceptor
+    {
+        const DirectObject* object;
+        EventFunction function;
+        bool persistent;
+        bool removed;
+    };
+
+    /** Acceptors of an event. This is also user data of the hook in EventHandler. */
+    struct EventCallbacks
+    {
+        Messenger* messenger = nullptr;
+        EventID event_id = 0;
+        const EventName* event_name = nullptr;
+        std::vector<Acceptor> acceptors;
+        size_t num_removed = 0;
+        bool hooked = false;
+    };
+
+    /** Node of the lock-free queue for send() with queuing. */
+    struct QueuedEvent
+    {
+        EventID event_id;
+        PT(Event) event;
+        QueuedEvent* next;
+    };
+
     static void process_event(const Event* ev, void* user_data);
 
-    /**
-     * Add hook with @p event_name for Messenger::process_event
-     *
-     * If the hook already exists, then this does not add.
-     */
-    void add_hook(const EventName& event_name);
+    /** Returns the ID of @p event_name if it is interned. */
+    bool find_event_id(const EventName& event_name, EventID& event_id) const;
+
+    /** Returns callbacks of @p event_id or nullptr if nothing accepts it. */
+    const EventCallbacks* find_callbacks(EventID event_id) const;
+    EventCallbacks& get_callbacks(EventID event_id);
+
+    size_t find_acceptor(const EventCallbacks& callbacks, const DirectObject* object) const;
+
+    void add_acceptor(EventCallbacks& callbacks, Acceptor&& acceptor);
+    void remove_acceptor(EventCallbacks& callbacks, size_t index);
+
+    /** Call acceptors of the event. */
+    void dispatch(EventCallbacks& callbacks, const Event* ev);
 
-    /** Remove hook with @p event_name for Messenger::process_event */
-    void remove_hook(const EventName& event_name);
+    /** Apply accept and ignore requested during dispatching. */
+    void flush_pending();
+
+    void send_event(EventID event_id, Event* ev, bool queuing);
+
+    /** Compact the acceptors and remove the hook if nothing accepts the event. */
+    void compact(EventCallbacks& callbacks);
+
+    void add_hook(EventCallbacks& callbacks);
+    void remove_hook(EventCallbacks& callbacks);
 
     EventHandler* handler_;
-    CallbacksType callbacks_;
-    ObjectEventsType object_events_;
 
-    static const AcceptorMap empty_acceptor_;
-    static const EventSetType empty_events_;
-};
+    mutable std::mutex event_ids_mutex_;
+    std::unordered_map<EventName, EventID> event_ids_;
+    std::deque<EventName> event_names_;
 
-// ************************************************************************************************
+    // deque keeps the address for user data of hooks.
+    std::deque<EventCallbacks> callbacks_;
+    std::unordered_map<const DirectObject*, std::vector<EventID>> object_events_;
 
-inline size_t Messenger::get_num_listners() const
-{
-    size_t count = 0;
-    for (const auto& callback: callbacks_)
-        count += callback.second.size();
-    return count;
-}
+    int dispatch_depth_ = 0;
+    std::vector<std::pair<EventID, Acceptor>> pending_accepts_;
+    std::vector<EventID> dirty_events_;
 
-inline size_t Messenger::get_num_listners(const EventName& event_name) const
-{
-    const auto found = callbacks_.find(event_name);
-    if (found != callbacks_.end())
-        return found->second.size();
-    else
-        return 0;
-}
+    std::atomic<QueuedEvent*> queue_head_{ nullptr };
+};
+
+// ************************************************************************************************
 
 inline size_t Messenger::get_num_listners(const DirectObject* object) const
 {
@@ -183,78 +265,14 @@ inline AsyncFuture* Messenger::get_future(const EventName& event_name) const
     return handler_->get_future(event_name);
 }
 
-inline void Messenger::ignore(const EventName& event_name, const DirectObject* object)
-{
-    auto found = callbacks_.find(event_name);
-    if (found == callbacks_.end())
-        return;
-
-    auto& acceptor_map = found->second;
-    auto acceptor_map_found = acceptor_map.find(object);
-    if (acceptor_map_found != acceptor_map.end())
-    {
-        acceptor_map.erase(acceptor_map_found);
-
-        auto& event_set = object_events_.at(object);
-        event_set.erase(event_name);
-        if (event_set.empty())
-            object_events_.erase(object);
-    }
-
-    if (acceptor_map.empty())
-        remove_hook(event_name);
-}
-
-inline void Messenger::ignore_all(const EventName& event_name)
-{
-    auto found = callbacks_.find(event_name);
-    if (found == callbacks_.end())
-        return;
-
-    remove_hook(event_name);
-}
-
-inline void Messenger::ignore_all(const DirectObject* object)
-{
-    auto found = object_events_.find(object);
-    if (found == object_events_.end())
-        return;
-
-    for (const auto& event_name: found->second)
-    {
-        auto callback_found = callbacks_.find(event_name);
-        callback_found->second.erase(object);
-        if (callback_found->second.empty())
-            remove_hook(event_name);
-    }
-
-    object_events_.erase(object);
-}
-
-inline auto Messenger::get_all_accepting(const DirectObject* object) const -> const EventSetType&
-{
-    auto found = object_events_.find(object);
-    if (found == object_events_.end())
-        return empty_events_;
-    else
-        return found->second;
-}
-
-inline bool Messenger::is_accepting(const EventName& event_name, const DirectObject* object) const
+inline bool Messenger::is_ignoring(const EventName& event_name, const DirectObject* object) const
 {
-    auto found = callbacks_.find(event_name);
-    if (found != callbacks_.end())
-    {
-        if (found->second.find(object) != found->second.end())
-            return true;
-    }
-
-    return false;
+    return !is_accepting(event_name, object);
 }
 
-inline bool Messenger::is_ignoring(const EventName& event_name, const DirectObject* object) const
+inline bool Messenger::is_ignoring(EventID event_id, const DirectObject* object) const
 {
-    return !is_accepting(event_name, object);
+    return !is_accepting(event_id, object);
 }
 
 inline void Messenger::send(const EventName& event_name, bool queuing)
@@ -292,38 +310,40 @@ inline void Messenger::send(const EventName& event_name, const EventParameter& p
         throw_event_directly(*handler_, event_name, p1, p2, p3);
 }
 
-inline void Messenger::add_hook(const EventName& event_name)
+inline void Messenger::send(EventID event_id, bool queuing)
 {
-    if (!handler_->has_hook(event_name, &Messenger::process_event, this))
-        handler_->add_hook(event_name, &Messenger::process_event, this);
+    send_event(event_id, new Event(""), queuing);
 }
 
-inline void Messenger::remove_hook(const EventName& event_name)
+inline void Messenger::send(EventID event_id, const EventParameter& p1, bool queuing)
 {
-    handler_->remove_hook(event_name, process_event, this);
-    callbacks_.erase(event_name);
+    Event* ev = new Event("");
+    ev->add_parameter(p1);
+    send_event(event_id, ev, queuing);
 }
 
-inline void Messenger::clear()
+inline void Messenger::send(EventID event_id, const EventParameter& p1,
+    const EventParameter& p2, bool queuing)
 {
-    for (auto&& kv : callbacks_)
-        handler_->remove_hook(kv.first, process_event, this);
-    callbacks_.clear();
-    object_events_.clear();
+    Event* ev = new Event("");
+    ev->add_parameter(p1);
+    ev->add_parameter(p2);
+    send_event(event_id, ev, queuing);
 }
 
-inline bool Messenger::is_empty() const
+inline void Messenger::send(EventID event_id, const EventParameter& p1,
+    const EventParameter& p2, const EventParameter& p3, bool queuing)
 {
-    return get_num_listners() == 0;
+    Event* ev = new Event("");
+    ev->add_parameter(p1);
+    ev->add_parameter(p2);
+    ev->add_parameter(p3);
+    send_event(event_id, ev, queuing);
 }
 
-inline auto Messenger::get_events() const -> std::vector<EventName>
+inline bool Messenger::is_empty() const
 {
-    std::vector<EventName> events;
-    events.reserve(callbacks_.size());
-    for (const auto& kv: callbacks_)
-        events.push_back(kv.first);
-    return events;
+    return get_num_listners() == 0;
 }
 
 }
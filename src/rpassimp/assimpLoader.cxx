@@ -13,8 +13,10 @@
 
 #include "assimpLoader.h"
 
+#include <chrono>
 #include <regex>
 #include <numeric>
+#include <thread>
 
 #include "geomNode.h"
 #include "luse.h"
@@ -38,6 +40,7 @@
 #include "animBundleNode.h"
 #include "animChannelMatrixXfmTable.h"
 #include "pvector.h"
+#include "asyncTaskManager.h"
 
 #include "pandaIOSystem.h"
 #include "pandaLogger.h"
@@ -47,6 +50,7 @@
 #include <render_pipeline/rpcore/util/rpmaterial.hpp>
 #include <render_pipeline/rpcore/util/rprender_state.hpp>
 #include <render_pipeline/rpcore/util/primitives.hpp>
+#include <render_pipeline/rppanda/task/functional_task.hpp>
 
 #include "config_assimp.h"
 
@@ -55,6 +59,55 @@ namespace rpassimp {
 using std::ostringstream;
 using std::stringstream;
 
+/**
+ * Returns the task chain which loads the textures and meshes on Panda3D
+ * threads, or nullptr if Panda3D is built without threads.
+ */
+static AsyncTaskChain *get_load_task_chain()
+{
+    if (!Thread::is_threading_supported()) {
+        return nullptr;
+    }
+
+    AsyncTaskChain *chain = AsyncTaskManager::get_global_ptr()->make_task_chain("rpassimp_load");
+    if (chain->get_num_threads() == 0) {
+        chain->set_num_threads((std::max)(1u, std::thread::hardware_concurrency()));
+        chain->set_tick_clock(false);
+        chain->set_frame_sync(false);
+    }
+    return chain;
+}
+
+/**
+ * Runs the function once on a thread of the task chain.
+ */
+static PT(AsyncTask) add_load_task(AsyncTaskChain *chain, const std::function<void()> &func)
+{
+    PT(AsyncTask) task = new rppanda::FunctionalTask([func](rppanda::FunctionalTask *) {
+        func();
+        return AsyncTask::DS_done;
+    }, "rpassimp_load");
+    task->set_task_chain(chain->get_name());
+    AsyncTaskManager::get_global_ptr()->add(task);
+    return task;
+}
+
+/**
+ * Runs the function for each index on the threads of the task chain, and
+ * waits until all of them are done.
+ */
+static void run_load_tasks(AsyncTaskChain *chain, size_t count, const std::function<void(size_t)> &func)
+{
+    pvector<PT(AsyncTask)> tasks;
+    tasks.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        tasks.push_back(add_load_task(chain, [&func, i]() { func(i); }));
+    }
+    for (AsyncTask *task : tasks) {
+        task->wait();
+    }
+}
+
 struct BoneWeight
 {
     CPT(JointVertexTransform) joint_vertex_xform;
@@ -70,7 +123,9 @@ typedef pvector<BoneWeight> BoneWeightList;
 AssimpLoader::AssimpLoader() : _error(false), _geoms(nullptr)
 {
     PandaLogger::set_default();
-    _importer.SetIOHandler(new PandaIOSystem);
+    // the importer owns the IO system.
+    _io_system = new PandaIOSystem;
+    _importer.SetIOHandler(_io_system);
 }
 
 AssimpLoader::~AssimpLoader()
@@ -97,6 +152,11 @@ void AssimpLoader::get_extensions(std::string &ext) const
     });
 }
 
+const pvector<Filename> &AssimpLoader::get_dependent_files() const
+{
+    return _io_system->get_opened_files();
+}
+
 bool AssimpLoader::read(const Filename &filename)
 {
     _filename = filename;
@@ -163,25 +223,68 @@ void AssimpLoader::build_graph()
     MutexHolder holder(_lock);
 
     _root = new ModelRoot(_filename.get_basename());
+    _filename.make_canonical();
+
+    // The textures and meshes create Panda3D objects and read through the
+    // VFS, so they are loaded on Panda3D threads.
+    AsyncTaskChain *load_chain = assimp_parallel_load ? get_load_task_chain() : nullptr;
+    const bool parallel = load_chain != nullptr;
+
+    // Elapsed time of each phase in milliseconds.
+    auto phase_start = std::chrono::steady_clock::now();
+    const auto end_phase = [&phase_start]() {
+        const auto now = std::chrono::steady_clock::now();
+        const double elapsed_ms = std::chrono::duration<double, std::milli>(now - phase_start).count();
+        phase_start = now;
+        return elapsed_ms;
+    };
+
+    // Start decoding the external textures, which are used by the materials.
+    if (parallel) {
+        start_texture_loads(load_chain);
+    }
 
     // Import all of the embedded textures first.
     _textures = new PT(Texture)[_scene->mNumTextures];
-    for (size_t i = 0; i < _scene->mNumTextures; ++i) {
-        load_texture(i);
+    if (parallel) {
+        run_load_tasks(load_chain, _scene->mNumTextures, [this](size_t i) {
+            load_texture(i);
+        });
     }
-
-    // Then the materials.
-    _mat_states = new CPT(RenderState)[_scene->mNumMaterials];
-    for (size_t i = 0; i < _scene->mNumMaterials; ++i) {
-        load_material(i);
+    else {
+        for (size_t i = 0; i < _scene->mNumTextures; ++i) {
+            load_texture(i);
+        }
     }
+    const double textures_ms = end_phase();
 
-    // And then the meshes.
+    // Then the meshes, which only need the index of their material. The
+    // meshes with bones share the bone map, so they are converted first on
+    // this thread, and the others are independent of each other.
     _geoms = new PT(Geom)[_scene->mNumMeshes];
     _geom_matindices = new unsigned int[_scene->mNumMeshes];
+    std::vector<size_t> static_meshes;
     for (size_t i = 0; i < _scene->mNumMeshes; ++i) {
-        load_mesh(i);
+        if (_scene->mMeshes[i]->HasBones() || !parallel) {
+            load_mesh(i);
+        }
+        else {
+            static_meshes.push_back(i);
+        }
+    }
+    if (parallel) {
+        run_load_tasks(load_chain, static_meshes.size(), [this, &static_meshes](size_t i) {
+            load_mesh(static_meshes[i]);
+        });
+    }
+    const double meshes_ms = end_phase();
+
+    // And then the materials, which wait for the external textures.
+    _mat_states = new CPT(RenderState)[_scene->mNumMaterials];
+    for (size_t i = 0; i < _scene->mNumMaterials; ++i) {
+        load_material(i);
     }
+    const double materials_ms = end_phase();
 
     // And now the node structure.
     if (_scene->mRootNode != nullptr) {
@@ -192,11 +295,25 @@ void AssimpLoader::build_graph()
     for (size_t i = 0; i < _scene->mNumLights; ++i) {
         load_light(*_scene->mLights[i]);
     }
+    const double nodes_ms = end_phase();
+
+    rpassimp_cat.info()
+        << "Built " << _filename.get_basename() << " in "
+        << (textures_ms + meshes_ms + materials_ms + nodes_ms) << " ms (embedded textures: " << textures_ms
+        << " ms, meshes: " << meshes_ms << " ms, materials and textures: " << materials_ms
+        << " ms, nodes and lights: " << nodes_ms << " ms)" << std::endl;
 
     delete[] _textures;
     delete[] _mat_states;
     delete[] _geoms;
     delete[] _geom_matindices;
+
+    // The loads of the textures which are not used by a material still
+    // write to their entries.
+    for (auto &fn_load : _texture_loads) {
+        fn_load.second.task->wait();
+    }
+    _texture_loads.clear();
 }
 
 const aiNode *AssimpLoader::find_node(const aiNode &root, const aiString &name)
@@ -287,6 +404,58 @@ void AssimpLoader::load_texture(size_t index)
     _textures[index] = ptex;
 }
 
+Filename AssimpLoader::find_texture_file(const aiString &path) const
+{
+    Filename fn = Filename::from_os_specific(std::string(path.data, path.length));
+
+    // Try to find the file next to the model.
+    VirtualFileSystem *vfs = VirtualFileSystem::get_global_ptr();
+    const Filename dir = _filename.get_dirname();
+
+    // Quake 3 BSP doesn't specify an extension for textures.
+    if (vfs->is_regular_file(Filename(dir, fn))) {
+        fn = Filename(dir, fn);
+    }
+    else if (vfs->is_regular_file(Filename(dir, fn + ".tga"))) {
+        fn = Filename(dir, fn + ".tga");
+    }
+    else if (vfs->is_regular_file(Filename(dir, fn + ".jpg"))) {
+        fn = Filename(dir, fn + ".jpg");
+    }
+
+    return fn;
+}
+
+void AssimpLoader::start_texture_loads(AsyncTaskChain *chain)
+{
+    for (size_t i = 0; i < _scene->mNumMaterials; ++i) {
+        const aiMaterial &mat = *_scene->mMaterials[i];
+
+        // same types as load_material()
+        for (const aiTextureType ttype: { aiTextureType_DIFFUSE, aiTextureType_NORMALS }) {
+            for (unsigned int k = 0, k_end = mat.GetTextureCount(ttype); k < k_end; ++k) {
+                aiString path;
+                if (mat.GetTexture(ttype, k, &path) != aiReturn_SUCCESS || path.length == 0 || path.data[0] == '*') {
+                    continue;
+                }
+
+                const Filename fn = find_texture_file(path);
+                if (_texture_loads.find(fn) != _texture_loads.end()) {
+                    continue;
+                }
+
+                // TexturePool is thread-safe, and it shares the textures with
+                // the later loads of the same files.
+                TextureLoad &load = _texture_loads[fn];
+                PT(Texture) *texture = &load.texture;
+                load.task = add_load_task(chain, [fn, texture]() {
+                    *texture = TexturePool::load_texture(fn);
+                });
+            }
+        }
+    }
+}
+
 void AssimpLoader::load_texture_stage(const aiMaterial &mat, const aiTextureType &ttype, CPT(TextureAttrib) &tattr)
 {
     aiString path;
@@ -342,38 +511,16 @@ void AssimpLoader::load_texture_stage(const aiMaterial &mat, const aiTextureType
         }
         else if (path.length > 0)
         {
-            Filename fn = Filename::from_os_specific(std::string(path.data, path.length));
-
-            // Try to find the file by moving up twice in the hierarchy.
-            VirtualFileSystem *vfs = VirtualFileSystem::get_global_ptr();
-            Filename dir(_filename);
-            _filename.make_canonical();
-            dir = _filename.get_dirname();
+            const Filename fn = find_texture_file(path);
 
-            // Quake 3 BSP doesn't specify an extension for textures.
-            if (vfs->is_regular_file(Filename(dir, fn))) {
-                fn = Filename(dir, fn);
-            }
-            else if (vfs->is_regular_file(Filename(dir, fn + ".tga"))) {
-                fn = Filename(dir, fn + ".tga");
-            }
-            else if (vfs->is_regular_file(Filename(dir, fn + ".jpg"))) {
-                fn = Filename(dir, fn + ".jpg");
-            }
-            else {
-                dir = _filename.get_dirname();
-                if (vfs->is_regular_file(Filename(dir, fn))) {
-                    fn = Filename(dir, fn);
-                }
-                else if (vfs->is_regular_file(Filename(dir, fn + ".tga"))) {
-                    fn = Filename(dir, fn + ".tga");
-                }
-                else if (vfs->is_regular_file(Filename(dir, fn + ".jpg"))) {
-                    fn = Filename(dir, fn + ".jpg");
-                }
+            const auto found = _texture_loads.find(fn);
+            if (found != _texture_loads.end())
+            {
+                found->second.task->wait();
+                ptex = found->second.texture;
             }
-
-            ptex = TexturePool::load_texture(fn);
+            else
+                ptex = TexturePool::load_texture(fn);
         }
 
         if (ptex != nullptr)
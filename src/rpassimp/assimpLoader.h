@@ -17,6 +17,8 @@
 #include "modelRoot.h"
 #include "texture.h"
 #include "pmap.h"
+#include "pvector.h"
+#include "asyncTask.h"
 
 #include <assimp/scene.h>
 #include <assimp/Importer.hpp>
@@ -26,9 +28,12 @@ class CharacterJointBundle;
 class PartGroup;
 class AnimBundle;
 class AnimGroup;
+class AsyncTaskChain;
 
 namespace rpassimp {
 
+class PandaIOSystem;
+
 struct char_cmp {
   bool operator () (const char *a, const char *b) const {
     return strcmp(a,b) < 0;
@@ -64,6 +69,12 @@ public:
      */
     void build_graph();
 
+    /**
+     * Returns the files read by the importer, which are the model and its
+     * companion files.
+     */
+    const pvector<Filename> &get_dependent_files() const;
+
 public:
     bool _error;
     PT(ModelRoot) _root;
@@ -72,6 +83,7 @@ public:
 
 private:
     Assimp::Importer _importer;
+    PandaIOSystem *_io_system;
     const aiScene *_scene;
 
     // These arrays are temporarily used during the build_graph run.
@@ -82,6 +94,12 @@ private:
     BoneMap _bonemap;
     CharacterMap _charmap;
 
+    struct TextureLoad {
+        PT(AsyncTask) task;
+        PT(Texture) texture;
+    };
+    pmap<Filename, TextureLoad> _texture_loads;
+
     /**
      * Finds a node by name.
      */
@@ -92,6 +110,18 @@ private:
      */
     void load_texture(size_t index);
 
+    /**
+     * Finds the file of an external texture next to the model.
+     */
+    Filename find_texture_file(const aiString &path) const;
+
+    /**
+     * Starts loading the external textures of all materials on the threads
+     * of the task chain, so that they are decoded while the meshes are
+     * converted.
+     */
+    void start_texture_loads(AsyncTaskChain *chain);
+
     /**
      * Converts an aiMaterial into a RenderState.
      */
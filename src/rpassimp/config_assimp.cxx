@@ -82,6 +82,24 @@ ConfigVariableDouble assimp_smooth_normal_angle
         "normals. Note that you may need to clear the model-cache after "
         "changing this."));
 
+ConfigVariableBool assimp_parallel_load
+("assimp-parallel-load", true,
+    PRC_DESC("Set this true to decode the textures and to convert the meshes "
+        "on the Panda3D threads of the task chain 'rpassimp_load'.  Set this "
+        "false, or build Panda3D without threads, to load a model on the "
+        "calling thread only."));
+
+ConfigVariableFilename assimp_cache_dir
+("assimp-cache-dir", "",
+    PRC_DESC("The directory where the converted models are stored as bam files, "
+        "keyed by the contents of the source file and the assimp settings, "
+        "so that the next load of an unchanged model skips the import.  "
+        "Companion files read by the importer are checked when a cached "
+        "model is read.  The cache is used only if the parent of this "
+        "directory is on the file system of the OS, and the default empty "
+        "value disables it.  While this cache is used, the models loaded "
+        "by assimp are not stored in the model-cache-dir."));
+
 ConfigureFn(config_rpassimp)
 {
     static bool initialized = false;
@@ -16,6 +16,7 @@
 #include <notifyCategoryProxy.h>
 #include <configVariableBool.h>
 #include "configVariableDouble.h"
+#include "configVariableFilename.h"
 
 NotifyCategoryDeclNoExport(rpassimp);
 
@@ -29,3 +30,5 @@ extern ConfigVariableBool assimp_optimize_graph;
 extern ConfigVariableBool assimp_flip_winding_order;
 extern ConfigVariableBool assimp_gen_normals;
 extern ConfigVariableDouble assimp_smooth_normal_angle;
+extern ConfigVariableBool assimp_parallel_load;
+extern ConfigVariableFilename assimp_cache_dir;
@@ -15,10 +15,262 @@
 #include "config_assimp.h"
 #include "assimpLoader.h"
 
+#include <cstring>
+#include <functional>
+#include <sstream>
+
+#include "bamFile.h"
+#include "bamWriter.h"
+#include "virtualFileSystem.h"
+#include "virtualFileList.h"
+#include "virtualFileSimple.h"
+#include "virtualFileMountSystem.h"
+#include "bamCacheRecord.h"
+
 #include <assimp/cimport.h>
 
+#include <fmt/format.h>
+
+#include <render_pipeline/rplibs/hash.hpp>
+
 namespace rpassimp {
 
+/**
+ * Version of the converted models in the cache. Increase this when the
+ * conversion in AssimpLoader changes, so that the old files are not used.
+ */
+static constexpr uint64_t ASSIMP_CACHE_VERSION = 2;
+
+/**
+ * Returns true if the directory is on the file system of the OS.  The cache
+ * is not used on other mounts, like a ramdisk, because it would only add the
+ * cost of writing the bam files to memory.
+ */
+static bool is_system_directory(const Filename &dir)
+{
+    PT(VirtualFile) file = VirtualFileSystem::get_global_ptr()->get_file(dir, true);
+    if (file == nullptr || !file->is_directory() ||
+        !file->is_of_type(VirtualFileSimple::get_class_type())) {
+        return false;
+    }
+
+    return DCAST(VirtualFileSimple, file)->get_mount()->is_of_type(VirtualFileMountSystem::get_class_type());
+}
+
+/**
+ * Hashes the contents of the file.
+ */
+static bool hash_file(const Filename &path, uint64_t &digest)
+{
+    std::string data;
+    if (!VirtualFileSystem::get_global_ptr()->read_file(path, data, true))
+        return false;
+
+    rplibs::FNV1aHash hash;
+    hash.update(data.data(), data.size());
+    digest = hash.get_digest();
+    return true;
+}
+
+/**
+ * Returns true if the converted models are stored in assimp-cache-dir.
+ */
+static bool is_cache_active()
+{
+    const Filename cache_dir = assimp_cache_dir.get_value();
+    return !cache_dir.empty() && is_system_directory(cache_dir.get_dirname());
+}
+
+/**
+ * Returns the path of the cached bam file for the model, which is keyed by
+ * the contents of the model and the settings of the import, or an empty
+ * filename if the cache is not available.
+ */
+static Filename get_cache_path(const Filename &path)
+{
+    if (!is_cache_active())
+        return Filename();
+
+    uint64_t file_digest;
+    if (!hash_file(path, file_digest))
+        return Filename();
+
+    rplibs::FNV1aHash hash;
+    hash.update(ASSIMP_CACHE_VERSION);
+    hash.update(file_digest);
+
+    // the settings which change the import
+    for (const bool flag: {
+        assimp_calc_tangent_space.get_value(), assimp_join_identical_vertices.get_value(),
+        assimp_improve_cache_locality.get_value(), assimp_remove_redundant_materials.get_value(),
+        assimp_fix_infacing_normals.get_value(), assimp_optimize_meshes.get_value(),
+        assimp_optimize_graph.get_value(), assimp_flip_winding_order.get_value(),
+        assimp_gen_normals.get_value() }) {
+        hash.update(static_cast<uint64_t>(flag));
+    }
+
+    const double smooth_normal_angle = assimp_smooth_normal_angle;
+    uint64_t smooth_normal_angle_bits;
+    std::memcpy(&smooth_normal_angle_bits, &smooth_normal_angle, sizeof(smooth_normal_angle_bits));
+    hash.update(smooth_normal_angle_bits);
+
+    // The files of a model share the name up to the last '-', which is used
+    // to remove the files of older versions of the model.
+    return Filename(assimp_cache_dir.get_value(), fmt::format("{}-{:x}-{:016x}.bam", path.get_basename_wo_extension(),
+        path.get_hash(), hash.get_digest()));
+}
+
+/**
+ * Returns the path of the list of the companion files for the cached model.
+ */
+static Filename get_dependencies_path(const Filename &cache_path)
+{
+    Filename deps_path = cache_path;
+    deps_path.set_extension("deps");
+    return deps_path;
+}
+
+/**
+ * Checks that the companion files of the cached model are not changed, and
+ * registers them on the record of the model-cache.
+ */
+static bool check_dependencies(const Filename &cache_path, BamCacheRecord *record)
+{
+    std::string data;
+    if (!VirtualFileSystem::get_global_ptr()->read_file(get_dependencies_path(cache_path), data, false))
+        return false;
+
+    // each line is "<hash of the contents> <full path>"
+    std::istringstream lines(data);
+    std::string line;
+    while (std::getline(lines, line)) {
+        const size_t separator = line.find(' ');
+        if (separator == std::string::npos)
+            return false;
+
+        const Filename dependent_file = line.substr(separator + 1);
+        uint64_t digest;
+        if (!hash_file(dependent_file, digest) || fmt::format("{:016x}", digest) != line.substr(0, separator))
+            return false;
+
+        if (record != nullptr)
+            record->add_dependent_file(dependent_file);
+    }
+
+    return true;
+}
+
+/**
+ * Reads the converted model from the cache.
+ */
+static PT(PandaNode) read_cache(const Filename &cache_path, BamCacheRecord *record)
+{
+    VirtualFileSystem *vfs = VirtualFileSystem::get_global_ptr();
+    if (!vfs->exists(cache_path) || !check_dependencies(cache_path, record))
+        return nullptr;
+
+    BamFile bam_file;
+    if (!bam_file.open_read(cache_path, false))
+        return nullptr;
+
+    PT(PandaNode) node = bam_file.read_node(false);
+    if (node == nullptr) {
+        rpassimp_cat.warning() << "Could not read the cached model " << cache_path << "\n";
+    }
+
+    return node;
+}
+
+/**
+ * Writes the file to a temporary path first and renames it, so that other
+ * processes never read a partial file.
+ */
+static bool write_atomic(const Filename &path, const std::function<bool(const Filename &)> &write)
+{
+    VirtualFileSystem *vfs = VirtualFileSystem::get_global_ptr();
+    const Filename temp_path = path.get_fullpath() + ".tmp";
+    if (write(temp_path) && vfs->rename_file(temp_path, path))
+        return true;
+
+    vfs->delete_file(temp_path);
+    return false;
+}
+
+/**
+ * Removes the cached files of older versions or settings of the model, which
+ * have the same name as the given cached model up to the key.
+ */
+static void remove_stale_cache(const Filename &cache_path)
+{
+    VirtualFileSystem *vfs = VirtualFileSystem::get_global_ptr();
+    PT(VirtualFileList) file_list = vfs->scan_directory(cache_path.get_dirname());
+    if (file_list == nullptr)
+        return;
+
+    // The files of this version, including the temporary files, start with
+    // the name and a dot.
+    const std::string name = cache_path.get_basename_wo_extension() + ".";
+    const size_t prefix_length = name.rfind('-') + 1;
+
+    for (size_t i = 0, i_end = file_list->get_num_files(); i < i_end; ++i) {
+        const Filename &path = file_list->get_file(i)->get_filename();
+        const std::string other_name = path.get_basename();
+        if (other_name.compare(0, prefix_length, name, 0, prefix_length) == 0 &&
+            other_name.compare(0, name.size(), name) != 0) {
+            rpassimp_cat.debug() << "Removing the stale cached model " << path << "\n";
+            vfs->delete_file(path);
+        }
+    }
+}
+
+/**
+ * Writes the converted model and the list of its companion files to the
+ * cache, and removes the files of older versions of the model.
+ */
+static void write_cache(const Filename &cache_path, const Filename &path,
+    const pvector<Filename> &dependent_files, PandaNode *node)
+{
+    VirtualFileSystem *vfs = VirtualFileSystem::get_global_ptr();
+    vfs->make_directory_full(cache_path.get_dirname());
+
+    // The model itself is already a part of the key.
+    std::string deps;
+    for (const Filename &dependent_file: dependent_files) {
+        if (dependent_file == path)
+            continue;
+
+        uint64_t digest;
+        if (!hash_file(dependent_file, digest)) {
+            rpassimp_cat.warning() << "Could not hash " << dependent_file << ", so " << path << " is not cached\n";
+            return;
+        }
+        deps += fmt::format("{:016x} {}\n", digest, dependent_file.get_fullpath());
+    }
+
+    // The list is written first, so a cached model always has it.
+    const bool written = write_atomic(get_dependencies_path(cache_path), [&](const Filename &temp_path) {
+        return vfs->write_file(temp_path, deps, false);
+    }) && write_atomic(cache_path, [&](const Filename &temp_path) {
+        BamFile bam_file;
+        if (!bam_file.open_write(temp_path, false))
+            return false;
+
+        // The textures of the files are referenced with their full paths,
+        // so the cache does not depend on the location of the model.
+        bam_file.get_writer()->set_file_texture_mode(BamWriter::BTM_fullpath);
+        const bool result = bam_file.write_object(node);
+        bam_file.close();
+        return result;
+    });
+
+    if (!written) {
+        rpassimp_cat.warning() << "Could not write the cached model " << cache_path << "\n";
+        return;
+    }
+
+    remove_stale_cache(cache_path);
+}
+
 TypeHandle LoaderFileTypeAssimp::_type_handle;
 
 /**
@@ -84,12 +336,34 @@ bool LoaderFileTypeAssimp::supports_compressed() const
     return true;
 }
 
+/**
+ * Returns true if the loaded models may be stored in the model-cache.  This
+ * is false while assimp-cache-dir is used, because the model would be stored
+ * twice, and the model-cache would hash the source file again on every load.
+ */
+bool LoaderFileTypeAssimp::get_allow_disk_cache(const LoaderOptions &options) const
+{
+    if (is_cache_active())
+        return false;
+
+    return LoaderFileType::get_allow_disk_cache(options);
+}
+
 /**
  *
  */
 PT(PandaNode) LoaderFileTypeAssimp::load_file(const Filename &path, const LoaderOptions &options,
     BamCacheRecord *record) const
 {
+    const Filename cache_path = get_cache_path(path);
+    if (!cache_path.empty()) {
+        PT(PandaNode) node = read_cache(cache_path, record);
+        if (node != nullptr) {
+            rpassimp_cat.info() << "Reading " << path << " from " << cache_path << "\n";
+            return node;
+        }
+    }
+
     rpassimp_cat.info() << "Reading " << path << "\n";
 
     AssimpLoader loader;
@@ -99,6 +373,21 @@ PT(PandaNode) LoaderFileTypeAssimp::load_file(const Filename &path, const Loader
         return nullptr;
 
     loader.build_graph();
+
+    // Companion files like glTF buffers or OBJ material libraries also
+    // invalidate the caches.
+    const pvector<Filename> &dependent_files = loader.get_dependent_files();
+    if (record != nullptr) {
+        for (const Filename &dependent_file: dependent_files) {
+            if (dependent_file != path)
+                record->add_dependent_file(dependent_file);
+        }
+    }
+
+    if (!cache_path.empty()) {
+        write_cache(cache_path, path, dependent_files, loader._root);
+    }
+
     return DCAST(PandaNode, loader._root);
 }
 
@@ -31,6 +31,7 @@ public:
     virtual std::string get_extension() const;
     virtual std::string get_additional_extensions() const;
     virtual bool supports_compressed() const;
+    virtual bool get_allow_disk_cache(const LoaderOptions &options) const;
 
     virtual PT(PandaNode) load_file(const Filename &path, const LoaderOptions &options,
         BamCacheRecord *record) const;
@@ -17,6 +17,8 @@
 
 #include "config_assimp.h"
 
+#include <algorithm>
+
 namespace rpassimp {
 
 /**
@@ -81,6 +83,9 @@ Open(const char *file, const char *mode) {
     if (stream == nullptr) {
       return nullptr;
     }
+    if (std::find(_opened_files.begin(), _opened_files.end(), fn) == _opened_files.end()) {
+      _opened_files.push_back(fn);
+    }
     return new PandaIOStream(*stream);
 
   } else {
@@ -89,4 +94,12 @@ Open(const char *file, const char *mode) {
   }
 }
 
+/**
+ * Returns the files which are opened by the importer.
+ */
+const pvector<Filename> &PandaIOSystem::
+get_opened_files() const {
+  return _opened_files;
+}
+
 }
@@ -14,6 +14,7 @@
 #pragma once
 
 #include <virtualFileSystem.h>
+#include <pvector.h>
 
 #include <assimp/IOSystem.hpp>
 
@@ -34,8 +35,15 @@ public:
     char getOsSeparator() const;
     Assimp::IOStream *Open(const char *file, const char *mode);
 
+    /**
+     * Returns the files which are opened by the importer, including the model
+     * itself and its companion files like buffers or material libraries.
+     */
+    const pvector<Filename> &get_opened_files() const;
+
 private:
     VirtualFileSystem *_vfs;
+    pvector<Filename> _opened_files;
 };
 
 }
@@ -117,8 +117,8 @@ void CommonResources::update()
 
         // Compute the view matrix, but with a z-up coordinate system
         const LMatrix4& zup_conversion = LMatrix4::z_to_y_up_mat();
-        input_ubo_->update_input("stereo_view_mat_z_up", view_mat[0] * zup_conversion, 0);
-        input_ubo_->update_input("stereo_view_mat_z_up", view_mat[1] * zup_conversion, 1);
+        input_ubo_->update_input(inputs_.view_mat_z_up, view_mat[0] * zup_conversion, 0);
+        input_ubo_->update_input(inputs_.view_mat_z_up, view_mat[1] * zup_conversion, 1);
 
         // Compute the view matrix without the camera rotation
         LMatrix4 view_mat_billboard[2] = { view_mat[0], view_mat[1] };
@@ -131,28 +131,28 @@ void CommonResources::update()
         view_mat_billboard[1].set_row(1, LVecBase3(0, 1, 0));
         view_mat_billboard[1].set_row(2, LVecBase3(0, 0, 1));
 
-        input_ubo_->update_input("stereo_view_mat_billboard", view_mat_billboard[0], 0);
-        input_ubo_->update_input("stereo_view_mat_billboard", view_mat_billboard[1], 1);
+        input_ubo_->update_input(inputs_.view_mat_billboard, view_mat_billboard[0], 0);
+        input_ubo_->update_input(inputs_.view_mat_billboard, view_mat_billboard[1], 1);
 
-        input_ubo_->update_input("stereo_camera_pos", eye_path[0].get_pos(Globals::render), 0);
-        input_ubo_->update_input("stereo_camera_pos", eye_path[1].get_pos(Globals::render), 1);
+        input_ubo_->update_input(inputs_.camera_pos, eye_path[0].get_pos(Globals::render), 0);
+        input_ubo_->update_input(inputs_.camera_pos, eye_path[1].get_pos(Globals::render), 1);
 
         // Compute last view projection mat
         {
-            const LMatrix4f& curr_vp_value = boost::get<const PTA_LMatrix4f&>(input_ubo_->get_input("stereo_view_proj_mat_no_jitter"))[0];
-            input_ubo_->update_input("stereo_last_view_proj_mat_no_jitter", curr_vp_value, 0);
+            const LMatrix4f& curr_vp_value = input_ubo_->get_input(inputs_.view_proj_mat_no_jitter, 0);
+            input_ubo_->update_input(inputs_.last_view_proj_mat_no_jitter, curr_vp_value, 0);
             LMatrix4f curr_vp = curr_vp_value;
             curr_vp.invert_in_place();
             const LMatrix4f curr_inv_vp = curr_vp;
-            input_ubo_->update_input("stereo_last_inv_view_proj_mat_no_jitter", curr_inv_vp, 0);
+            input_ubo_->update_input(inputs_.last_inv_view_proj_mat_no_jitter, curr_inv_vp, 0);
         }
         {
-            const LMatrix4f& curr_vp_value = boost::get<const PTA_LMatrix4f&>(input_ubo_->get_input("stereo_view_proj_mat_no_jitter"))[1];
-            input_ubo_->update_input("stereo_last_view_proj_mat_no_jitter", curr_vp_value, 1);
+            const LMatrix4f& curr_vp_value = input_ubo_->get_input(inputs_.view_proj_mat_no_jitter, 1);
+            input_ubo_->update_input(inputs_.last_view_proj_mat_no_jitter, curr_vp_value, 1);
             LMatrix4f curr_vp = curr_vp_value;
             curr_vp.invert_in_place();
             const LMatrix4f curr_inv_vp = curr_vp;
-            input_ubo_->update_input("stereo_last_inv_view_proj_mat_no_jitter", curr_inv_vp, 1);
+            input_ubo_->update_input(inputs_.last_inv_view_proj_mat_no_jitter, curr_inv_vp, 1);
         }
 
         const LMatrix4 stereo_proj_mat_z_up[2] ={
@@ -165,24 +165,24 @@ void CommonResources::update()
             view_mat[1] * stereo_proj_mat[1]
         };
 
-        input_ubo_->update_input("stereo_ViewMatrix", view_mat[0], 0);
-        input_ubo_->update_input("stereo_ViewMatrix", view_mat[1], 1);
-        input_ubo_->update_input("stereo_ProjectionMatrix", stereo_proj_mat[0], 0);
-        input_ubo_->update_input("stereo_ProjectionMatrix", stereo_proj_mat[1], 1);
-        input_ubo_->update_input("stereo_ViewProjectionMatrix", stereo_view_proj_mat[0], 0);
-        input_ubo_->update_input("stereo_ViewProjectionMatrix", stereo_view_proj_mat[1], 1);
+        input_ubo_->update_input(inputs_.view_matrix, view_mat[0], 0);
+        input_ubo_->update_input(inputs_.view_matrix, view_mat[1], 1);
+        input_ubo_->update_input(inputs_.projection_matrix, stereo_proj_mat[0], 0);
+        input_ubo_->update_input(inputs_.projection_matrix, stereo_proj_mat[1], 1);
+        input_ubo_->update_input(inputs_.view_projection_matrix, stereo_view_proj_mat[0], 0);
+        input_ubo_->update_input(inputs_.view_projection_matrix, stereo_view_proj_mat[1], 1);
 
-        input_ubo_->update_input("stereo_ViewProjectionMatrixInverse", invert(stereo_view_proj_mat[0]), 0);
-        input_ubo_->update_input("stereo_ViewProjectionMatrixInverse", invert(stereo_view_proj_mat[1]), 1);
+        input_ubo_->update_input(inputs_.view_projection_matrix_inverse, invert(stereo_view_proj_mat[0]), 0);
+        input_ubo_->update_input(inputs_.view_projection_matrix_inverse, invert(stereo_view_proj_mat[1]), 1);
 
         // Set the projection matrix as an input, but convert it to the correct
         // coordinate system before.
-        input_ubo_->update_input("stereo_proj_mat", stereo_proj_mat_z_up[0], 0);
-        input_ubo_->update_input("stereo_proj_mat", stereo_proj_mat_z_up[1], 1);
+        input_ubo_->update_input(inputs_.proj_mat, stereo_proj_mat_z_up[0], 0);
+        input_ubo_->update_input(inputs_.proj_mat, stereo_proj_mat_z_up[1], 1);
 
         // Set the inverse projection matrix
-        input_ubo_->update_input("stereo_inv_proj_mat", invert(stereo_proj_mat_z_up[0]), 0);
-        input_ubo_->update_input("stereo_inv_proj_mat", invert(stereo_proj_mat_z_up[1]), 1);
+        input_ubo_->update_input(inputs_.inv_proj_mat, invert(stereo_proj_mat_z_up[0]), 0);
+        input_ubo_->update_input(inputs_.inv_proj_mat, invert(stereo_proj_mat_z_up[1]), 1);
 
         LMatrix4 stereo_view_mat_inv[2] = { view_mat[0], view_mat[1] };
         stereo_view_mat_inv[0].invert_in_place();
@@ -191,11 +191,11 @@ void CommonResources::update()
         // Remove jitter and set the new view projection mat
         stereo_proj_mat[0].set_cell(1, 0, 0.0);
         stereo_proj_mat[0].set_cell(1, 1, 0.0);
-        input_ubo_->update_input("stereo_view_proj_mat_no_jitter", view_mat[0] * stereo_proj_mat[0], 0);
+        input_ubo_->update_input(inputs_.view_proj_mat_no_jitter, view_mat[0] * stereo_proj_mat[0], 0);
 
         stereo_proj_mat[1].set_cell(1, 0, 0.0);
         stereo_proj_mat[1].set_cell(1, 1, 0.0);
-        input_ubo_->update_input("stereo_view_proj_mat_no_jitter", view_mat[1] * stereo_proj_mat[1], 1);
+        input_ubo_->update_input(inputs_.view_proj_mat_no_jitter, view_mat[1] * stereo_proj_mat[1], 1);
 
         // Compute frustum corners in the order BL, BR, TL, TR
         // XXX: DO NOT compute frustum calculation in stereo.
@@ -208,39 +208,39 @@ void CommonResources::update()
 
         // Compute the view matrix, but with a z-up coordinate system
         const LMatrix4& zup_conversion = LMatrix4::z_to_y_up_mat();
-        input_ubo_->update_input("view_mat_z_up", view_mat * zup_conversion);
+        input_ubo_->update_input(inputs_.view_mat_z_up, view_mat * zup_conversion);
 
         // Compute the view matrix without the camera rotation
         LMatrix4 view_mat_billboard(view_mat);
         view_mat_billboard.set_row(0, LVecBase3(1, 0, 0));
         view_mat_billboard.set_row(1, LVecBase3(0, 1, 0));
         view_mat_billboard.set_row(2, LVecBase3(0, 0, 1));
-        input_ubo_->update_input("view_mat_billboard", view_mat_billboard);
+        input_ubo_->update_input(inputs_.view_mat_billboard, view_mat_billboard);
 
-        input_ubo_->update_input("camera_pos", showbase_->get_cam().get_pos(Globals::render));
+        input_ubo_->update_input(inputs_.camera_pos, showbase_->get_cam().get_pos(Globals::render));
 
         // Compute last view projection mat
-        const LMatrix4& curr_vp_value = boost::get<const PTA_LMatrix4f&>(input_ubo_->get_input("view_proj_mat_no_jitter"))[0];
-        input_ubo_->update_input("last_view_proj_mat_no_jitter", curr_vp_value);
+        const LMatrix4& curr_vp_value = input_ubo_->get_input(inputs_.view_proj_mat_no_jitter, 0);
+        input_ubo_->update_input(inputs_.last_view_proj_mat_no_jitter, curr_vp_value);
         LMatrix4 curr_vp = curr_vp_value;
         curr_vp.invert_in_place();
         const LMatrix4 curr_inv_vp = curr_vp;
-        input_ubo_->update_input("last_inv_view_proj_mat_no_jitter", curr_inv_vp);
+        input_ubo_->update_input(inputs_.last_inv_view_proj_mat_no_jitter, curr_inv_vp);
 
         LMatrix4 proj_mat = showbase_->get_cam_lens()->get_projection_mat();
 
         // Set the projection matrix as an input, but convert it to the correct
         // coordinate system before.
         const LMatrix4& proj_mat_zup = LMatrix4::y_to_z_up_mat() * proj_mat;
-        input_ubo_->update_input("proj_mat", proj_mat_zup);
+        input_ubo_->update_input(inputs_.proj_mat, proj_mat_zup);
 
         // Set the inverse projection matrix
-        input_ubo_->update_input("inv_proj_mat", invert(proj_mat_zup));
+        input_ubo_->update_input(inputs_.inv_proj_mat, invert(proj_mat_zup));
 
         // Remove jitter and set the new view projection mat
         proj_mat.set_cell(1, 0, 0.0);
         proj_mat.set_cell(1, 1, 0.0);
-        input_ubo_->update_input("view_proj_mat_no_jitter", view_mat * proj_mat);
+        input_ubo_->update_input(inputs_.view_proj_mat_no_jitter, view_mat * proj_mat);
 
         // Compute frustum corners in the order BL, BR, TL, TR
         LMatrix4 ws_frustum_directions;
@@ -258,24 +258,24 @@ void CommonResources::update()
             ws_frustum_directions.set_row(i, ws_dir);
         }
 
-        input_ubo_->update_input("vs_frustum_directions", vs_frustum_directions);
-        input_ubo_->update_input("ws_frustum_directions", ws_frustum_directions);
+        input_ubo_->update_input(inputs_.vs_frustum_directions, vs_frustum_directions);
+        input_ubo_->update_input(inputs_.ws_frustum_directions, ws_frustum_directions);
     }
 
     // Store the frame delta
-    input_ubo_->update_input("frame_delta", static_cast<float>(Globals::clock->get_dt()));
-    input_ubo_->update_input("smooth_frame_delta", static_cast<float>(1.0 / (std::max)(1e-5, Globals::clock->get_average_frame_rate())));
-    input_ubo_->update_input("frame_time", static_cast<float>(Globals::clock->get_frame_time()));
+    input_ubo_->update_input(inputs_.frame_delta, static_cast<float>(Globals::clock->get_dt()));
+    input_ubo_->update_input(inputs_.smooth_frame_delta, static_cast<float>(1.0 / (std::max)(1e-5, Globals::clock->get_average_frame_rate())));
+    input_ubo_->update_input(inputs_.frame_time, static_cast<float>(Globals::clock->get_frame_time()));
 
     // Store the current film offset, we use this to compute the pixel-perfect
     // velocity, which is otherwise not possible.Usually this is always 0
     // except when SMAA and reprojection is enabled
-    input_ubo_->update_input("current_film_offset", showbase_->get_cam_lens()->get_film_offset());
-    input_ubo_->update_input("frame_index", Globals::clock->get_frame_count());
+    input_ubo_->update_input(inputs_.current_film_offset, showbase_->get_cam_lens()->get_film_offset());
+    input_ubo_->update_input(inputs_.frame_index, Globals::clock->get_frame_count());
 
-    input_ubo_->update_input("screen_size", Globals::resolution);
-    input_ubo_->update_input("native_screen_size", Globals::native_resolution);
-    input_ubo_->update_input("lc_tile_count", pipeline_.get_light_mgr()->get_num_tiles());
+    input_ubo_->update_input(inputs_.screen_size, Globals::resolution);
+    input_ubo_->update_input(inputs_.native_screen_size, Globals::native_resolution);
+    input_ubo_->update_input(inputs_.lc_tile_count, pipeline_.get_light_mgr()->get_num_tiles());
 }
 
 void CommonResources::load_fonts()
@@ -344,54 +344,42 @@ void CommonResources::setup_inputs()
 
     input_ubo_ = std::make_shared<GroupedInputBlock>("MainSceneData");
 
-    if (stereo_mode)
-    {
-        input_ubo_->register_pta("stereo_camera_pos[2]", "vec3");
-        input_ubo_->register_pta("stereo_view_proj_mat_no_jitter[2]", "mat4");
-        input_ubo_->register_pta("stereo_last_view_proj_mat_no_jitter[2]", "mat4");
-        input_ubo_->register_pta("stereo_last_inv_view_proj_mat_no_jitter[2]", "mat4");
-        input_ubo_->register_pta("stereo_view_mat_z_up[2]", "mat4");
-    }
-    else
-    {
-        input_ubo_->register_pta("camera_pos", "vec3");
-        input_ubo_->register_pta("view_proj_mat_no_jitter", "mat4");
-        input_ubo_->register_pta("last_view_proj_mat_no_jitter", "mat4");
-        input_ubo_->register_pta("last_inv_view_proj_mat_no_jitter", "mat4");
-        input_ubo_->register_pta("view_mat_z_up", "mat4");
-    }
+    // The stereo inputs have "stereo_" prefix and an element for each eye
+    const auto& eye_input = [stereo_mode](const std::string& name) {
+        return stereo_mode ? ("stereo_" + name + "[2]") : name;
+    };
+
+    inputs_.camera_pos = input_ubo_->register_pta<PTA_LVecBase3f>(eye_input("camera_pos"));
+    inputs_.view_proj_mat_no_jitter = input_ubo_->register_pta<PTA_LMatrix4f>(eye_input("view_proj_mat_no_jitter"));
+    inputs_.last_view_proj_mat_no_jitter = input_ubo_->register_pta<PTA_LMatrix4f>(eye_input("last_view_proj_mat_no_jitter"));
+    inputs_.last_inv_view_proj_mat_no_jitter = input_ubo_->register_pta<PTA_LMatrix4f>(eye_input("last_inv_view_proj_mat_no_jitter"));
+    inputs_.view_mat_z_up = input_ubo_->register_pta<PTA_LMatrix4f>(eye_input("view_mat_z_up"));
+
+    inputs_.proj_mat = input_ubo_->register_pta<PTA_LMatrix4f>(eye_input("proj_mat"));
+    inputs_.inv_proj_mat = input_ubo_->register_pta<PTA_LMatrix4f>(eye_input("inv_proj_mat"));
+    inputs_.view_mat_billboard = input_ubo_->register_pta<PTA_LMatrix4f>(eye_input("view_mat_billboard"));
 
     if (stereo_mode)
     {
-        input_ubo_->register_pta("stereo_proj_mat[2]", "mat4");
-        input_ubo_->register_pta("stereo_inv_proj_mat[2]", "mat4");
-        input_ubo_->register_pta("stereo_view_mat_billboard[2]", "mat4");
-
-        input_ubo_->register_pta("stereo_ViewMatrix[2]", "mat4");
-        input_ubo_->register_pta("stereo_ProjectionMatrix[2]", "mat4");
-        input_ubo_->register_pta("stereo_ViewProjectionMatrix[2]", "mat4");
-        input_ubo_->register_pta("stereo_ViewProjectionMatrixInverse[2]", "mat4");
-    }
-    else
-    {
-        input_ubo_->register_pta("proj_mat", "mat4");
-        input_ubo_->register_pta("inv_proj_mat", "mat4");
-        input_ubo_->register_pta("view_mat_billboard", "mat4");
+        inputs_.view_matrix = input_ubo_->register_pta<PTA_LMatrix4f>("stereo_ViewMatrix[2]");
+        inputs_.projection_matrix = input_ubo_->register_pta<PTA_LMatrix4f>("stereo_ProjectionMatrix[2]");
+        inputs_.view_projection_matrix = input_ubo_->register_pta<PTA_LMatrix4f>("stereo_ViewProjectionMatrix[2]");
+        inputs_.view_projection_matrix_inverse = input_ubo_->register_pta<PTA_LMatrix4f>("stereo_ViewProjectionMatrixInverse[2]");
     }
 
-    input_ubo_->register_pta("frame_delta", "float");
-    input_ubo_->register_pta("smooth_frame_delta", "float");
-    input_ubo_->register_pta("frame_time", "float");
-    input_ubo_->register_pta("current_film_offset", "vec2");
-    input_ubo_->register_pta("frame_index", "int");
-    input_ubo_->register_pta("screen_size", "ivec2");
-    input_ubo_->register_pta("native_screen_size", "ivec2");
-    input_ubo_->register_pta("lc_tile_count", "ivec2");
+    inputs_.frame_delta = input_ubo_->register_pta<PTA_float>("frame_delta");
+    inputs_.smooth_frame_delta = input_ubo_->register_pta<PTA_float>("smooth_frame_delta");
+    inputs_.frame_time = input_ubo_->register_pta<PTA_float>("frame_time");
+    inputs_.current_film_offset = input_ubo_->register_pta<PTA_LVecBase2f>("current_film_offset");
+    inputs_.frame_index = input_ubo_->register_pta<PTA_int>("frame_index");
+    inputs_.screen_size = input_ubo_->register_pta<PTA_LVecBase2i>("screen_size");
+    inputs_.native_screen_size = input_ubo_->register_pta<PTA_LVecBase2i>("native_screen_size");
+    inputs_.lc_tile_count = input_ubo_->register_pta<PTA_LVecBase2i>("lc_tile_count");
 
     if (!stereo_mode)
     {
-        input_ubo_->register_pta("vs_frustum_directions", "mat4");    // view space frustum
-        input_ubo_->register_pta("ws_frustum_directions", "mat4");    // world space frustum
+        inputs_.vs_frustum_directions = input_ubo_->register_pta<PTA_LMatrix4f>("vs_frustum_directions");    // view space frustum
+        inputs_.ws_frustum_directions = input_ubo_->register_pta<PTA_LMatrix4f>("ws_frustum_directions");    // world space frustum
     }
 
     pipeline_.get_stage_mgr()->add_input_blocks(input_ubo_);
@@ -75,6 +75,38 @@ private:
     RenderPipeline& pipeline_;
     rppanda::ShowBase* showbase_;
     std::shared_ptr<GroupedInputBlock> input_ubo_;
+
+    /** Handles of the inputs in input_ubo_. In stereo mode, they have an element for each eye. */
+    struct Inputs
+    {
+        GroupedInputBlock::Handle<PTA_LVecBase3f> camera_pos;
+        GroupedInputBlock::Handle<PTA_LMatrix4f> view_proj_mat_no_jitter;
+        GroupedInputBlock::Handle<PTA_LMatrix4f> last_view_proj_mat_no_jitter;
+        GroupedInputBlock::Handle<PTA_LMatrix4f> last_inv_view_proj_mat_no_jitter;
+        GroupedInputBlock::Handle<PTA_LMatrix4f> view_mat_z_up;
+        GroupedInputBlock::Handle<PTA_LMatrix4f> proj_mat;
+        GroupedInputBlock::Handle<PTA_LMatrix4f> inv_proj_mat;
+        GroupedInputBlock::Handle<PTA_LMatrix4f> view_mat_billboard;
+
+        // stereo mode only
+        GroupedInputBlock::Handle<PTA_LMatrix4f> view_matrix;
+        GroupedInputBlock::Handle<PTA_LMatrix4f> projection_matrix;
+        GroupedInputBlock::Handle<PTA_LMatrix4f> view_projection_matrix;
+        GroupedInputBlock::Handle<PTA_LMatrix4f> view_projection_matrix_inverse;
+
+        GroupedInputBlock::Handle<PTA_float> frame_delta;
+        GroupedInputBlock::Handle<PTA_float> smooth_frame_delta;
+        GroupedInputBlock::Handle<PTA_float> frame_time;
+        GroupedInputBlock::Handle<PTA_LVecBase2f> current_film_offset;
+        GroupedInputBlock::Handle<PTA_int> frame_index;
+        GroupedInputBlock::Handle<PTA_LVecBase2i> screen_size;
+        GroupedInputBlock::Handle<PTA_LVecBase2i> native_screen_size;
+        GroupedInputBlock::Handle<PTA_LVecBase2i> lc_tile_count;
+
+        // mono mode only
+        GroupedInputBlock::Handle<PTA_LMatrix4f> vs_frustum_directions;
+        GroupedInputBlock::Handle<PTA_LMatrix4f> ws_frustum_directions;
+    } inputs_;
 };
 
 }
@@ -22,34 +22,93 @@
 
 #include "render_pipeline/rpcore/effect.hpp"
 
-#include <regex>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <limits>
+#include <mutex>
 
 #include <shader.h>
 #include <filename.h>
 #include <graphicsWindow.h>
+#include <virtualFileSystem.h>
+#include <virtualFileList.h>
 
 #include <fmt/format.h>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/utility/string_view.hpp>
 
 #include "render_pipeline/rppanda/stdpy/file.hpp"
 #include "render_pipeline/rppanda/showbase/showbase.hpp"
 #include "render_pipeline/rpcore/render_pipeline.hpp"
 #include "render_pipeline/rpcore/globals.hpp"
 #include "render_pipeline/rpcore/loader.hpp"
+#include "render_pipeline/rpcore/mount_manager.hpp"
 #include "render_pipeline/rpcore/stage_manager.hpp"
 
 #include "rplibs/yaml.hpp"
+#include "render_pipeline/rplibs/hash.hpp"
+#include "render_pipeline/rplibs/thread_pool.hpp"
 
 namespace rpcore {
 
 class Effect::Impl
 {
 public:
-    using InjectionType = std::unordered_map<std::string, std::vector<std::string>>;
+    using InjectionType = std::unordered_map<std::string, std::vector<boost::string_view>>;
+
+    /**
+     * Shader template which is parsed once and shared by all effects until
+     * the cache is cleared.
+     * The content has the lines of the template except the hooks, and each
+     * hook stores the position in the content where it was found.
+     */
+    struct ShaderTemplate
+    {
+        struct Hook
+        {
+            size_t offset;
+            std::string name;
+            std::string indent;
+            bool in_main;
+        };
+
+        time_t mtime;
+        std::streamsize size;
+        uint64_t hash;
+        std::string content;
+        std::vector<Hook> hooks;
+    };
+
+    /** Shader of a pass and a stage, which is constructed from its template. */
+    struct ShaderSource
+    {
+        std::string stage;
+        std::string pass_id;
+
+        /** Name of the template, used in the header of the shader. */
+        std::string template_name;
+        std::shared_ptr<const ShaderTemplate> shader_template;
+
+        /** Injections of the stage in the effect file. */
+        YAML::Node data;
+
+        std::string dest_path;
+        std::string output;
+    };
 
     static std::string generate_hash(const Filename& filename, const OptionType& options);
 
+    /**
+     * Returns the parsed shader template. The template is kept until the
+     * modification time or the size of the file changes.
+     */
+    static std::shared_ptr<const ShaderTemplate> get_template(const Filename& template_src);
+
+    /** Splits the template into the content and the hooks. */
+    static void parse_template(const std::string& source, ShaderTemplate& result);
+
 public:
     /**
      * Configuration options which can be set per effect instance.These control
@@ -75,6 +134,25 @@ public:
      */
     static int effect_id_;
 
+    /**
+     * Generated shaders are stored in this directory with a key of their
+     * content, so that they are not generated again in the next run.
+     * The directory does not start with "$$", so it is not removed on exit.
+     * Older shaders of the same effect and options are removed when a
+     * shader is written.
+     */
+    static constexpr const char* disk_cache_dir_ = "/$$rptemp/effect_cache";
+
+    /** Increase this when the output of process_shader_template changes. */
+    static constexpr uint64_t disk_cache_version_ = 1;
+
+    static std::unordered_map<std::string, std::shared_ptr<const ShaderTemplate>> templates_;
+    static std::mutex templates_mutex_;
+
+    static std::atomic<size_t> num_memory_cache_hits_;
+    static std::atomic<size_t> num_disk_cache_hits_;
+    static std::atomic<size_t> num_cache_misses_;
+
 public:
     /**
      * Constructs an effect name from a filename, this is used for writing
@@ -82,26 +160,71 @@ public:
      */
     std::string convert_filename_to_name(const Filename& filepath);
 
-    /** Internal method to construct the effect from a yaml object. */
+    /** Returns the shader template of the pass and the stage, or empty filename if the stage is not used. */
+    Filename get_template_src(RenderPipeline& pipeline, const PassType& pass, const std::string& stage) const;
+
+    /**
+     * Computes the paths of the generated shaders in the disk cache, and
+     * returns true if all of them exist already.
+     */
+    bool lookup_disk_cache(RenderPipeline& pipeline, const std::string& yaml_content);
+
+    /**
+     * Returns the path prefix of the cached shaders of a stage and a pass.
+     * The prefix is the same for all versions of the effect file and the
+     * templates with the same options.
+     */
+    std::string get_disk_cache_prefix(const std::string& stage, const std::string& pass_id) const;
+
+    /**
+     * Removes the cached shaders which have the same prefix as the written
+     * shaders, but belong to an older version of the effect or the templates.
+     */
+    void remove_stale_disk_cache_files(const std::vector<std::string>& written_paths) const;
+
+    /** Sets the effect file, and the names derived from it. */
+    void set_filename(const Filename& filename);
+
+    /**
+     * Generates the shaders of all passes, or finds them in the disk cache.
+     * This calls prepare_shaders, build_shaders and write_shaders in order.
+     */
+    bool generate_shaders(RenderPipeline& pipeline, Effect& self, bool use_disk_cache);
+
+    /**
+     * Reads the effect file and the templates of the shaders, or finds the
+     * shaders in the disk cache. This uses the VFS and the pipeline, so it
+     * runs on the calling thread.
+     */
+    bool prepare_shaders(RenderPipeline& pipeline, Effect& self, bool use_disk_cache);
+
+    /**
+     * Constructs the sources of the shaders from the templates. This only
+     * builds strings, so it can run on a worker thread.
+     */
+    void build_shaders(Effect& self);
+
+    /** Writes the constructed shaders to their files. This runs on the calling thread. */
+    void write_shaders(Effect& self);
+
+    /** Creates the shader objects from the generated shaders. */
+    void create_shader_objs();
+
+    /** Internal method to collect the shaders of the effect from a yaml object. */
     void parse_content(RenderPipeline& pipeline, Effect& self, YAML::Node& parsed_yaml);
 
     /**
      * Parses a fragment template. This just finds the default template
-     * for the shader, and redirects that to construct_shader_from_data.
+     * for the shader, and adds the shader to be constructed from the data.
      */
     void parse_shader_template(RenderPipeline& pipeline, Effect& self, const PassType& pass_id_multiview, const std::string& stage,
         YAML::Node& data);
 
     /** Constructs a shader from a given dataset. */
-    std::string construct_shader_from_data(Effect& self, const std::string& pass_id, const std::string& stage,
-        const Filename& template_src, YAML::Node& data);
+    void construct_shader_from_data(Effect& self, ShaderSource& source);
 
-    /**
-     * Generates a compiled shader object from a given shader
-     * source location and code injection definitions.
-     */
-    std::string process_shader_template(Effect& self, const Filename& template_src,
-        const std::string& cache_key, InjectionType& injections);
+    /** Generates the shader code from the template and code injection definitions. */
+    void process_shader_template(Effect& self, ShaderSource& source, InjectionType& injections);
 
 public:
     int this_effect_id_ = effect_id_;
@@ -110,6 +233,11 @@ public:
     std::string effect_hash_;
     OptionType options_;
     std::unordered_map<std::string, std::string> generated_shader_paths_;
+    std::unordered_map<std::string, std::string> disk_cache_paths_;
+    std::vector<std::string> option_defines_;
+
+    /** Shaders to be constructed and written, after prepare_shaders. */
+    std::vector<ShaderSource> shader_sources_;
 
     std::unordered_map<std::string, PT(Shader)> shader_objs_;
 };
@@ -130,6 +258,13 @@ std::vector<Effect::PassType> Effect::Impl::passes_ = {{"gbuffer", true}, {"shad
 
 std::unordered_map<std::string, std::shared_ptr<Effect>> Effect::Impl::global_cache_;
 int Effect::Impl::effect_id_ = 0;
+constexpr const char* Effect::Impl::disk_cache_dir_;
+constexpr uint64_t Effect::Impl::disk_cache_version_;
+std::unordered_map<std::string, std::shared_ptr<const Effect::Impl::ShaderTemplate>> Effect::Impl::templates_;
+std::mutex Effect::Impl::templates_mutex_;
+std::atomic<size_t> Effect::Impl::num_memory_cache_hits_{0};
+std::atomic<size_t> Effect::Impl::num_disk_cache_hits_{0};
+std::atomic<size_t> Effect::Impl::num_cache_misses_{0};
 
 std::string Effect::Impl::generate_hash(const Filename& filename, const OptionType& options)
 {
@@ -161,6 +296,111 @@ std::string Effect::Impl::generate_hash(const Filename& filename, const OptionTy
     return file_hash + "-" + options_hash;
 }
 
+std::shared_ptr<const Effect::Impl::ShaderTemplate> Effect::Impl::get_template(const Filename& template_src)
+{
+    VirtualFileSystem* vfs = VirtualFileSystem::get_global_ptr();
+    PT(VirtualFile) file = vfs->get_file(template_src, true);
+    if (!file)
+        return nullptr;
+
+    const time_t mtime = file->get_timestamp();
+    const std::streamsize size = file->get_file_size();
+
+    {
+        std::lock_guard<std::mutex> lock(templates_mutex_);
+        auto found = templates_.find(template_src.get_fullpath());
+        if (found != templates_.end() && found->second->mtime == mtime && found->second->size == size)
+            return found->second;
+    }
+
+    std::string source;
+    if (!file->read_file(source, true))
+        return nullptr;
+
+    auto shader_template = std::make_shared<ShaderTemplate>();
+    shader_template->mtime = mtime;
+    shader_template->size = size;
+
+    rplibs::FNV1aHash hasher;
+    hasher.update(source);
+    shader_template->hash = hasher.get_digest();
+
+    parse_template(source, *shader_template);
+
+    std::lock_guard<std::mutex> lock(templates_mutex_);
+    templates_[template_src.get_fullpath()] = shader_template;
+    return shader_template;
+}
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+static boost::string_view trim_left(boost::string_view str)
+{
+    while (!str.empty() && is_space(str.front()))
+        str.remove_prefix(1);
+    return str;
+}
+
+static boost::string_view trim_right(boost::string_view str)
+{
+    while (!str.empty() && is_space(str.back()))
+        str.remove_suffix(1);
+    return str;
+}
+
+void Effect::Impl::parse_template(const std::string& source, ShaderTemplate& result)
+{
+    result.content.clear();
+    result.content.reserve(source.size() + 1);
+    result.hooks.clear();
+
+    // Store whether we are in the main function already - we need this
+    // to properly insert scoped code blocks
+    bool in_main = false;
+
+    size_t line_start = 0;
+    while (true)
+    {
+        const size_t line_end = (std::min)(source.find('\n', line_start), source.size());
+        const boost::string_view line(source.data() + line_start, line_end - line_start);
+        const boost::string_view stripped_line = trim_right(trim_left(line));
+
+        // Check if we are already in the main function
+        if (!in_main && boost::algorithm::icontains(stripped_line, "void main()"))
+            in_main = true;
+
+        // Check if the current line is a hook
+        if (!stripped_line.empty() && stripped_line.front() == '%' && stripped_line.back() == '%')
+        {
+            // If the line is a hook, get the hook name and save the
+            // indent so we can indent all injected lines properly.
+            const boost::string_view hook_name = stripped_line.substr(1, stripped_line.size() - 2);
+            result.hooks.push_back(ShaderTemplate::Hook{
+                result.content.size(),
+                boost::algorithm::to_lower_copy(hook_name.to_string()),
+                std::string(line.size() - trim_left(line).size(), ' '),
+                in_main});
+        }
+        else
+        {
+            const boost::string_view trimmed_line = trim_right(line);
+            result.content.append(trimmed_line.data(), trimmed_line.size());
+            result.content += '\n';
+        }
+
+        if (line_end == source.size())
+            break;
+        line_start = line_end + 1;
+    }
+
+    // The template is always closed with an empty line
+    if (!source.empty() && source.back() != '\n')
+        result.content += '\n';
+}
+
 std::string Effect::Impl::convert_filename_to_name(const Filename& filepath)
 {
     std::string filename = filepath.get_basename_wo_extension();
@@ -170,8 +410,174 @@ std::string Effect::Impl::convert_filename_to_name(const Filename& filepath)
     return filename;
 }
 
+void Effect::Impl::set_filename(const Filename& filename)
+{
+    filename_ = filename;
+    effect_name_ = convert_filename_to_name(filename);
+    effect_hash_ = generate_hash(filename, options_);
+}
+
+bool Effect::Impl::generate_shaders(RenderPipeline& pipeline, Effect& self, bool use_disk_cache)
+{
+    if (!prepare_shaders(pipeline, self, use_disk_cache))
+        return false;
+
+    build_shaders(self);
+    write_shaders(self);
+
+    return true;
+}
+
+bool Effect::Impl::prepare_shaders(RenderPipeline& pipeline, Effect& self, bool use_disk_cache)
+{
+    VirtualFileSystem* vfs = VirtualFileSystem::get_global_ptr();
+
+    // Read the YAML file
+    std::string yaml_content;
+    if (!vfs->read_file(filename_, yaml_content, true))
+    {
+        self.error(fmt::format("Failed to read file ({})", filename_.to_os_specific()));
+        return false;
+    }
+
+    shader_sources_.clear();
+
+    // Reuse the shaders generated in the previous run if nothing changed.
+    // On the ramdisk, the cache would only be a copy of the shaders in memory.
+    if (use_disk_cache && MountManager::is_write_path_persistent() && lookup_disk_cache(pipeline, yaml_content))
+    {
+        ++num_disk_cache_hits_;
+        return true;
+    }
+
+    ++num_cache_misses_;
+
+    YAML::Node parsed_yaml;
+    try
+    {
+        parsed_yaml = YAML::Load(yaml_content);
+    }
+    catch (const std::exception& err)
+    {
+        self.error(fmt::format("Failed to parse YAML file ({}): {}", filename_.to_os_specific(), err.what()));
+        return false;
+    }
+
+    if (!disk_cache_paths_.empty())
+        vfs->make_directory_full(disk_cache_dir_);
+
+    parse_content(pipeline, self, parsed_yaml);
+
+    return true;
+}
+
+void Effect::Impl::build_shaders(Effect& self)
+{
+    for (auto& source: shader_sources_)
+        construct_shader_from_data(self, source);
+}
+
+void Effect::Impl::write_shaders(Effect& self)
+{
+    VirtualFileSystem* vfs = VirtualFileSystem::get_global_ptr();
+    std::vector<std::string> written_cache_paths;
+
+    for (const auto& source: shader_sources_)
+    {
+        // Write the constructed shader and load it back.
+        // The file is written to a temporary name first, so that an interrupted
+        // write does not leave a broken file in the disk cache.
+        const std::string& temp_path = source.dest_path + ".tmp";
+
+        try
+        {
+            {
+                auto file = rppanda::open_write_file(temp_path, false, true);
+                if (!file)
+                    throw std::runtime_error("Failed to open " + temp_path);
+                file->write(source.output.data(), source.output.size());
+            }
+
+            vfs->delete_file(source.dest_path);
+            if (!vfs->rename_file(temp_path, source.dest_path))
+                throw std::runtime_error("Failed to rename " + temp_path);
+
+            if (!disk_cache_paths_.empty())
+                written_cache_paths.push_back(source.dest_path);
+        }
+        catch (const std::exception& err)
+        {
+            self.error(std::string("Error writing processed shader: ") + err.what());
+        }
+
+        generated_shader_paths_[source.stage + "-" + source.pass_id] = source.dest_path;
+    }
+
+    shader_sources_.clear();
+
+    if (!written_cache_paths.empty())
+        remove_stale_disk_cache_files(written_cache_paths);
+}
+
+std::string Effect::Impl::get_disk_cache_prefix(const std::string& stage, const std::string& pass_id) const
+{
+    return fmt::format("{}/{}@{}-{}@{}@", disk_cache_dir_, effect_name_, stage, pass_id, effect_hash_);
+}
+
+void Effect::Impl::remove_stale_disk_cache_files(const std::vector<std::string>& written_paths) const
+{
+    VirtualFileSystem* vfs = VirtualFileSystem::get_global_ptr();
+
+    PT(VirtualFileList) file_list = vfs->scan_directory(disk_cache_dir_);
+    if (!file_list)
+        return;
+
+    for (size_t k = 0, k_end = file_list->get_num_files(); k < k_end; ++k)
+    {
+        const Filename& path = file_list->get_file(k)->get_filename();
+        const std::string& fullpath = path.get_fullpath();
+
+        for (const auto& written_path: written_paths)
+        {
+            // The prefix ends before the hash of the content
+            const size_t prefix_length = written_path.rfind('@') + 1;
+            if (fullpath != written_path && fullpath.size() > prefix_length &&
+                fullpath.compare(0, prefix_length, written_path, 0, prefix_length) == 0)
+            {
+                vfs->delete_file(path);
+                break;
+            }
+        }
+    }
+}
+
+void Effect::Impl::create_shader_objs()
+{
+    // Construct a shader object for each pass
+    for (const auto& pass_id_multiview: passes_)
+    {
+        const std::string& vertex_src = generated_shader_paths_.at("vertex-" + pass_id_multiview.id);
+        const std::string& fragment_src = generated_shader_paths_.at("fragment-" + pass_id_multiview.id);
+        std::string geometry_src;
+
+        auto geometry_src_iter = generated_shader_paths_.find("geometry-" + pass_id_multiview.id);
+        if (geometry_src_iter != generated_shader_paths_.end())
+            geometry_src = geometry_src_iter->second;
+
+        shader_objs_.insert_or_assign(pass_id_multiview.id, RPLoader::load_shader({vertex_src, fragment_src, geometry_src}));
+    }
+}
+
 void Effect::Impl::parse_content(RenderPipeline& pipeline, Effect& self, YAML::Node& parsed_yaml)
 {
+    // The option defines are the same for all passes and stages
+    option_defines_.clear();
+    for (const auto& key_val: options_)
+    {
+        option_defines_.push_back(std::string("#define OPT_") +
+            boost::algorithm::to_upper_copy(key_val.first) + (key_val.second ? " 1" : " 0"));
+    }
+
     YAML::Node vtx_data = parsed_yaml["vertex"];
     YAML::Node geom_data = parsed_yaml["geometry"];
     YAML::Node frag_data = parsed_yaml["fragment"];
@@ -184,7 +590,7 @@ void Effect::Impl::parse_content(RenderPipeline& pipeline, Effect& self, YAML::N
     }
 }
 
-void Effect::Impl::parse_shader_template(RenderPipeline& pipeline, Effect& self, const PassType& pass, const std::string& stage, YAML::Node& data)
+Filename Effect::Impl::get_template_src(RenderPipeline& pipeline, const PassType& pass, const std::string& stage) const
 {
     const std::string& pass_id = pass.id;
     bool stereo_mode = pipeline.is_stereo_mode() && pass.stereo_flag;
@@ -228,6 +634,74 @@ void Effect::Impl::parse_shader_template(RenderPipeline& pipeline, Effect& self,
         }
     }
 
+    return template_src;
+}
+
+bool Effect::Impl::lookup_disk_cache(RenderPipeline& pipeline, const std::string& yaml_content)
+{
+    // The generated shaders depend on the effect file, the options and the
+    // templates only. The defines of the pipeline are included by the shaders
+    // when they are loaded, so they are not a part of the key.
+    Filename fname = filename_;
+    fname.make_absolute();
+
+    rplibs::FNV1aHash effect_hasher;
+    effect_hasher.update(disk_cache_version_);
+    effect_hasher.update(fname.get_fullpath());
+    effect_hasher.update(yaml_content);
+
+    std::vector<std::pair<std::string, bool>> sorted_options(options_.begin(), options_.end());
+    std::sort(sorted_options.begin(), sorted_options.end());
+    for (const auto& pair: sorted_options)
+    {
+        effect_hasher.update(pair.first);
+        effect_hasher.update(pair.second ? 1u : 0u);
+    }
+
+    disk_cache_paths_.clear();
+    bool all_cached = true;
+    for (const auto& pass: passes_)
+    {
+        for (const std::string stage: {"vertex", "geometry", "fragment"})
+        {
+            const Filename& template_src = get_template_src(pipeline, pass, stage);
+            if (template_src.empty())
+                continue;
+
+            // let the normal path report the missing template
+            const auto& shader_template = get_template(template_src);
+            if (!shader_template)
+            {
+                disk_cache_paths_.clear();
+                return false;
+            }
+
+            rplibs::FNV1aHash shader_hasher(effect_hasher);
+            shader_hasher.update(stage);
+            shader_hasher.update(pass.id);
+            shader_hasher.update(template_src.get_fullpath());
+            shader_hasher.update(shader_template->hash);
+
+            const std::string& cache_path = fmt::format("{}{:016x}.glsl",
+                get_disk_cache_prefix(stage, pass.id), shader_hasher.get_digest());
+
+            if (all_cached && !rppanda::isfile(cache_path))
+                all_cached = false;
+
+            disk_cache_paths_[stage + "-" + pass.id] = cache_path;
+        }
+    }
+
+    if (!all_cached)
+        return false;
+
+    generated_shader_paths_ = disk_cache_paths_;
+    return true;
+}
+
+void Effect::Impl::parse_shader_template(RenderPipeline& pipeline, Effect& self, const PassType& pass, const std::string& stage, YAML::Node& data)
+{
+    const Filename& template_src = get_template_src(pipeline, pass, stage);
     if (template_src.empty())
         return;
 
@@ -237,34 +711,74 @@ void Effect::Impl::parse_shader_template(RenderPipeline& pipeline, Effect& self,
         return;
     }
 
-    const std::string& shader_path = construct_shader_from_data(self, pass_id, stage, template_src, data);
-    generated_shader_paths_[stage + "-" + pass_id] = shader_path;
+    ShaderSource source;
+    source.stage = stage;
+    source.pass_id = pass.id;
+    source.template_name = template_src.to_os_generic();
+    source.shader_template = get_template(template_src);
+    if (!source.shader_template)
+    {
+        self.error(std::string("Error reading shader template: ") + source.template_name);
+        return;
+    }
+    source.data = data;
+
+    auto cached = disk_cache_paths_.find(stage + "-" + pass.id);
+    if (cached != disk_cache_paths_.end())
+        source.dest_path = cached->second;
+    else
+        source.dest_path = std::string("/$$rptemp/$$effect-") + effect_name_ + "@" + stage + "-" + pass.id + "@" + effect_hash_ + ".glsl";
+
+    shader_sources_.push_back(std::move(source));
 }
 
-std::string Effect::Impl::construct_shader_from_data(Effect& self, const std::string& pass_id, const std::string& stage,
-    const Filename& template_src, YAML::Node& data)
+/** Splits the value into lines, without the empty line after the last newline. */
+static void split_lines(boost::string_view val, std::vector<boost::string_view>& result)
 {
-    InjectionType injects ={{std::string("defines"), {}}};
-
-    for (const auto& key_val: options_)
+    while (true)
     {
-        const std::string& val_str = key_val.second ? "1" : "0";
+        const size_t pos = val.find('\n');
+        if (pos == boost::string_view::npos)
+        {
+            result.push_back(val);
+            break;
+        }
 
-        injects["defines"].push_back(std::string("#define OPT_" +
-            boost::algorithm::to_upper_copy(key_val.first) + " " + val_str));
+        result.push_back(val.substr(0, pos));
+        val.remove_prefix(pos + 1);
+        if (val.empty())
+            break;
     }
+}
 
-    injects["defines"].push_back(std::string("#define IN_") + boost::algorithm::to_upper_copy(stage) + "_SHADER 1");
-    injects["defines"].push_back(std::string("#define IN_") + boost::algorithm::to_upper_copy(pass_id) + "_SHADER 1");
-    injects["defines"].push_back(std::string("#define IN_RENDERING_PASS 1"));
+void Effect::Impl::construct_shader_from_data(Effect& self, ShaderSource& source)
+{
+    const std::string& stage = source.stage;
+    const std::string& pass_id = source.pass_id;
+    YAML::Node& data = source.data;
+
+    // The injections are views of these strings,
+    // and std::deque does not move the elements when growing.
+    std::deque<std::string> storage;
+
+    InjectionType injects;
+    auto& defines = injects["defines"];
+    defines.assign(option_defines_.begin(), option_defines_.end());
+
+    storage.push_back(std::string("#define IN_") + boost::algorithm::to_upper_copy(stage) + "_SHADER 1");
+    defines.push_back(storage.back());
+    storage.push_back(std::string("#define IN_") + boost::algorithm::to_upper_copy(pass_id) + "_SHADER 1");
+    defines.push_back(storage.back());
+    defines.push_back("#define IN_RENDERING_PASS 1");
 
     // Parse dependencies
     if (data.IsDefined() && data["dependencies"])
     {
+        auto& includes = injects["includes"];
         for (const auto& dependency: data["dependencies"])
         {
-            const std::string& include_str = std::string("#pragma include \"") + dependency.as<std::string>() + "\"";
-            injects["includes"].push_back(include_str);
+            storage.push_back(std::string("#pragma include \"") + dependency.as<std::string>() + "\"");
+            includes.push_back(storage.back());
         }
         data.remove("dependencies");
     }
@@ -280,135 +794,90 @@ std::string Effect::Impl::construct_shader_from_data(Effect& self, const std::st
             continue;
         }
 
-        const std::string val(node.second.as<std::string>());
+        storage.push_back(node.second.as<std::string>());
         if (!node.second.IsScalar())
         {
             self.warn("Invalid syntax, you used a list but you should have used a string:");
-            self.warn(val);
+            self.warn(storage.back());
             continue;
         }
 
-        std::regex newline_re("\\n");
-        std::vector<std::string> parsed_val(std::sregex_token_iterator(val.begin(), val.end(), newline_re, -1), std::sregex_token_iterator());
-        injects[key].insert(injects[key].end(), parsed_val.begin(), parsed_val.end());
+        split_lines(storage.back(), injects[key]);
     }
 
-    const std::string& cache_key = effect_name_ + "@" + stage + "-" + pass_id + "@" + effect_hash_;
-    return process_shader_template(self, template_src, cache_key, injects);
+    process_shader_template(self, source, injects);
 }
 
-std::string Effect::Impl::process_shader_template(Effect& self, const Filename& template_src, const std::string& cache_key,
-    InjectionType& injections)
+void Effect::Impl::process_shader_template(Effect& self, ShaderSource& source, InjectionType& injections)
 {
-    std::vector<std::string> shader_lines;
-
-    try
-    {
-        auto file = rppanda::open_read_file(template_src, true);
-
-        do
-        {
-            shader_lines.push_back("");
-        } while (std::getline(*file, shader_lines.back()));
-    }
-    catch (const std::exception& err)
+    const auto& shader_template = source.shader_template;
+    const std::string& content = shader_template->content;
+
+    std::string& output = source.output;
+    output.clear();
+    output.reserve(content.size() + 4096);
+
+    output += "\n\n\n";
+    output += "/* Compiled Shader Template\n";
+    output += " * generated from: '" + source.template_name + "'\n";
+    output += " * cache key: '" + effect_name_ + "@" + source.stage + "-" + source.pass_id + "@" + effect_hash_ + "'\n";
+    output += " *\n";
+    output += " * !!! Autogenerated, do not edit! Your changes will be lost. !!!\n";
+    output += " */\n\n\n";
+
+    size_t content_pos = 0;
+    for (const auto& hook: shader_template->hooks)
     {
-        self.error(std::string("Error reading shader template: ") + err.what());
-    }
+        output.append(content, content_pos, hook.offset - content_pos);
+        content_pos = hook.offset;
 
-    std::vector<std::string> parsed_lines ={std::string("\n\n")};
-    parsed_lines.push_back("/* Compiled Shader Template");
-    parsed_lines.push_back(std::string(" * generated from: '") + template_src.to_os_generic() + "'");
-    parsed_lines.push_back(std::string(" * cache key: '") + cache_key + "'");
-    parsed_lines.push_back(" *");
-    parsed_lines.push_back(" * !!! Autogenerated, do not edit! Your changes will be lost. !!!");
-    parsed_lines.push_back(" */\n\n");
+        // Inject all registered template values into the hook
+        auto found = injections.find(hook.name);
+        if (found == injections.end())
+            continue;
 
-    // Store whether we are in the main function already - we need this
-    // to properly insert scoped code blocks
-    bool in_main = false;
+        // Directly remove the value from the list so we can check which
+        // hooks were not found in the template
+        const auto insertions = std::move(found->second);
+        injections.erase(found);
 
-    for (const auto& line: shader_lines)
-    {
-        const std::string stripped_line(boost::to_lower_copy(boost::trim_copy(line)));
+        if (insertions.empty())
+            continue;
 
-        // Check if we are already in the main function
-        if (stripped_line.find("void main()") != std::string::npos)
-            in_main = true;
+        // When we are in the main function, we have to make sure we
+        // use a seperate scope, so there are no conflicts with variable
+        // declarations
+        output += hook.indent;
+        output += "/* Hook: ";
+        output += hook.name;
+        output += hook.in_main ? " */ {\n" : " */\n";
 
-        // Check if the current line is a hook
-        if (!stripped_line.empty() && stripped_line.front() == '%' && stripped_line.back() == '%')
+        for (const auto& line_to_insert: insertions)
         {
-            // If the line is a hook, get the hook name and save the
-            // indent so we can indent all injected lines properly.
-            const std::string& hook_name = stripped_line.substr(1, stripped_line.size()-2);
-            const std::string indent(line.size() - boost::trim_left_copy(line).size(), ' ');
-
-            // Inject all registered template values into the hook
-            if (injections.find(hook_name) != injections.end())
+            if (line_to_insert.empty())
             {
-                // Directly remove the value from the list so we can check which
-                // hooks were not found in the template
-                auto insertions = std::move(injections.at(hook_name));
-                injections.erase(hook_name);
-
-                if (insertions.size() > 0)
-                {
-                    // When we are in the main function, we have to make sure we
-                    // use a seperate scope, so there are no conflicts with variable
-                    // declarations
-                    const std::string& header = indent + "/* Hook: " + hook_name + " */" + (in_main ? " {" : "");
-                    parsed_lines.push_back(header);
-
-                    for (const auto& line_to_insert: insertions)
-                    {
-                        if (line_to_insert.empty())
-                        {
-                            self.warn(std::string("Empty insertion a hook '") + hook_name + "'");
-                            continue;
-                        }
-
-                        // Dont indent defines and pragmas
-                        if (line_to_insert[0] == '#')
-                            parsed_lines.push_back(line_to_insert);
-                        else
-                            parsed_lines.push_back(indent + line_to_insert);
-                    }
-
-                    if (in_main)
-                        parsed_lines.push_back(indent + "}");
-                }
+                self.warn(std::string("Empty insertion a hook '") + hook.name + "'");
+                continue;
             }
+
+            // Dont indent defines and pragmas
+            if (line_to_insert[0] != '#')
+                output += hook.indent;
+            output.append(line_to_insert.data(), line_to_insert.size());
+            output += '\n';
         }
-        else
+
+        if (hook.in_main)
         {
-            parsed_lines.push_back(boost::trim_right_copy(line));
+            output += hook.indent;
+            output += "}\n";
         }
     }
-
-    // Add a closing newline to the file
-    // (C++: add newline when the file is written.)
-    //parsed_lines.push_back("");
+    output.append(content, content_pos, std::string::npos);
 
     // Warn the user about all unused hooks
     for (const auto& key_val: injections)
-        self.warn(std::string("Hook '") + key_val.first + "' not found in template '" + template_src.to_os_generic() + "'!");
-
-    // Write the constructed shader and load it back
-    const std::string& temp_path = std::string("/$$rptemp/$$effect-") + cache_key + ".glsl";
-
-    try
-    {
-        auto file = rppanda::open_write_file(temp_path, false, true);
-        for (const auto& shader_content: parsed_lines)
-            *file << shader_content << std::endl;
-    }
-    catch (const std::exception& err)
-    {
-        self.error(std::string("Error writing processed shader: ") + err.what());
-    }
-
-    return temp_path;
+        self.warn(std::string("Hook '") + key_val.first + "' not found in template '" + source.template_name + "'!");
 }
 
 // ************************************************************************************************
@@ -419,7 +888,10 @@ std::shared_ptr<Effect> Effect::load(RenderPipeline& pipeline, const Filename& f
 
     auto found = Impl::global_cache_.find(effect_hash);
     if (found != Impl::global_cache_.end())
+    {
+        ++Impl::num_memory_cache_hits_;
         return found->second;
+    }
 
     auto effect = std::make_shared<Effect>();
     effect->set_options(options);
@@ -429,9 +901,124 @@ std::shared_ptr<Effect> Effect::load(RenderPipeline& pipeline, const Filename& f
         return nullptr;
     }
 
+    Impl::global_cache_[effect_hash] = effect;
+
     return effect;
 }
 
+std::vector<std::shared_ptr<Effect>> Effect::load_many(RenderPipeline& pipeline, const std::vector<SourceType>& sources)
+{
+    constexpr size_t not_pending = (std::numeric_limits<size_t>::max)();
+
+    std::vector<std::shared_ptr<Effect>> effects(sources.size());
+
+    // Find the effects which are not loaded yet, and create each of them once
+    std::vector<std::shared_ptr<Effect>> pending;
+    std::unordered_map<std::string, size_t> pending_indices;
+    std::vector<size_t> source_to_pending(sources.size(), not_pending);
+    for (size_t k = 0, k_end = sources.size(); k < k_end; ++k)
+    {
+        const std::string& effect_hash = Impl::generate_hash(sources[k].first, sources[k].second);
+
+        auto found = Impl::global_cache_.find(effect_hash);
+        if (found != Impl::global_cache_.end())
+        {
+            ++Impl::num_memory_cache_hits_;
+            effects[k] = found->second;
+            continue;
+        }
+
+        auto result = pending_indices.emplace(effect_hash, pending.size());
+        if (result.second)
+        {
+            auto effect = std::make_shared<Effect>();
+            effect->set_options(sources[k].second);
+            effect->impl_->set_filename(sources[k].first);
+            pending.push_back(effect);
+        }
+        else
+        {
+            ++Impl::num_memory_cache_hits_;
+        }
+        source_to_pending[k] = result.first->second;
+    }
+
+    // The files are read and the disk cache is looked up on this thread,
+    // because they use the VFS and the pipeline.
+    const bool use_disk_cache = pipeline.get_setting<bool>("pipeline.effect_disk_cache", true);
+    std::vector<char> succeeded(pending.size(), 0);
+    for (size_t k = 0, k_end = pending.size(); k < k_end; ++k)
+        succeeded[k] = pending[k]->impl_->prepare_shaders(pipeline, *pending[k], use_disk_cache);
+
+    // Construct the shaders on the workers. Each effect only writes to its own strings.
+    rplibs::ThreadPool::get_global_pool().parallel_for(pending.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k)
+        {
+            if (succeeded[k])
+                pending[k]->impl_->build_shaders(*pending[k]);
+        }
+    });
+
+    // The shaders are written and Panda3D shader objects are created on this thread
+    for (size_t k = 0, k_end = pending.size(); k < k_end; ++k)
+    {
+        if (!succeeded[k])
+        {
+            RPObject::global_error("Effect", "Could not load effect!");
+            pending[k].reset();
+            continue;
+        }
+
+        pending[k]->impl_->write_shaders(*pending[k]);
+        pending[k]->impl_->create_shader_objs();
+        Impl::global_cache_[pending[k]->impl_->effect_hash_] = pending[k];
+    }
+
+    for (size_t k = 0, k_end = sources.size(); k < k_end; ++k)
+    {
+        if (source_to_pending[k] != not_pending)
+            effects[k] = pending[source_to_pending[k]];
+    }
+
+    return effects;
+}
+
+void Effect::clear_cache()
+{
+    Impl::global_cache_.clear();
+
+    // The templates are validated only by the time and size of the files,
+    // so reloading reads them again.
+    std::lock_guard<std::mutex> lock(Impl::templates_mutex_);
+    Impl::templates_.clear();
+}
+
+std::vector<Filename> Effect::get_cached_shader_files()
+{
+    std::vector<Filename> shader_files;
+    for (const auto& key_effect: Impl::global_cache_)
+    {
+        for (const auto& stage_path: key_effect.second->impl_->generated_shader_paths_)
+            shader_files.push_back(stage_path.second);
+    }
+    return shader_files;
+}
+
+size_t Effect::get_num_memory_cache_hits()
+{
+    return Impl::num_memory_cache_hits_;
+}
+
+size_t Effect::get_num_disk_cache_hits()
+{
+    return Impl::num_disk_cache_hits_;
+}
+
+size_t Effect::get_num_cache_misses()
+{
+    return Impl::num_cache_misses_;
+}
+
 const Effect::OptionType& Effect::get_default_options()
 {
     return Impl::default_options_;
@@ -486,29 +1073,12 @@ void Effect::set_options(const OptionType& options)
 
 bool Effect::do_load(RenderPipeline& pipeline, const Filename& filename)
 {
-    impl_->filename_ = filename;
-    impl_->effect_name_ = impl_->convert_filename_to_name(filename);
-    impl_->effect_hash_ = impl_->generate_hash(filename, impl_->options_);
+    impl_->set_filename(filename);
 
-    // Load the YAML file
-    YAML::Node parsed_yaml;
-    if (!rplibs::load_yaml_file(filename, parsed_yaml))
+    if (!impl_->generate_shaders(pipeline, *this, pipeline.get_setting<bool>("pipeline.effect_disk_cache", true)))
         return false;
-    impl_->parse_content(pipeline, *this, parsed_yaml);
 
-    // Construct a shader object for each pass
-    for (const auto& pass_id_multiview: Impl::passes_)
-    {
-        const std::string& vertex_src = impl_->generated_shader_paths_.at("vertex-" + pass_id_multiview.id);
-        const std::string& fragment_src = impl_->generated_shader_paths_.at("fragment-" + pass_id_multiview.id);
-        std::string geometry_src;
-
-        auto geometry_src_iter = impl_->generated_shader_paths_.find("geometry-" + pass_id_multiview.id);
-        if (geometry_src_iter != impl_->generated_shader_paths_.end())
-            geometry_src = geometry_src_iter->second;
-
-        impl_->shader_objs_.insert_or_assign(pass_id_multiview.id, RPLoader::load_shader({vertex_src, fragment_src, geometry_src}));
-    }
+    impl_->create_shader_objs();
 
     return true;
 }
@@ -30,6 +30,8 @@
 #include "render_pipeline/rpcore/native/gpu_command.h"
 #include "render_pipeline/rpcore/native/gpu_command_list.h"
 
+#include <algorithm>
+
 namespace rpcore {
 
 GPUCommandQueue::GPUCommandQueue(RenderPipeline& pipeline): RPObject("GPUCommandQueue"), pipeline_(pipeline)
@@ -50,9 +52,27 @@ size_t GPUCommandQueue::get_num_queued_commands() const
 
 void GPUCommandQueue::process_queue()
 {
+    const size_t num_queued = command_list_->get_num_commands();
+
+    // skip uploading the buffer if there is nothing to process
+    if (num_queued == 0)
+    {
+        pta_num_commands_[0] = 0;
+        return;
+    }
+
+    // adapt the budget to drain a backlog (ex, loading many lights) faster
+    size_t budget = commands_per_frame_;
+    if (num_queued > budget)
+    {
+        budget = (std::min)(
+            (std::max)(budget, (num_queued + backlog_drain_frames_ - 1) / backlog_drain_frames_),
+            static_cast<size_t>(max_commands_per_frame_));
+    }
+
     PTA_uchar pointer = data_texture_->get_texture()->modify_ram_image();
-    size_t num_commands_exec = command_list_->write_commands_to(pointer, commands_per_frame_);
-    pta_num_commands_[0] = num_commands_exec;
+    size_t num_commands_exec = command_list_->write_commands_to(pointer, budget);
+    pta_num_commands_[0] = static_cast<int>(num_commands_exec);
 }
 
 void GPUCommandQueue::reload_shaders()
@@ -83,7 +103,7 @@ void GPUCommandQueue::register_defines()
 
 void GPUCommandQueue::create_data_storage()
 {
-    int command_buffer_size = commands_per_frame_ * 32;
+    int command_buffer_size = max_commands_per_frame_ * 32;
     debug(std::string("Allocating command buffer of size ") + std::to_string(command_buffer_size));
     data_texture_ = Image::create_buffer("CommandQueue", command_buffer_size, "R32");
 }
@@ -52,7 +52,12 @@ public:
 
     int get_num_processed_commands() const;
 
-    /** Processes the n first commands of the queue. */
+    /**
+     * Processes the n first commands of the queue.
+     *
+     * Usually, n is the commands per frame. If more commands are queued, n grows
+     * to drain the backlog within a few frames, up to the maximum commands per frame.
+     */
     void process_queue();
 
     /** Reloads the command shader. */
@@ -76,6 +81,8 @@ private:
 
     RenderPipeline& pipeline_;
     int commands_per_frame_ = 1024;
+    int max_commands_per_frame_ = 4096;
+    int backlog_drain_frames_ = 4;
     std::unique_ptr<GPUCommandList> command_list_;
     PTA_int pta_num_commands_;
     std::unique_ptr<RenderTarget> command_target_;
@@ -45,6 +45,7 @@
 #include "render_pipeline/rpcore/pluginbase/manager.hpp"
 #include "render_pipeline/rpcore/pluginbase/day_manager.hpp"
 #include "render_pipeline/rpcore/pluginbase/base_plugin.hpp"
+#include "render_pipeline/rpcore/native/internal_light_manager.h"
 
 #include <rpplugins/scattering/include/scattering_plugin.hpp>
 #include <rpplugins/pssm/include/pssm_plugin.hpp>
@@ -338,13 +339,16 @@ AsyncTask::DoneStatus Debugger::update_stats(rppanda::FunctionalTask* task)
     const auto& light_mgr = pipeline->get_light_mgr();
 
     debug_lines_[1]->set_text(fmt::format(
-        "{:4d} states |  {:4d} transforms |  {:4d} cmds |  {:4d} lights |  {:4d} shadow |  {:5.1f}% atlas usage",
+        "{:4d} states |  {:4d} transforms ({:4d} trimmed, {:4.2f} ms) |  {:4d} cmds |  {:4d} lights |  {:4d} shadow ({:3d} skipped) |  {:5.1f}% atlas usage",
 
         RenderState::get_num_states(),
         TransformState::get_num_states(),
+        pipeline->get_state_cache_stats().num_states_before - pipeline->get_state_cache_stats().num_states_after,
+        pipeline->get_state_cache_stats().duration_ms,
         light_mgr->get_cmd_queue()->get_num_processed_commands(),
         light_mgr->get_num_lights(),
         light_mgr->get_num_shadow_sources(),
+        light_mgr->get_internal_mgr()->get_shadow_update_stats().num_skipped,
         light_mgr->get_shadow_atlas_coverage()));
 
     const auto& tex_memory_count = buffer_viewer_->get_stage_information();
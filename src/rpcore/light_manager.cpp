@@ -141,9 +141,17 @@ void LightManager::initshadow_manager()
 {
     shadow_manager_ = std::make_unique<ShadowManager>();
     shadow_manager_->set_max_updates(pipeline_.get_setting<size_t>("shadows.max_updates"));
+    shadow_manager_->set_max_update_tiles(pipeline_.get_setting<size_t>("shadows.max_update_tiles", 0));
     shadow_manager_->set_scene(Globals::base->get_render());
     shadow_manager_->set_tag_state_manager(pipeline_.get_tag_mgr());
     shadow_manager_->set_atlas_size(pipeline_.get_setting<size_t>("shadows.atlas_size"));
+
+    const auto& atlas_allocator = pipeline_.get_setting<std::string>("shadows.atlas_allocator", std::string("tile_scan"));
+    if (atlas_allocator == "quadtree")
+        shadow_manager_->set_atlas_allocation_strategy(ShadowAtlas::AS_quadtree);
+    else if (atlas_allocator != "tile_scan")
+        error("Unknown shadow atlas allocator: " + atlas_allocator);
+
     internal_mgr_->set_shadow_manager(shadow_manager_.get());
 }
 
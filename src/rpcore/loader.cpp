@@ -23,19 +23,24 @@
 #include "render_pipeline/rpcore/loader.hpp"
 
 #include <chrono>
+#include <cstring>
 
-#include <pnmImage.h>
-#include <virtualFileMountRamdisk.h>
+#include <texturePool.h>
+#include <virtualFileSystem.h>
+#include <config_putil.h>
 
 #include <boost/algorithm/string/join.hpp>
 
 #include <fmt/ostream.h>
 
 #include "render_pipeline/rpcore/globals.hpp"
+#include "render_pipeline/rpcore/mount_manager.hpp"
 #include "render_pipeline/rppanda/showbase/showbase.hpp"
 #include "render_pipeline/rppanda/showbase/loader.hpp"
 #include "render_pipeline/rppanda/stdpy/file.hpp"
 
+#include "render_pipeline/rplibs/hash.hpp"
+
 namespace rpcore {
 
 /**
@@ -86,11 +91,19 @@ private:
 
 int TimedLoadingOperation::WARNING_COUNT = 0;
 
+// ************************************************************************************************
+
+constexpr const char* RPLoader::sliced_texture_cache_dir_;
+
 // ************************************************************************************************
 Texture* RPLoader::load_texture(const Filename& filename)
 {
     TimedLoadingOperation tlo(filename);
 
+    // without ShowBase, like in the tools and the benchmarks
+    if (!Globals::base)
+        return TexturePool::load_texture(filename);
+
     return Globals::base->get_loader()->load_texture(filename);
 }
 
@@ -105,6 +118,9 @@ Texture* RPLoader::load_3d_texture(const Filename& filename)
 {
     TimedLoadingOperation tlo(filename);
 
+    if (!Globals::base)
+        return TexturePool::load_3d_texture(filename);
+
     return Globals::base->get_loader()->load_3d_texture(filename);
 }
 
@@ -154,38 +170,93 @@ Texture* RPLoader::load_sliced_3d_texture(const Filename& filename, int tile_siz
 {
     TimedLoadingOperation tlo(filename);
 
-    double epoch_time = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::system_clock::now().time_since_epoch()).count();
-    const std::string tempfile_name = std::string("/$$slice_loader_temp-") + std::to_string(epoch_time) + "/";
+    VirtualFileSystem* vfs = VirtualFileSystem::get_global_ptr();
+
+    Filename source_path(filename);
+    vfs->resolve_filename(source_path, get_model_path());
+
+    std::string source_data;
+    if (!vfs->read_file(source_path, source_data, true))
+    {
+        RPObject::global_error("RPLoader", fmt::format("Could not read sliced texture {}", filename.to_os_specific()));
+        return nullptr;
+    }
+
+    // The de-sliced texture is stored as txo, so the next run does not decode the image
+    rplibs::FNV1aHash hash;
+    hash.update(source_data.data(), source_data.size());
+    hash.update(static_cast<uint64_t>(tile_size_x));
+    hash.update(static_cast<uint64_t>(tile_size_y));
+    hash.update(static_cast<uint64_t>(num_tiles));
+    const Filename cache_path = fmt::format("{}/{}-{:016x}.txo", sliced_texture_cache_dir_,
+        filename.get_basename_wo_extension(), hash.get_digest());
+
+    // On the ramdisk, the txo is not written and only the texture pool is used.
+    const bool use_disk_cache = MountManager::is_write_path_persistent();
+    if (TexturePool::has_texture(cache_path) || (use_disk_cache && vfs->exists(cache_path)))
+    {
+        Texture* cached_tex = RPLoader::load_texture(cache_path);
+        if (cached_tex && cached_tex->get_texture_type() == Texture::TT_3d_texture)
+            return cached_tex;
+    }
 
     // Load sliced image from disk
-    PT(Texture) tex_handle = RPLoader::load_texture(filename);
-    PNMImage source;
-    tex_handle->store(source);
-    int width = source.get_x_size();
+    PT(Texture) source = RPLoader::load_texture(filename);
+    if (!source)
+        return nullptr;
+
+    const int width = source->get_x_size();
+    const int height = source->get_y_size();
+    const int num_cols = width / tile_size_x;
+    if (num_cols < 1 || (num_tiles + num_cols - 1) / num_cols * tile_size_y > height)
+    {
+        RPObject::global_error("RPLoader", fmt::format("Sliced texture {} ({} x {}) is too small for {} tiles of {} x {}",
+            filename.to_os_specific(), width, height, num_tiles, tile_size_x, tile_size_y));
+        return nullptr;
+    }
+
+    CPTA_uchar source_image = source->get_uncompressed_ram_image();
+    if (source_image.is_null())
+    {
+        RPObject::global_error("RPLoader", fmt::format("Could not get the image of sliced texture {}", filename.to_os_specific()));
+        return nullptr;
+    }
 
-    // Find slice properties
-    int num_cols = width / tile_size_x;
-    PNMImage temp_img(tile_size_x, tile_size_y, source.get_num_channels(), source.get_maxval());
+    PT(Texture) texture = new Texture(filename.get_basename());
+    texture->setup_3d_texture(tile_size_x, tile_size_y, num_tiles, source->get_component_type(), source->get_format());
 
-    // Construct a ramdisk to write the files to
-    VirtualFileSystem* vfs = VirtualFileSystem::get_global_ptr();
-    PT(VirtualFileMountRamdisk) ramdisk = new VirtualFileMountRamdisk;
-    vfs->mount(ramdisk, Filename(tempfile_name), 0);
+    // Copy the rows of each slice directly. The rows of a ram image are
+    // stored from the bottom, so the first row of a slice is its last row in the image.
+    const size_t pixel_size = source->get_num_components() * source->get_component_width();
+    const size_t row_size = tile_size_x * pixel_size;
+    const size_t page_size = row_size * tile_size_y;
+    PTA_uchar dest_image = PTA_uchar::empty_array(page_size * num_tiles);
+    for (int z_slice = 0; z_slice < num_tiles; ++z_slice)
+    {
+        const int slice_x = (z_slice % num_cols) * tile_size_x;
+        const int slice_y = (z_slice / num_cols) * tile_size_y;
+        const int first_row = height - slice_y - tile_size_y;
+        for (int row = 0; row < tile_size_y; ++row)
+        {
+            std::memcpy(dest_image.p() + page_size * z_slice + row_size * row,
+                source_image.p() + ((first_row + row) * static_cast<size_t>(width) + slice_x) * pixel_size,
+                row_size);
+        }
+    }
+    texture->set_ram_image(dest_image);
 
-    // Extract all slices and write them to the virtual disk
-    for (int z_slice=0; z_slice < num_tiles; ++z_slice)
+    if (use_disk_cache)
     {
-        int slice_x = (z_slice % num_cols) * tile_size_x;
-        int slice_y = (z_slice / num_cols) * tile_size_y;
-        temp_img.copy_sub_image(source, 0, 0, slice_x, slice_y, tile_size_x, tile_size_y);
-        temp_img.write(Filename(tempfile_name + std::to_string(z_slice) + ".png"));
+        vfs->make_directory_full(sliced_texture_cache_dir_);
+        if (!texture->write(cache_path))
+            RPObject::global_warn("RPLoader", fmt::format("Could not write the cache of sliced texture to {}", cache_path.to_os_specific()));
     }
 
-    // Load the de-sliced texture from the ramdisk
-    Texture* texture_handle = RPLoader::load_3d_texture(Filename(tempfile_name + "/#.png"));
-    vfs->unmount(ramdisk);
+    // The pool keeps the texture alive as the other loaders do.
+    texture->set_fullpath(cache_path);
+    TexturePool::add_texture(texture);
 
-    return texture_handle;
+    return texture;
 }
 
 }
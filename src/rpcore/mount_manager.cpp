@@ -26,6 +26,8 @@
 #include <filename.h>
 #include <virtualFileMountRamdisk.h>
 #include <virtualFileMountSystem.h>
+#include <virtualFileSimple.h>
+#include <virtualFileSystem.h>
 #include <config_putil.h>
 
 #include <boost/filesystem.hpp>
@@ -267,6 +269,15 @@ const Filename& MountManager::get_write_path() const
     return impl_->write_path_;
 }
 
+bool MountManager::is_write_path_persistent()
+{
+    PT(VirtualFile) file = VirtualFileSystem::get_global_ptr()->get_file("/$$rptemp", true);
+    if (!file || !file->is_directory() || !file->is_of_type(VirtualFileSimple::get_class_type()))
+        return false;
+
+    return DCAST(VirtualFileSimple, file)->get_mount()->is_of_type(VirtualFileMountSystem::get_class_type());
+}
+
 const Filename& MountManager::get_base_path() const
 {
     return impl_->base_path_;
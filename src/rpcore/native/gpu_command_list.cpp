@@ -26,6 +26,9 @@
 
 #include "render_pipeline/rpcore/native/gpu_command_list.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace rpcore {
 
 /**
@@ -34,16 +37,48 @@ namespace rpcore {
  *   in the list.
  */
 GPUCommandList::GPUCommandList() {
+    _capacity = 1024;
+    _data.resize(_capacity * GPU_COMMAND_ENTRIES);
+    _head = 0;
+    _num_commands = 0;
+    _num_written = 0;
+    _num_coalesced = 0;
 }
 
 /**
  * @brief Pushes a GPUCommand to the command list.
  * @details This adds a new GPUCommand to the list of commands to be processed.
  *
+ *   If the command is a CMD_store_light, and a CMD_store_light for the same
+ *   slot is still waiting to get processed, the waiting command gets the data
+ *   of the new command instead, because the GPU would overwrite it anyways.
+ *   A CMD_remove_light for the slot ends this, so the order of store and
+ *   remove commands is kept.
+ *
  * @param cmd The command to add
  */
 void GPUCommandList::add_command(const GPUCommand& cmd) {
-    _commands.push(cmd);
+    const GPUCommand::CommandType command_type = cmd.get_command_type();
+
+    if (command_type == GPUCommand::CMD_store_light) {
+        const int slot = cmd.get_int(1);
+        auto iter = _queued_light_stores.find(slot);
+        if (iter != _queued_light_stores.end() && iter->second >= _num_written) {
+            std::copy_n(cmd.get_data(), GPU_COMMAND_ENTRIES, get_command_data(iter->second));
+            ++_num_coalesced;
+            return;
+        }
+        _queued_light_stores[slot] = _num_written + _num_commands;
+    } else if (command_type == GPUCommand::CMD_remove_light) {
+        _queued_light_stores.erase(cmd.get_int(1));
+    }
+
+    if (_num_commands == _capacity) {
+        grow_storage();
+    }
+
+    ++_num_commands;
+    std::copy_n(cmd.get_data(), GPU_COMMAND_ENTRIES, get_command_data(_num_written + _num_commands - 1));
 }
 
 /**
@@ -53,16 +88,26 @@ void GPUCommandList::add_command(const GPUCommand& cmd) {
  * @return Amount of commands
  */
 size_t GPUCommandList::get_num_commands() {
-    return _commands.size();
+    return _num_commands;
+}
+
+/**
+ * @brief Returns the number of coalesced commands.
+ * @details This returns the total amount of CMD_store_light commands, which
+ *   were merged into a waiting command instead of getting queued.
+ * @return Amount of coalesced commands
+ */
+size_t GPUCommandList::get_num_coalesced_commands() const {
+    return _num_coalesced;
 }
 
 /**
  * @brief Writes the first n-commands to a destination.
  * @details This takes the first #limit commands, and writes them to the
- *   destination using GPUCommand::write_to. See GPUCommand::write_to for
- *   further information about #dest. The limit controls after how much
- *   commands the processing will be stopped. All commands which got processed
- *   will get removed from the list.
+ *   destination. The layout is the same as when using GPUCommand::write_to
+ *   for each command. See GPUCommand::write_to for further information about
+ *   #dest. The limit controls after how much commands the processing will be
+ *   stopped. All commands which got processed will get removed from the list.
  *
  * @param dest Destination to write to, see GPUCommand::write_to
  * @param limit Maximum amount of commands to process
@@ -70,16 +115,63 @@ size_t GPUCommandList::get_num_commands() {
  * @return Amount of commands processed, between 0 and #limit.
  */
 size_t GPUCommandList::write_commands_to(const PTA_uchar &dest, size_t limit) {
-    size_t num_commands_written = 0;
+    const size_t num_commands_written = (std::min)(limit, _num_commands);
+    if (num_commands_written == 0)
+        return 0;
+
+    const size_t command_size = GPU_COMMAND_ENTRIES * sizeof(float);
+
+    // Copy the commands until the end of the ring buffer, and then the
+    // remaining commands from the begin.
+    const size_t num_first = (std::min)(num_commands_written, _capacity - _head);
+    memcpy(dest.p(), &_data[_head * GPU_COMMAND_ENTRIES], num_first * command_size);
+    if (num_first < num_commands_written) {
+        memcpy(dest.p() + num_first * command_size, _data.data(), (num_commands_written - num_first) * command_size);
+    }
+
+    _head = (_head + num_commands_written) % _capacity;
+    _num_commands -= num_commands_written;
+    _num_written += num_commands_written;
 
-    while (num_commands_written < limit && !_commands.empty()) {
-        // Write the first command to the stream, and delete it afterwards
-        _commands.front().write_to(dest, num_commands_written);
-        _commands.pop();
-        num_commands_written ++;
+    if (_num_commands == 0) {
+        _head = 0;
+        _queued_light_stores.clear();
     }
 
     return num_commands_written;
 }
 
+/**
+ * @brief Internal method to get the data of a queued command.
+ * @details This returns a pointer to the data of the command with the given
+ *   sequence number. The sequence number has to be in the range of the
+ *   currently stored commands.
+ *
+ * @param sequence Sequence number of the command
+ * @return Pointer to the GPU_COMMAND_ENTRIES floats of the command
+ */
+float* GPUCommandList::get_command_data(size_t sequence) {
+    const size_t index = (_head + (sequence - _num_written)) % _capacity;
+    return &_data[index * GPU_COMMAND_ENTRIES];
+}
+
+/**
+ * @brief Internal method to grow the ring buffer.
+ * @details This doubles the capacity of the ring buffer, and moves the stored
+ *   commands to the begin of the new buffer.
+ */
+void GPUCommandList::grow_storage() {
+    const size_t new_capacity = _capacity * 2;
+    std::vector<float> new_data(new_capacity * GPU_COMMAND_ENTRIES);
+
+    const size_t num_first = (std::min)(_num_commands, _capacity - _head);
+    std::copy_n(&_data[_head * GPU_COMMAND_ENTRIES], num_first * GPU_COMMAND_ENTRIES, new_data.begin());
+    std::copy_n(_data.begin(), (_num_commands - num_first) * GPU_COMMAND_ENTRIES,
+        new_data.begin() + num_first * GPU_COMMAND_ENTRIES);
+
+    _data.swap(new_data);
+    _capacity = new_capacity;
+    _head = 0;
+}
+
 }
@@ -30,6 +30,10 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 
+#include <algorithm>
+
+#include "render_pipeline/rplibs/thread_pool.hpp"
+
 NotifyCategoryDef(iesdataset, "")
 
 namespace rpcore {
@@ -104,9 +108,83 @@ float IESDataset::get_candela_value_from_index(size_t vertical_angle_idx, size_t
  * @return Candela value between 0 .. 1
  */
 float IESDataset::get_candela_value(float vertical_angle, float horizontal_angle) const {
+    return sample(find_vertical_sample(vertical_angle), find_horizontal_sample(horizontal_angle));
+}
+
+/**
+ * @brief Fetches a vertical candela value
+ * @details Fetches a vertical candela value, using a given horizontal position.
+ *   This does an 1D interpolation in the candela values array.
+ *
+ * @param horizontal_angle_idx The index of the horizontal angle in the horizontal
+ *   angle array.
+ * @param vertical_angle The vertical angle. Interpolation will be done if the
+ *   vertical angle is not in the vertical angles array.
+ *
+ * @return Candela value between 0 .. 1
+ */
+float IESDataset::get_vertical_candela_value(size_t horizontal_angle_idx, float vertical_angle) const {
+    nassertr(horizontal_angle_idx >= 0 && horizontal_angle_idx < _horizontal_angles.size(), 0.0);
+    return sample_vertical(horizontal_angle_idx, find_vertical_sample(vertical_angle));
+}
+
+/**
+ * @brief Finds the enclosing vertical angles
+ * @details This finds the lowest vertical angle which is greater than the
+ *   given angle with a binary search, and computes the interpolation factor
+ *   from the previous angle.
+ *
+ * @param vertical_angle The vertical angle
+ * @return Sample with index 0 if the angle is out of the range
+ */
+IESDataset::AngleSample IESDataset::find_vertical_sample(float vertical_angle) const {
+    AngleSample result = { 0, 0.0f };
+
+    // Lower and upper bound
+    if (vertical_angle < 0.0 || vertical_angle > _vertical_angles[_vertical_angles.size() - 1]) {
+        return result;
+    }
+
+    // Find lowest enclosing angle
+    const float* begin = _vertical_angles.p();
+    const float* end = begin + _vertical_angles.size();
+    const float* found = std::upper_bound(begin + 1, end, vertical_angle);
+    if (found == end) {
+        return result;
+    }
+
+    // Interpolate lineary
+    float curr_angle = *found;
+    float prev_angle = *(found - 1);
+    result.index = found - begin;
+    result.lerp = (vertical_angle - prev_angle) / (curr_angle - prev_angle);
+
+    // Should never occur, but to be safe:
+    if (result.lerp < 0.0 || result.lerp > 1.0) {
+        iesdataset_cat.error() << "ERROR: Invalid vertical lerp: " << result.lerp
+                               << ", requested angle was " << vertical_angle
+                               << ", prev = " << prev_angle << ", cur = " << curr_angle
+                               << std::endl;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Finds the enclosing horizontal angles
+ * @details This wraps the angle to the range of the horizontal angles and finds
+ *   the lowest horizontal angle which is greater or equal to it with a binary
+ *   search. For datasets without horizontal angles, this returns index 0.
+ *
+ * @param horizontal_angle The horizontal angle
+ * @return Sample with index 0 if the angle is out of the range
+ */
+IESDataset::AngleSample IESDataset::find_horizontal_sample(float horizontal_angle) const {
+    AngleSample result = { 0, 0.0f };
+
     // Special case for datasets without horizontal angles
     if (_horizontal_angles.size() == 1) {
-        return get_vertical_candela_value(0, vertical_angle);
+        return result;
     }
 
     float max_angle = _horizontal_angles[_horizontal_angles.size() - 1];
@@ -119,83 +197,72 @@ float IESDataset::get_candela_value(float vertical_angle, float horizontal_angle
         horizontal_angle = 2.0 * max_angle - horizontal_angle;
     }
 
-    // Simlar to the vertical step, we now try interpolating a horizontal angle,
-    // but we need to evaluate the vertical value for each row instead of fetching
-    // the value directly
-    for (size_t horizontal_index = 1; horizontal_index < _horizontal_angles.size(); ++horizontal_index) {
-        float curr_angle = _horizontal_angles[horizontal_index];
-
-        if (curr_angle >= horizontal_angle) {
-            // Get previous angle data
-            float prev_angle = _horizontal_angles[horizontal_index - 1];
-            float prev_value = get_vertical_candela_value(horizontal_index - 1, vertical_angle);
-            float curr_value = get_vertical_candela_value(horizontal_index, vertical_angle);
-
-            // Interpolate lineary
-            float lerp = (horizontal_angle - prev_angle) / (curr_angle - prev_angle);
-
-            // Should never occur, but to be safe:
-            if (lerp < 0.0 || lerp > 1.0) {
-                iesdataset_cat.error() << "Invalid horizontal lerp: " << lerp
-                                       << ", requested angle was " << horizontal_angle
-                                       << ", prev = " << prev_angle << ", cur = " << curr_angle
-                                       << std::endl;
-            }
+    const float* begin = _horizontal_angles.p();
+    const float* end = begin + _horizontal_angles.size();
+    const float* found = std::lower_bound(begin + 1, end, horizontal_angle);
+    if (found == end) {
+        return result;
+    }
 
-            return curr_value * lerp + prev_value * (1-lerp);
-        }
+    // Interpolate lineary
+    float curr_angle = *found;
+    float prev_angle = *(found - 1);
+    result.index = found - begin;
+    result.lerp = (horizontal_angle - prev_angle) / (curr_angle - prev_angle);
+
+    // Should never occur, but to be safe:
+    if (result.lerp < 0.0 || result.lerp > 1.0) {
+        iesdataset_cat.error() << "Invalid horizontal lerp: " << result.lerp
+                               << ", requested angle was " << horizontal_angle
+                               << ", prev = " << prev_angle << ", cur = " << curr_angle
+                               << std::endl;
     }
 
-    return 0.0;
+    return result;
 }
 
 /**
- * @brief Fetches a vertical candela value
- * @details Fetches a vertical candela value, using a given horizontal position.
- *   This does an 1D interpolation in the candela values array.
+ * @brief Interpolates the candela values of a horizontal angle
  *
- * @param horizontal_angle_idx The index of the horizontal angle in the horizontal
- *   angle array.
- * @param vertical_angle The vertical angle. Interpolation will be done if the
- *   vertical angle is not in the vertical angles array.
+ * @param horizontal_angle_idx Index of the horizontal angle
+ * @param vertical Sample of the vertical angle
  *
  * @return Candela value between 0 .. 1
  */
-float IESDataset::get_vertical_candela_value(size_t horizontal_angle_idx, float vertical_angle) const {
-    nassertr(horizontal_angle_idx >= 0 && horizontal_angle_idx < _horizontal_angles.size(), 0.0);
-
-    // Lower bound
-    if (vertical_angle < 0.0) return 0.0;
+float IESDataset::sample_vertical(size_t horizontal_angle_idx, const AngleSample& vertical) const {
+    if (vertical.index == 0) {
+        return 0.0;
+    }
 
-    // Upper bound
-    if (vertical_angle > _vertical_angles[_vertical_angles.size() - 1] ) return 0.0;
+    const float* values = _candela_values.p() + horizontal_angle_idx * _vertical_angles.size();
+    float prev_value = values[vertical.index - 1];
+    float curr_value = values[vertical.index];
+    return curr_value * vertical.lerp + prev_value * (1-vertical.lerp);
+}
 
-    // Find lowest enclosing angle
-    for (size_t vertical_index = 1; vertical_index < _vertical_angles.size(); ++vertical_index) {
-        float curr_angle = _vertical_angles[vertical_index];
-
-        // Found value
-        if (curr_angle > vertical_angle) {
-            // Get previous angle data
-            float prev_angle = _vertical_angles[vertical_index - 1];
-            float prev_value = get_candela_value_from_index(vertical_index - 1, horizontal_angle_idx);
-            float curr_value = get_candela_value_from_index(vertical_index, horizontal_angle_idx);
-
-            // Interpolate lineary
-            float lerp = (vertical_angle - prev_angle) / (curr_angle - prev_angle);
-
-            // Should never occur, but to be safe:
-            if (lerp < 0.0 || lerp > 1.0) {
-                iesdataset_cat.error() << "ERROR: Invalid vertical lerp: " << lerp
-                                       << ", requested angle was " << vertical_angle
-                                       << ", prev = " << prev_angle << ", cur = " << curr_angle
-                                       << std::endl;
-            }
+/**
+ * @brief Interpolates the candela values of both angles
+ *
+ * @param vertical Sample of the vertical angle
+ * @param horizontal Sample of the horizontal angle
+ *
+ * @return Candela value between 0 .. 1
+ */
+float IESDataset::sample(const AngleSample& vertical, const AngleSample& horizontal) const {
+    // Special case for datasets without horizontal angles
+    if (_horizontal_angles.size() == 1) {
+        return sample_vertical(0, vertical);
+    }
 
-            return curr_value * lerp + prev_value * (1-lerp);
-        }
+    if (horizontal.index == 0) {
+        return 0.0;
     }
-    return 0.0;
+
+    // Simlar to the vertical step, we now interpolate a horizontal angle,
+    // but we need to evaluate the vertical value for each row
+    float prev_value = sample_vertical(horizontal.index - 1, vertical);
+    float curr_value = sample_vertical(horizontal.index, vertical);
+    return curr_value * horizontal.lerp + prev_value * (1-horizontal.lerp);
 }
 
 /**
@@ -209,25 +276,47 @@ float IESDataset::get_vertical_candela_value(size_t horizontal_angle_idx, float
  *   2D Texture Array.
  */
 void IESDataset::generate_dataset_texture_into(Texture* dest_tex, size_t z) const {
-    size_t resolution_vertical = dest_tex->get_y_size();
-    size_t resolution_horizontal = dest_tex->get_x_size();
-
     // Candla values are stored flippped - vertical angles in the x - Axis
     // and horizontal angles in the y - Axis
-    PNMImage dest = PNMImage(resolution_vertical, resolution_horizontal, 1, 65535);
+    PNMImage dest = PNMImage(dest_tex->get_y_size(), dest_tex->get_x_size(), 1, 65535);
+    generate_dataset_image(dest);
+    dest_tex->load(dest, z, 0);
+}
 
+/**
+ * @brief Generates the IES LUT into an image
+ * @details This generates the LUT like generate_dataset_texture_into, but
+ *   the vertical angles are in the x-axis of the image, and the horizontal
+ *   angles are in the y-axis. The enclosing angles of each column and row
+ *   are found once, and the rows are generated in parallel.
+ *
+ * @param dest Grayscale image to write the LUT into
+ */
+void IESDataset::generate_dataset_image(PNMImage& dest) const {
+    size_t resolution_vertical = dest.get_x_size();
+    size_t resolution_horizontal = dest.get_y_size();
+
+    std::vector<AngleSample> vertical_samples(resolution_vertical);
     for (size_t vert = 0; vert < resolution_vertical; ++vert) {
-        for (size_t horiz = 0; horiz < resolution_horizontal; ++horiz) {
-            double vert_angle = static_cast<double>(vert) / static_cast<double>(resolution_vertical-1);
-            vert_angle = std::cos(vert_angle * M_PI) * 90.0 + 90.0;
-            double horiz_angle = static_cast<double>(horiz) / static_cast<double>(resolution_horizontal-1) * 360.0;
-            float candela = get_candela_value(static_cast<float>(vert_angle), static_cast<float>(horiz_angle));
-            dest.set_xel(vert, horiz, candela);
-        }
+        double vert_angle = static_cast<double>(vert) / static_cast<double>(resolution_vertical-1);
+        vert_angle = std::cos(vert_angle * M_PI) * 90.0 + 90.0;
+        vertical_samples[vert] = find_vertical_sample(static_cast<float>(vert_angle));
     }
 
+    std::vector<AngleSample> horizontal_samples(resolution_horizontal);
+    for (size_t horiz = 0; horiz < resolution_horizontal; ++horiz) {
+        double horiz_angle = static_cast<double>(horiz) / static_cast<double>(resolution_horizontal-1) * 360.0;
+        horizontal_samples[horiz] = find_horizontal_sample(static_cast<float>(horiz_angle));
+    }
 
-    dest_tex->load(dest, z, 0);
+    // Each row is written by one thread only.
+    rplibs::ThreadPool::get_global_pool().parallel_for(resolution_horizontal, 16, [&](size_t begin, size_t end) {
+        for (size_t horiz = begin; horiz < end; ++horiz) {
+            for (size_t vert = 0; vert < resolution_vertical; ++vert) {
+                dest.set_xel(vert, horiz, sample(vertical_samples[vert], horizontal_samples[horiz]));
+            }
+        }
+    });
 }
 
 }
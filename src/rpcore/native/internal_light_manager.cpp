@@ -44,6 +44,7 @@ InternalLightManager::InternalLightManager() {
     _shadow_update_distance = 100.0f;
     _cmd_list = nullptr;
     _shadow_manager = nullptr;
+    _frame_index = 0;
 }
 
 /**
@@ -336,22 +337,49 @@ bool InternalLightManager::compare_shadow_sources(const ShadowSource* a, const S
         return b->has_region();
     }
 
-    // Compare sources based on their distance to the camera
+    // Compare sources based on their distance to the camera. The size of the
+    // sources is taken into account by InternalLightManager::compute_shadow_score.
     PN_stdfloat dist_a = (_camera_pos - a->get_bounds().get_center()).length_squared();
-    PN_stdfloat dist_b = (_camera_pos - a->get_bounds().get_center()).length_squared();
-
-    // XXX: Should also compare based on source size, so that huge sources recieve
-    // more updates
+    PN_stdfloat dist_b = (_camera_pos - b->get_bounds().get_center()).length_squared();
 
     return dist_b > dist_a;
 }
 
+/**
+ * @brief Computes the update priority of a shadow source
+ * @details This scores a shadow source for the update scheduling. The score
+ *   grows with the approximated screen coverage of the source bounds and with
+ *   the frames since the last update, and is divided by the cost of the source
+ *   in atlas tiles. Because the age grows every frame, every dirty source
+ *   eventually gets updated.
+ *
+ * @param source The source to score
+ * @param cost Amount of atlas tiles the source takes
+ *
+ * @return Score, greater is more important
+ */
+PN_stdfloat InternalLightManager::compute_shadow_score(const ShadowSource* source, size_t cost) const
+{
+    const BoundingSphere& bounds = source->get_bounds();
+    const PN_stdfloat radius = bounds.get_radius();
+    const PN_stdfloat dist_sq = (std::max)((_camera_pos - bounds.get_center()).length_squared(), PN_stdfloat(1e-4));
+
+    // Approximation of the covered view, which is 1 when the camera is inside
+    const PN_stdfloat coverage = (std::min)(radius * radius / dist_sq, PN_stdfloat(1));
+
+    const size_t age = _frame_index - source->get_last_update_frame();
+
+    // Keep a small minimum coverage, so that the age still counts for far sources
+    return (coverage + PN_stdfloat(0.001)) * PN_stdfloat(1 + age) / PN_stdfloat((std::max)(cost, size_t(1)));
+}
+
 /**
  * @brief Internal method to update all shadow sources
  * @details This updates all shadow sources which are marked dirty. It will sort
- *   the list of all dirty shadow sources by their resolution, take the first
- *   n entries, and update them. The amount of sources processed depends on the
- *   max_updates of the ShadowManager.
+ *   the list of all dirty shadow sources by their score (see
+ *   InternalLightManager::compute_shadow_score), and update as many as fit into
+ *   the update slots and the tile budget of the ShadowManager. The result is
+ *   stored in the ShadowUpdateStats.
  */
 void InternalLightManager::update_shadow_sources() {
     // Find all dirty shadow sources and make a list of them
@@ -378,31 +406,69 @@ void InternalLightManager::update_shadow_sources() {
         }
     }
 
-    // Sort the sources based on their importance, so that sources with a bigger
-    // priority come first. This helps to get a better packing on the shadow atlas.
-    // However, we also need to prioritize sources which have no current region,
-    // because no shadows are worse than outdated-shadows.
-    std::sort(sources_to_update.begin(), sources_to_update.end(), [this](const ShadowSource* a, const ShadowSource* b) {
-        return this->compare_shadow_sources(a, b);
-    });
-
     // Get a handle to the atlas, will be frequently used
     ShadowAtlas *atlas = _shadow_manager->get_atlas();
 
-    // Free the regions of all sources which will get updated. We have to take into
-    // account that only a limited amount of sources can get updated per frame.
-    size_t update_slots = (std::min)(sources_to_update.size(),
-                              _shadow_manager->get_num_update_slots_left());
-    for(size_t i = 0; i < update_slots; ++i) {
-        if (sources_to_update[i]->has_region()) {
-           atlas->free_region(sources_to_update[i]->get_region());
+    // Score the sources by their importance and their cost in atlas tiles
+    std::vector<ShadowSourceCandidate> candidates;
+    candidates.reserve(sources_to_update.size());
+    for (ShadowSource* source: sources_to_update) {
+        const size_t tiles = atlas->get_required_tiles(source->get_resolution());
+        const size_t cost = tiles * tiles;
+        candidates.push_back({ source, cost, compute_shadow_score(source, cost) });
+    }
+
+    // Sort the sources based on their score, so that sources with a bigger
+    // priority come first. However, we also need to prioritize sources which
+    // have no current region, because no shadows are worse than outdated-shadows.
+    std::sort(candidates.begin(), candidates.end(), [this](const ShadowSourceCandidate& a, const ShadowSourceCandidate& b) {
+        if (a.source->has_region() != b.source->has_region()) {
+            return b.source->has_region();
+        }
+        if (a.score != b.score) {
+            return a.score > b.score;
+        }
+        return this->compare_shadow_sources(a.source, b.source);
+    });
+
+    // Select the sources greedily until the update slots or the tile budget
+    // of this frame is used up. A source which does not fit is skipped, and
+    // smaller sources after it may still fit. The first source is always
+    // taken, so that sources bigger than the budget still get updated.
+    const size_t update_slots = _shadow_manager->get_num_update_slots_left();
+    size_t update_tiles_left = _shadow_manager->get_num_update_tiles_left();
+
+    _shadow_update_stats = ShadowUpdateStats();
+    _shadow_update_stats.num_candidates = candidates.size();
+
+    sources_to_update.clear();
+    for (const auto& candidate: candidates) {
+        if (sources_to_update.size() < update_slots &&
+            (candidate.cost <= update_tiles_left || sources_to_update.empty())) {
+            sources_to_update.push_back(candidate.source);
+            update_tiles_left -= (std::min)(candidate.cost, update_tiles_left);
+            _shadow_update_stats.num_update_tiles += candidate.cost;
+        } else {
+            const size_t age = _frame_index - candidate.source->get_last_update_frame();
+            size_t bucket = 0;
+            while (bucket + 1 < ShadowUpdateStats::NUM_AGE_BUCKETS && (age >> (bucket + 1)) != 0) {
+                ++bucket;
+            }
+            ++_shadow_update_stats.stale_age_histogram[bucket];
+            ++_shadow_update_stats.num_skipped;
         }
     }
+    _shadow_update_stats.num_updated = sources_to_update.size();
 
-    // Find an atlas spot for all regions which are supposed to get an update
-    for (size_t i = 0; i < update_slots; ++i) {
-        ShadowSource *source = sources_to_update[i];
+    // Free the regions of all sources which will get updated.
+    for (ShadowSource* source: sources_to_update) {
+        if (source->has_region()) {
+           atlas->free_region(source->get_region());
+        }
+    }
 
+    // Find an atlas spot for all regions which are supposed to get an update
+    for (ShadowSource* source: sources_to_update) {
         if(!_shadow_manager->add_update(source)) {
             // In case the ShadowManager lied about the number of updates left
             lightmgr_cat.error() << "ShadowManager ensured update slot, but slot is taken!" << std::endl;
@@ -418,6 +484,7 @@ void InternalLightManager::update_shadow_sources() {
 
         // Mark the source as updated
         source->set_needs_update(false);
+        source->set_last_update_frame(_frame_index);
         gpu_update_source(source);
     }
 }
@@ -434,6 +501,8 @@ void InternalLightManager::update() {
     nassertv(_shadow_manager != nullptr); // Not initialized yet!
     nassertv(_cmd_list != nullptr);       // Not initialized yet!
 
+    ++_frame_index;
+
     update_lights();
     update_shadow_sources();
 }
@@ -26,7 +26,8 @@
 
 
 #include "render_pipeline/rpcore/native/shadow_atlas.h"
-#include <string.h>
+
+#include <algorithm>
 
 NotifyCategoryDef(shadowatlas, "");
 
@@ -48,15 +49,22 @@ namespace rpcore {
  *   If you want to disable the use of tiles, set the tile_size to 1, which
  *   will make the shadow atlas use pixels instead of tiles.
  *
+ *   The strategy determines how free regions are searched, see
+ *   ShadowAtlas::AllocationStrategy. The quadtree requires a power-of-two
+ *   amount of tiles, otherwise the tile scan is used.
+ *
  * @param size Atlas-size in pixels
  * @param tile_size tile-size in pixels, or 1 to use no tiles.
+ * @param strategy Strategy to find free regions
  */
-ShadowAtlas::ShadowAtlas(size_t size, size_t tile_size) {
+ShadowAtlas::ShadowAtlas(size_t size, size_t tile_size, AllocationStrategy strategy) {
     nassertv(size > 1 && tile_size >= 1);
     nassertv(tile_size < size && size % tile_size == 0);
+    _strategy = strategy;
     _size = size;
     _tile_size = tile_size;
     _num_used_tiles = 0;
+    _num_wasted_tiles = 0;
     init_tiles();
 }
 
@@ -65,17 +73,30 @@ ShadowAtlas::ShadowAtlas(size_t size, size_t tile_size) {
  * @details This destructs the shadow atlas, freeing all used resources.
  */
 ShadowAtlas::~ShadowAtlas() {
-    delete [] _flags;
 }
 
 /**
  * @brief Internal method to init the storage.
- * @details This method setups the storage used for storing the tile flags.
+ * @details This method setups the storage used for storing the tile flags,
+ *   and the free blocks of the quadtree when it is used.
  */
 void ShadowAtlas::init_tiles() {
     _num_tiles = _size / _tile_size;
-    _flags = new bool[_num_tiles * _num_tiles];
-    memset(_flags, 0x0, sizeof(bool) * _num_tiles * _num_tiles);
+    _words_per_row = (_num_tiles + 63) / 64;
+    _flags.assign(_words_per_row * _num_tiles, 0);
+
+    if (_strategy == AS_quadtree) {
+        if ((_num_tiles & (_num_tiles - 1)) != 0 || _num_tiles > 0xFFFF) {
+            shadowatlas_cat.warning() << "Quadtree allocation requires a power-of-two amount of tiles, "
+                                      << "but the atlas has " << _num_tiles << " tiles. "
+                                      << "Falling back to tile scan." << std::endl;
+            _strategy = AS_tile_scan;
+            return;
+        }
+
+        _free_blocks.resize(get_block_level(1) + 1);
+        _free_blocks[0].insert(make_block_key(0, 0));
+    }
 }
 
 /**
@@ -106,6 +127,148 @@ void ShadowAtlas::reserve_region(size_t x, size_t y, size_t w, size_t h) {
     }
 }
 
+/**
+ * @brief Internal method to release a region in the atlas.
+ * @details This is the counterpart of ShadowAtlas::reserve_region, and marks
+ *   all tiles in the region as free again. The region should be in tile space.
+ *
+ * @param x x- start positition of the region
+ * @param y y- start position of the region
+ * @param w width of the region
+ * @param h height of the region
+ */
+void ShadowAtlas::release_region(size_t x, size_t y, size_t w, size_t h) {
+    nassertv(x >= 0 && y >= 0 && x + w <= _num_tiles && y + h <= _num_tiles);
+
+    _num_used_tiles -= w * h;
+
+    for (size_t cx = 0; cx < w; ++cx) {
+        for (size_t cy = 0; cy < h; ++cy) {
+            // Could do an assert here, that the tile should have been used (=true) before
+            set_tile(cx + x, cy + y, false);
+        }
+    }
+}
+
+/**
+ * @brief Internal method to find a region with the tile scan.
+ * @details This searches the first free region, going column by column from
+ *   the left, and in each column from the bottom to the top. When a region
+ *   is blocked, all origins whose region would contain the blocked row are
+ *   skipped. This returns the same regions as testing every origin.
+ *
+ * @param tile_width Width of the region in tile space
+ * @param tile_height Height of the region in tile space
+ *
+ * @return Region, or -1 when no region is found.
+ */
+LVecBase4i ShadowAtlas::scan_for_region(size_t tile_width, size_t tile_height) {
+    for (size_t x = 0; x <= _num_tiles - tile_width; ++x) {
+        size_t y = 0;
+        while (y <= _num_tiles - tile_height) {
+            const int blocked_row = find_blocked_row(x, y, tile_width, tile_height);
+            if (blocked_row < 0) {
+                // Found free region, now reserve it
+                reserve_region(x, y, tile_width, tile_height);
+                return LVecBase4i(x, y, tile_width, tile_height);
+            }
+            y = static_cast<size_t>(blocked_row) + 1;
+        }
+    }
+    return LVecBase4i(-1);
+}
+
+/**
+ * @brief Internal method to find a region with the quadtree.
+ * @details This takes the smallest free block which can store the region, and
+ *   splits it until it has the block size of the region. The remaining parts
+ *   of the split blocks are stored as free blocks.
+ *
+ * @param tile_width Width of the region in tile space
+ * @param tile_height Height of the region in tile space
+ *
+ * @return Region, or -1 when no region is found.
+ */
+LVecBase4i ShadowAtlas::quadtree_find_region(size_t tile_width, size_t tile_height) {
+    const size_t block_size = get_block_size(tile_width, tile_height);
+    const size_t target_level = get_block_level(block_size);
+
+    // Find the smallest free block which is big enough
+    size_t level = target_level + 1;
+    while (level > 0 && _free_blocks[level - 1].empty())
+        --level;
+    if (level == 0)
+        return LVecBase4i(-1);
+    --level;
+
+    const uint32_t key = *_free_blocks[level].begin();
+    _free_blocks[level].erase(_free_blocks[level].begin());
+    const size_t x = key >> 16;
+    const size_t y = key & 0xFFFF;
+
+    // Split the block until it has the required size, keeping the first child
+    for (size_t size = _num_tiles >> level; level < target_level; ++level) {
+        size >>= 1;
+        _free_blocks[level + 1].insert(make_block_key(x + size, y));
+        _free_blocks[level + 1].insert(make_block_key(x, y + size));
+        _free_blocks[level + 1].insert(make_block_key(x + size, y + size));
+    }
+
+    // The padding of the block is marked as used, too, so the tile flags
+    // always match the quadtree.
+    reserve_region(x, y, block_size, block_size);
+    _num_used_tiles -= block_size * block_size - tile_width * tile_height;
+    _num_wasted_tiles += block_size * block_size - tile_width * tile_height;
+
+    return LVecBase4i(x, y, tile_width, tile_height);
+}
+
+/**
+ * @brief Internal method to free a region of the quadtree.
+ * @details This frees the block of the region, and merges it with its
+ *   siblings as long as all of them are free.
+ *
+ * @param region Region to free
+ */
+void ShadowAtlas::quadtree_free_region(const LVecBase4i& region) {
+    const size_t tile_width = region.get_z();
+    const size_t tile_height = region.get_w();
+    const size_t block_size = get_block_size(tile_width, tile_height);
+    size_t x = region.get_x();
+    size_t y = region.get_y();
+
+    nassertv(x % block_size == 0 && y % block_size == 0);  // Region was not allocated by the quadtree
+
+    _num_used_tiles += block_size * block_size - tile_width * tile_height;
+    _num_wasted_tiles -= block_size * block_size - tile_width * tile_height;
+    release_region(x, y, block_size, block_size);
+
+    size_t level = get_block_level(block_size);
+    for (size_t size = block_size; level > 0; --level, size <<= 1) {
+        const size_t parent_x = x - x % (size * 2);
+        const size_t parent_y = y - y % (size * 2);
+
+        auto& free_blocks = _free_blocks[level];
+        bool siblings_free = true;
+        for (size_t i = 0; siblings_free && i < 4; ++i) {
+            const size_t sibling_x = parent_x + (i % 2) * size;
+            const size_t sibling_y = parent_y + (i / 2) * size;
+            if (sibling_x != x || sibling_y != y)
+                siblings_free = free_blocks.count(make_block_key(sibling_x, sibling_y)) != 0;
+        }
+
+        if (!siblings_free)
+            break;
+
+        for (size_t i = 0; i < 4; ++i)
+            free_blocks.erase(make_block_key(parent_x + (i % 2) * size, parent_y + (i / 2) * size));
+        x = parent_x;
+        y = parent_y;
+    }
+
+    _free_blocks[level].insert(make_block_key(x, y));
+}
+
 /**
  * @brief Finds space for a map of the given size in the atlas.
  * @details This methods searches for a space to store a region of the given
@@ -142,16 +305,11 @@ LVecBase4i ShadowAtlas::find_and_reserve_region(size_t tile_width, size_t tile_h
         return LVecBase4i(-1);
     }
 
-    // Iterate over every possible region and check if its still free
-    for (size_t x = 0; x <= _num_tiles - tile_width; ++x) {
-        for (size_t y = 0; y <= _num_tiles - tile_height; ++y) {
-            if (region_is_free(x, y, tile_width, tile_height)) {
-                // Found free region, now reserve it
-                reserve_region(x, y, tile_width, tile_height);
-                return LVecBase4i(x, y, tile_width, tile_height);
-            }
-        }
-    }
+    const LVecBase4i region = _strategy == AS_quadtree ?
+        quadtree_find_region(tile_width, tile_height) :
+        scan_for_region(tile_width, tile_height);
+    if (region.get_x() >= 0)
+        return region;
 
     // When we reached this part, we couldn't find a free region, so the atlas
     // seems to be full.
@@ -176,14 +334,58 @@ void ShadowAtlas::free_region(const LVecBase4i& region) {
     nassertv(region.get_x() >= 0 && region.get_y() >= 0);
     nassertv(region.get_x() + region.get_z() <= _num_tiles && region.get_y() + region.get_w() <= _num_tiles);
 
-    _num_used_tiles -= region.get_z() * region.get_w();
+    if (_strategy == AS_quadtree)
+        quadtree_free_region(region);
+    else
+        release_region(region.get_x(), region.get_y(), region.get_z(), region.get_w());
+}
 
-    for (size_t x = 0; x < region.get_z(); ++x) {
-        for (size_t y = 0; y < region.get_w(); ++y) {
-            // Could do an assert here, that the tile should have been used (=true) before
-            set_tile(region.get_x() + x, region.get_y() + y, false);
+/**
+ * @brief Returns the size of the largest free square region
+ * @details This returns the size, in tile space, of the largest square region
+ *   which is completely free. This is computed over all tiles, so it should
+ *   only be used for statistics and not per allocation.
+ *
+ * @return Size of the largest free region in tile space
+ */
+int ShadowAtlas::get_largest_free_region() const {
+    // Size of the largest free square ending at each tile of the previous
+    // and the current row.
+    std::vector<int> prev_row(_num_tiles + 1, 0);
+    std::vector<int> curr_row(_num_tiles + 1, 0);
+    int largest = 0;
+    for (size_t y = 0; y < _num_tiles; ++y) {
+        for (size_t x = 0; x < _num_tiles; ++x) {
+            if (get_tile(x, y)) {
+                curr_row[x + 1] = 0;
+            } else {
+                curr_row[x + 1] = 1 + (std::min)({ prev_row[x], prev_row[x + 1], curr_row[x] });
+                largest = (std::max)(largest, curr_row[x + 1]);
+            }
         }
+        std::swap(prev_row, curr_row);
     }
+    return largest;
+}
+
+/**
+ * @brief Returns the fragmentation of the free space
+ * @details This returns in percentage from 0 to 1 how fragmented the free
+ *   space of the atlas is. A value of 0 means the free tiles form a single
+ *   square, whereas a value near 1 means that only small regions can be
+ *   found although many tiles are free.
+ *
+ *   This uses ShadowAtlas::get_largest_free_region, so it is not cheap.
+ *
+ * @return Fragmentation in percentage
+ */
+float ShadowAtlas::get_fragmentation() const {
+    const size_t num_free_tiles = _num_tiles * _num_tiles - _num_used_tiles - _num_wasted_tiles;
+    if (num_free_tiles == 0)
+        return 0.0f;
+
+    const size_t largest = get_largest_free_region();
+    return 1.0f - float(largest * largest) / float(num_free_tiles);
 }
 
 }
@@ -40,7 +40,10 @@ namespace rpcore {
  */
 ShadowManager::ShadowManager() {
     _max_updates = 10;
+    _max_update_tiles = 0;
+    _num_queued_tiles = 0;
     _atlas_size = 4096;
+    _atlas_allocation_strategy = ShadowAtlas::AS_tile_scan;
     _tag_state_mgr = nullptr;
     _atlas_graphics_output = nullptr;
 }
@@ -97,7 +100,7 @@ void ShadowManager::init() {
     }
 
     // Create the atlas
-    _atlas = std::make_unique<ShadowAtlas>(_atlas_size);
+    _atlas = std::make_unique<ShadowAtlas>(_atlas_size, 32, _atlas_allocation_strategy);
 
     // Reserve enough space for the updates
     _queued_updates.reserve(_max_updates);
@@ -151,6 +154,7 @@ void ShadowManager::update() {
 
     // Clear the update list
     _queued_updates.clear();
+    _num_queued_tiles = 0;
     _queued_updates.reserve(_max_updates);
 }
 
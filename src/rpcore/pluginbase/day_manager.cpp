@@ -24,6 +24,7 @@
 
 #include "render_pipeline/rpcore/pluginbase/day_manager.hpp"
 
+#include <limits>
 #include <regex>
 
 #include <fmt/format.h>
@@ -40,15 +41,56 @@ namespace rpcore {
 
 class DayTimeManager::Impl
 {
+public:
+    /** Day setting and the handle of its input. Only one of the handles is valid by the GLSL type. */
+    struct SettingInput
+    {
+        std::shared_ptr<DayBaseType> setting;
+        GroupedInputBlock::Handle<PTA_float> float_handle;
+        GroupedInputBlock::Handle<PTA_LVecBase3f> vec3_handle;
+
+        /** First column of the setting in the baked table. */
+        size_t column;
+
+        /** Version of the setting when the input was updated last. */
+        size_t version;
+    };
+
 public:
     Impl(RenderPipeline& pipeline);
 
+    /** Samples the shader input values of the setting into its columns of the table. */
+    void bake_setting(const SettingInput& input);
+
+    /**
+     * Checks the versions of the settings, and bakes the modified ones again.
+     * Returns true if any setting is modified.
+     */
+    bool check_modified_settings();
+
+    /** Writes the values at the current time to the inputs. */
+    void update_inputs();
+
 public:
     RenderPipeline& pipeline_;
 
     std::shared_ptr<GroupedInputBlock> input_ubo_;
-    std::unordered_map<std::string, std::shared_ptr<DayBaseType>> setting_handles_;
+    std::vector<SettingInput> setting_inputs_;
     float time_ = 0.5f;
+
+    /** Time of the last update of the inputs. */
+    float updated_time_ = std::numeric_limits<float>::quiet_NaN();
+
+    /**
+     * Shader input values of all settings, sampled (lut_size_ + 1) times in a day.
+     * Each row has the values of all settings, so interpolating a row is
+     * a single loop over contiguous floats.
+     * If lut_size_ is 0, the curves are evaluated in each update.
+     */
+    size_t lut_size_ = 0;
+    size_t num_columns_ = 0;
+    std::vector<float> lut_;
+    std::vector<float> lut_row_;
 };
 
 DayTimeManager::Impl::Impl(RenderPipeline& pipeline): pipeline_(pipeline)
@@ -56,6 +98,76 @@ DayTimeManager::Impl::Impl(RenderPipeline& pipeline): pipeline_(pipeline)
     input_ubo_ = std::make_shared<GroupedInputBlock>("TimeOfDay");
 }
 
+void DayTimeManager::Impl::bake_setting(const SettingInput& input)
+{
+    const size_t num_values = input.float_handle.is_valid() ? 1 : 3;
+    for (size_t row = 0; row <= lut_size_; ++row)
+    {
+        const DayBaseType::ValueType& value = input.setting->get_shader_input_value(row / static_cast<PN_stdfloat>(lut_size_));
+        float* dest = &lut_[row * num_columns_ + input.column];
+        for (size_t k = 0; k < num_values; ++k)
+            dest[k] = static_cast<float>(value.first[k]);
+    }
+}
+
+bool DayTimeManager::Impl::check_modified_settings()
+{
+    bool modified = false;
+    for (auto& input: setting_inputs_)
+    {
+        const size_t version = input.setting->get_version();
+        if (input.version == version)
+            continue;
+
+        input.version = version;
+        modified = true;
+
+        if (lut_size_ > 0)
+            bake_setting(input);
+    }
+    return modified;
+}
+
+void DayTimeManager::Impl::update_inputs()
+{
+    if (setting_inputs_.empty())
+        return;
+
+    if (lut_size_ > 0)
+    {
+        // Linear interpolation between two rows of the table
+        const float position = time_ * lut_size_;
+        const size_t row = (std::min)(static_cast<size_t>(position), lut_size_ - 1);
+        const float t = position - row;
+        const float* lower = &lut_[row * num_columns_];
+        const float* upper = lower + num_columns_;
+        float* result = lut_row_.data();
+        for (size_t k = 0; k < num_columns_; ++k)
+            result[k] = lower[k] + (upper[k] - lower[k]) * t;
+
+        for (const auto& input: setting_inputs_)
+        {
+            if (input.float_handle.is_valid())
+                input_ubo_->update_input(input.float_handle, result[input.column]);
+            else if (input.vec3_handle.is_valid())
+                input_ubo_->update_input(input.vec3_handle, LVecBase3f(result[input.column], result[input.column + 1], result[input.column + 2]));
+        }
+    }
+    else
+    {
+        for (const auto& input: setting_inputs_)
+        {
+            // XXX: Find a better interface for this. Without this fix, colors
+            // are in the range 0 .. 255 in the shader.
+            DayBaseType::ValueType value = input.setting->get_shader_input_value(time_);
+            if (input.float_handle.is_valid())
+                input_ubo_->update_input(input.float_handle, value.first[0]);
+            else if (input.vec3_handle.is_valid())
+                input_ubo_->update_input(input.vec3_handle, value.first);
+        }
+    }
+}
+
 // ************************************************************************************************
 
 DayTimeManager::DayTimeManager(RenderPipeline& pipeline): RPObject("DayTimeManager"), impl_(std::make_unique<Impl>(pipeline))
@@ -101,12 +213,37 @@ void DayTimeManager::load_settings()
         for (const auto& setting_handle: plugin_mgr->get_day_settings(plugin_id)->get<0>())
         {
             const std::string setting_id = plugin_id + "." + setting_handle.key;
-            impl_->input_ubo_->register_pta(setting_id, setting_handle.value->get_glsl_type());
-            impl_->setting_handles_[setting_id] = setting_handle.value;
+
+            Impl::SettingInput input;
+            input.setting = setting_handle.value;
+            input.column = impl_->num_columns_;
+            input.version = setting_handle.value->get_version();
+            if (setting_handle.value->get_glsl_type() == "float")
+            {
+                input.float_handle = impl_->input_ubo_->register_pta<PTA_float>(setting_id);
+                impl_->num_columns_ += 1;
+            }
+            else
+            {
+                input.vec3_handle = impl_->input_ubo_->register_pta<PTA_LVecBase3f>(setting_id);
+                impl_->num_columns_ += 3;
+            }
+            impl_->setting_inputs_.push_back(input);
         }
     }
     impl_->pipeline_.get_stage_mgr()->add_input_blocks(impl_->input_ubo_);
 
+    // Bake the settings into the table
+    impl_->lut_size_ = static_cast<size_t>((std::max)(0, impl_->pipeline_.get_setting<int>("pipeline.daytime_lut_size", 1440)));
+    if (impl_->lut_size_ > 0)
+    {
+        impl_->lut_.assign((impl_->lut_size_ + 1) * impl_->num_columns_, 0.0f);
+        impl_->lut_row_.assign(impl_->num_columns_, 0.0f);
+        for (const auto& input: impl_->setting_inputs_)
+            impl_->bake_setting(input);
+    }
+    impl_->updated_time_ = std::numeric_limits<float>::quiet_NaN();
+
     // Generate UBO shader code
     try
     {
@@ -122,16 +259,13 @@ void DayTimeManager::load_settings()
 
 void DayTimeManager::update()
 {
-    for (const auto& id_handle: impl_->setting_handles_)
-    {
-        // XXX: Find a better interface for this. Without this fix, colors
-        // are in the range 0 .. 255 in the shader.
-        DayBaseType::ValueType value = id_handle.second->get_shader_input_value(impl_->time_);
-        if (value.second == 1)
-            impl_->input_ubo_->update_input(id_handle.first, value.first[0]);
-        else
-            impl_->input_ubo_->update_input(id_handle.first, value.first);
-    }
+    // Nothing to update if the time and the settings are not changed
+    const bool modified = impl_->check_modified_settings();
+    if (!modified && impl_->time_ == impl_->updated_time_)
+        return;
+
+    impl_->update_inputs();
+    impl_->updated_time_ = impl_->time_;
 }
 
 }
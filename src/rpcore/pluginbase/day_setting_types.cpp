@@ -131,6 +131,7 @@ void DayBaseType::set_control_points(const std::vector<std::vector<LVecBase2>>&
 {
     for (size_t index=0, index_end=control_points.size(); index < index_end; ++index)
         _curves[index]->set_control_points(control_points[index]);
+    ++_version;
 }
 
 std::string DayBaseType::serialize() const
@@ -38,6 +38,7 @@
 #include "render_pipeline/rpcore/stage_manager.hpp"
 #include "render_pipeline/rpcore/pluginbase/day_setting_types.hpp"
 #include "render_pipeline/rpcore/pluginbase/setting_types.hpp"
+#include "render_pipeline/rpcore/util/frame_profiler.hpp"
 #include "render_pipeline/rppanda/stdpy/file.hpp"
 #include "render_pipeline/rppanda/util/filesystem.hpp"
 
@@ -116,6 +117,11 @@ public:
     std::unordered_set<PluginIDType> enabled_plugins_;
 
     std::unordered_map<PluginIDType, PluginDataType> plugin_data_map_;
+
+    /** Profiler scopes of pre-render and post-render updates in each plugin. */
+    std::unordered_map<PluginIDType, std::pair<size_t, size_t>> plugin_scopes_;
+
+    const std::pair<size_t, size_t>& get_plugin_scopes(FrameProfiler* profiler, const PluginIDType& plugin_id);
 };
 
 std::unordered_map<PluginManager::PluginIDType, std::function<PluginManager::PluginCreatorType>> PluginManager::Impl::plugin_creators_;
@@ -452,16 +458,38 @@ void PluginManager::Impl::on_prepare_scene(NodePath scene)
     }
 }
 
+const std::pair<size_t, size_t>& PluginManager::Impl::get_plugin_scopes(FrameProfiler* profiler, const PluginIDType& plugin_id)
+{
+    auto found = plugin_scopes_.find(plugin_id);
+    if (found == plugin_scopes_.end())
+    {
+        found = plugin_scopes_.emplace(plugin_id, std::make_pair(
+            profiler->register_scope("Plugins:" + plugin_id + ":pre_render"),
+            profiler->register_scope("Plugins:" + plugin_id + ":post_render"))).first;
+    }
+    return found->second;
+}
+
 void PluginManager::Impl::on_pre_render_update()
 {
+    FrameProfiler* profiler = pipeline_.get_profiler();
+    const bool profiling = profiler->is_enabled();
     for (const auto& plugin_id: enabled_plugins_)
+    {
+        FrameProfiler::Scope scope(profiling ? profiler : nullptr, profiling ? get_plugin_scopes(profiler, plugin_id).first : 0);
         plugin_data_map_.at(plugin_id).instance->on_pre_render_update();
+    }
 }
 
 void PluginManager::Impl::on_post_render_update()
 {
+    FrameProfiler* profiler = pipeline_.get_profiler();
+    const bool profiling = profiler->is_enabled();
     for (const auto& plugin_id: enabled_plugins_)
+    {
+        FrameProfiler::Scope scope(profiling ? profiler : nullptr, profiling ? get_plugin_scopes(profiler, plugin_id).second : 0);
         plugin_data_map_.at(plugin_id).instance->on_post_render_update();
+    }
 }
 
 void PluginManager::Impl::on_shader_reload()
@@ -509,14 +537,14 @@ void PluginManager::Impl::on_setting_changed(const PluginIDType& plugin_id, cons
     if (setting->is_shader_runtime())
     {
         self_.init_defines();
-        pipeline_.get_stage_mgr()->write_autoconfig();
-        plugin_data_map_.at(plugin_id).instance->reload_shaders();
+        pipeline_.reload_changed_shaders();
+        plugin_data_map_.at(plugin_id).instance->on_shader_reload();
     }
 }
 
 void PluginManager::Impl::on_setting_changed(const std::unordered_map<PluginIDType, std::unordered_set<std::string>>& settings_map)
 {
-    bool at_least_shader_runtime = false;
+    std::vector<BasePlugin*> shader_runtime_plugins;
     for (const auto& plugin_id_settings: settings_map)
     {
         const auto& plugin_id = plugin_id_settings.first;
@@ -543,19 +571,17 @@ void PluginManager::Impl::on_setting_changed(const std::unordered_map<PluginIDTy
             if (is_runtime || is_shader_runtime)
                 plugin_instance->on_setting_changed(setting_id);
 
-            at_least_shader_runtime |= is_shader_runtime;
+            if (is_shader_runtime && (shader_runtime_plugins.empty() || shader_runtime_plugins.back() != plugin_instance.get()))
+                shader_runtime_plugins.push_back(plugin_instance.get());
         }
     }
 
-    if (at_least_shader_runtime)
+    if (!shader_runtime_plugins.empty())
     {
         self_.init_defines();
-        pipeline_.get_stage_mgr()->write_autoconfig();
-
-        if (settings_map.size() > 1)
-            pipeline_.reload_shaders();
-        else
-            plugin_data_map_.at(settings_map.begin()->first).instance->reload_shaders();
+        pipeline_.reload_changed_shaders();
+        for (auto&& plugin: shader_runtime_plugins)
+            plugin->on_shader_reload();
     }
 }
 
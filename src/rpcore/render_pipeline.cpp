@@ -24,6 +24,7 @@
 
 #include "render_pipeline/rpcore/render_pipeline.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <regex>
 
@@ -32,12 +33,13 @@
 #include <pandaSystem.h>
 #include <virtualFileSystem.h>
 #include <load_prc_file.h>
-#include <nodePathCollection.h>
 #include <pointLight.h>
 #include <spotlight.h>
 #include <materialAttrib.h>
 #include <geomTristrips.h>
+#include <config_pgraph.h>
 
+#include <boost/algorithm/string/join.hpp>
 #include <boost/dll/runtime_symbol_info.hpp>
 
 #include <fmt/ostream.h>
@@ -51,6 +53,7 @@
 #include "render_pipeline/rpcore/mount_manager.hpp"
 #include "render_pipeline/rpcore/light_manager.hpp"
 #include "render_pipeline/rpcore/util/task_scheduler.hpp"
+#include "render_pipeline/rpcore/util/frame_profiler.hpp"
 #include "render_pipeline/rpcore/util/basic_effects.hpp"
 #include "render_pipeline/rpcore/pluginbase/day_manager.hpp"
 #include "render_pipeline/rpcore/pluginbase/manager.hpp"
@@ -76,6 +79,7 @@
 #include "rpcore/common_resources.hpp"
 #include "rpcore/gui/loading_screen.hpp"
 #include "rpcore/util/ies_profile_loader.hpp"
+#include "rpcore/util/shader_define_tracker.hpp"
 #include "rplibs/yaml.hpp"
 
 namespace rpcore {
@@ -86,12 +90,21 @@ public:
     Impl(RenderPipeline& self);
     ~Impl();
 
+    enum class StateCachePolicy
+    {
+        flush,
+        incremental,
+        size,
+    };
+
     /**
-     * Task which repeatedly clears the state cache to avoid storing
-     * unused states. While running once a while, this task prevents over-polluting
-     * the state-cache with unused states. This complements Panda3D's internal
-     * state garbarge collector, which does a great job, but still cannot clear
-     * up all states.
+     * Task which repeatedly removes unused states from the state cache,
+     * following the pipeline.state_cache_policy setting:
+     *  - flush: clears the whole cache every 2 seconds.
+     *  - incremental: runs Panda3D's state garbage collector each frame,
+     *    within pipeline.state_cache_budget microseconds.
+     *  - size: clears the whole cache when it has more states than
+     *    pipeline.state_cache_max_size.
      */
     AsyncTask::DoneStatus clear_state_cache(rppanda::FunctionalTask* task);
 
@@ -127,6 +140,9 @@ public:
 
     void reload_shaders();
 
+    /** Reloads the stages and the effects using the defines changed after the last reload. */
+    void reload_changed_shaders();
+
     bool create(rppanda::ShowBase* base, PandaFramework* framework);
 
     /**
@@ -228,8 +244,47 @@ public:
     void internal_set_effect(NodePath nodepath, const Filename& effect_src,
         const Effect::OptionType& options=Effect::OptionType(), int sort=30);
 
+    /** Loads the effects of all nodepaths in one batch, and applies them. */
+    void internal_set_effects(const std::vector<std::pair<NodePath, std::pair<Effect::SourceType, int>>>& effects);
+
+    void apply_effect(NodePath nodepath, const Effect& effect, int sort);
+
     void clear_effect(NodePath& nodepath);
 
+    /** Lights and geoms of a scene, and the results of the work on the geoms. */
+    struct SceneAnalysis
+    {
+        struct GeomNodeResult
+        {
+            NodePath nodepath;
+
+            /** Copies of the geoms with tristrips, decomposed to triangles. */
+            std::vector<std::pair<int, PT(Geom)>> decomposed_geoms;
+
+            int num_geoms_without_material = 0;
+            bool has_transparency = false;
+        };
+
+        std::vector<NodePath> point_lights;
+        std::vector<NodePath> spot_lights;
+        std::vector<GeomNodeResult> geom_nodes;
+    };
+
+    /** Collects the lights and the geoms in one traversal of the scene graph. */
+    static void collect_scene_nodes(const NodePath& scene, SceneAnalysis& analysis);
+
+    /**
+     * Finds the lights and geoms of the scene, and decomposes the tristrips
+     * and classifies the materials of the geoms. This does not modify the scene.
+     *
+     * This uses Panda3D objects, so it must run on a thread known to Panda3D,
+     * like the main thread or a thread of a task chain.
+     */
+    static SceneAnalysis analyze_scene(const NodePath& scene);
+
+    /** Converts the lights and applies the geoms and effects. This must run on the main thread. */
+    void apply_scene_analysis(const NodePath& scene, SceneAnalysis& analysis);
+
     void handle_window_resize();
 
     template <class T>
@@ -245,7 +300,12 @@ public:
     LVecBase2i last_window_dims;
     std::unique_ptr<std::chrono::system_clock::time_point> first_frame_;
     std::map<NodePath, std::pair<Effect::SourceType, int>> applied_effects_;
-    StereoMode stereo_mode_;
+
+    StateCachePolicy state_cache_policy_ = StateCachePolicy::flush;
+    std::chrono::microseconds state_cache_budget_;
+    int state_cache_max_size_;
+    StateCacheStats state_cache_stats_;
+    StereoMode stereo_mode_ = StereoMode::none;
 
     bool pre_showbase_initialized = false;
 
@@ -256,7 +316,16 @@ public:
     std::vector<std::unique_ptr<RenderStage>> internal_stages_;
 
     std::shared_ptr<rppanda::ShowBase> showbase_;
+
+    /** Tasks of prepare_scene_async which use the pipeline on the main thread. */
+    std::vector<PT(AsyncTask)> prepare_scene_tasks_;
     std::unique_ptr<TaskScheduler> task_scheduler_;
+    std::unique_ptr<FrameProfiler> profiler_;
+    size_t task_scheduler_scope_;
+    size_t debugger_scope_;
+    size_t daytime_mgr_scope_;
+    size_t light_mgr_scope_;
+    size_t common_resources_scope_;
     std::unique_ptr<TagStateManager> tag_mgr_;
     std::unique_ptr<PluginManager> plugin_mgr_;
     std::unique_ptr<MountManager> mount_mgr_;
@@ -264,6 +333,8 @@ public:
     std::unique_ptr<LightManager> light_mgr_;
     std::unique_ptr<DayTimeManager> daytime_mgr_;
     std::unique_ptr<IESProfileLoader> ies_loader_;
+
+    ShaderDefineTracker define_tracker_;
 };
 
 RenderPipeline::Impl::Impl(RenderPipeline& self): self_(self)
@@ -274,6 +345,11 @@ RenderPipeline::Impl::~Impl()
 {
     self_.debug("Destructing RenderPipeline");
 
+    // The pending futures of prepare_scene_async get broken promises.
+    for (auto& task: prepare_scene_tasks_)
+        task->remove();
+    prepare_scene_tasks_.clear();
+
     common_resources_.reset();
     ies_loader_.reset();
     daytime_mgr_.reset();
@@ -282,9 +358,12 @@ RenderPipeline::Impl::~Impl()
     tag_mgr_.reset();
     task_scheduler_.reset();
     debugger_.reset();
+    profiler_.reset();
     loading_screen_.reset();
 
-    plugin_mgr_->unload();
+    // the managers are not created if the pipeline is used without create()
+    if (plugin_mgr_)
+        plugin_mgr_->unload();
 
     internal_stages_.clear();
 
@@ -309,11 +388,36 @@ void RenderPipeline::Impl::internal_set_effect(NodePath nodepath, const Filename
         return;
     }
 
+    apply_effect(nodepath, *effect, sort);
+}
+
+void RenderPipeline::Impl::internal_set_effects(const std::vector<std::pair<NodePath, std::pair<Effect::SourceType, int>>>& effects)
+{
+    std::vector<Effect::SourceType> sources;
+    sources.reserve(effects.size());
+    for (const auto& np_effect: effects)
+        sources.push_back(np_effect.second.first);
+
+    const auto& loaded_effects = Effect::load_many(self_, sources);
+    for (size_t k = 0, k_end = effects.size(); k < k_end; ++k)
+    {
+        if (!loaded_effects[k])
+        {
+            self_.error("Could not apply effect");
+            continue;
+        }
+
+        apply_effect(effects[k].first, *loaded_effects[k], effects[k].second.second);
+    }
+}
+
+void RenderPipeline::Impl::apply_effect(NodePath nodepath, const Effect& effect, int sort)
+{
     const auto& passes = Effect::get_passes();
     for (int i = 0, i_end = static_cast<int>(passes.size()); i < i_end; ++i)
     {
         const std::string& stage = passes[i].id;
-        const bool stage_option = effect->get_option(Effect::pass_option_prefix + stage);
+        const bool stage_option = effect.get_option(Effect::pass_option_prefix + stage);
 
         if (!tag_mgr_->has_state(stage))
         {
@@ -328,21 +432,21 @@ void RenderPipeline::Impl::internal_set_effect(NodePath nodepath, const Filename
         }
         else
         {
-            Shader* shader = effect->get_shader_obj(stage);
+            Shader* shader = effect.get_shader_obj(stage);
             if (stage == "gbuffer")
             {
                 nodepath.set_shader(shader, 25);
             }
             else
             {
-                tag_mgr_->apply_state(stage, nodepath, shader, std::to_string(effect->get_effect_id()), 25 + 10 * i + sort);
+                tag_mgr_->apply_state(stage, nodepath, shader, std::to_string(effect.get_effect_id()), 25 + 10 * i + sort);
             }
             nodepath.show_through(tag_mgr_->get_mask(stage));
         }
     }
 
-    if (effect->get_option(Effect::pass_option_prefix + std::string("gbuffer")) &&
-        effect->get_option(Effect::pass_option_prefix + std::string("forward")))
+    if (effect.get_option(Effect::pass_option_prefix + std::string("gbuffer")) &&
+        effect.get_option(Effect::pass_option_prefix + std::string("forward")))
     {
         self_.error("You cannot render an object forward and deferred at the "
             "same time! Either use render_gbuffer or use render_forward, "
@@ -388,19 +492,71 @@ void RenderPipeline::Impl::clear_effect(NodePath& nodepath)
 
 AsyncTask::DoneStatus RenderPipeline::Impl::clear_state_cache(rppanda::FunctionalTask* task)
 {
-    task->set_delay(2.0f);
-    TransformState::clear_cache();
-    RenderState::clear_cache();
+    const auto& start_time = std::chrono::steady_clock::now();
+    const int num_states = TransformState::get_num_states() + RenderState::get_num_states();
+
+    switch (state_cache_policy_)
+    {
+        case StateCachePolicy::flush:
+        {
+            task->set_delay(2.0f);
+            TransformState::clear_cache();
+            RenderState::clear_cache();
+            break;
+        }
+
+        case StateCachePolicy::incremental:
+        {
+            // Each call walks a part of the cache (garbage-collect-states-rate),
+            // so keep collecting while it finds garbage and the budget remains.
+            while (TransformState::garbage_collect() + RenderState::garbage_collect() > 0)
+            {
+                if (std::chrono::steady_clock::now() - start_time >= state_cache_budget_)
+                    break;
+            }
+            break;
+        }
+
+        case StateCachePolicy::size:
+        {
+            if (num_states > state_cache_max_size_)
+            {
+                TransformState::clear_cache();
+                RenderState::clear_cache();
+            }
+            break;
+        }
+    }
+
+    state_cache_stats_.num_states_before = num_states;
+    state_cache_stats_.num_states_after = TransformState::get_num_states() + RenderState::get_num_states();
+    state_cache_stats_.duration_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+
     return AsyncTask::DS_again;
 }
 
 AsyncTask::DoneStatus RenderPipeline::Impl::manager_update_task(rppanda::FunctionalTask* task)
 {
-    task_scheduler_->step();
+    // this is the first task of the pipeline in a frame
+    profiler_->begin_frame();
+
+    {
+        FrameProfiler::Scope scope(profiler_.get(), task_scheduler_scope_);
+        task_scheduler_->step();
+    }
     if (debugger_)
+    {
+        FrameProfiler::Scope scope(profiler_.get(), debugger_scope_);
         debugger_->update();
-    daytime_mgr_->update();
-    light_mgr_->update();
+    }
+    {
+        FrameProfiler::Scope scope(profiler_.get(), daytime_mgr_scope_);
+        daytime_mgr_->update();
+    }
+    {
+        FrameProfiler::Scope scope(profiler_.get(), light_mgr_scope_);
+        light_mgr_->update();
+    }
 
     if (rpcore::Globals::clock->get_frame_count() == 10)
     {
@@ -413,7 +569,10 @@ AsyncTask::DoneStatus RenderPipeline::Impl::manager_update_task(rppanda::Functio
 
 AsyncTask::DoneStatus RenderPipeline::Impl::update_inputs_and_stages(rppanda::FunctionalTask* task)
 {
-    common_resources_->update();
+    {
+        FrameProfiler::Scope scope(profiler_.get(), common_resources_scope_);
+        common_resources_->update();
+    }
     stage_mgr_->update();
     return AsyncTask::DS_cont;
 }
@@ -485,6 +644,7 @@ void RenderPipeline::Impl::reload_shaders()
     }
 
     tag_mgr_->cleanup_states();
+    Effect::clear_cache();
     stage_mgr_->reload_shaders();
     light_mgr_->reload_shaders();
     set_default_effect();
@@ -496,6 +656,55 @@ void RenderPipeline::Impl::reload_shaders()
     showbase_->get_messenger()->send(reload_shaders_event_name, false);
 }
 
+void RenderPipeline::Impl::reload_changed_shaders()
+{
+    const auto& changed_defines = stage_mgr_->get_changed_defines();
+    if (changed_defines.empty())
+    {
+        self_.debug("No defines are changed, skipping shader reload.");
+        return;
+    }
+
+    const auto& start_time = std::chrono::steady_clock::now();
+
+    stage_mgr_->write_autoconfig();
+
+    std::vector<std::string> reloaded_stages;
+    for (const auto& stage: stage_mgr_->get_stages())
+    {
+        // Reload the stages which do not load shaders through RenderStage::load_shader, too.
+        const auto& shader_files = stage->get_shader_files();
+        if (shader_files.empty() || define_tracker_.uses_defines(shader_files, changed_defines))
+        {
+            stage->reload_shaders();
+            reloaded_stages.push_back(stage->get_debug_name());
+        }
+    }
+
+    // This reloads only the shader of the command queue.
+    light_mgr_->reload_shaders();
+
+    // The effects are applied to the nodes through the tag states, so all of them are reloaded.
+    const bool reload_effects = define_tracker_.uses_defines(Effect::get_cached_shader_files(), changed_defines);
+    if (reload_effects)
+    {
+        tag_mgr_->cleanup_states();
+        Effect::clear_cache();
+        set_default_effect();
+        apply_custom_shaders();
+    }
+
+    const std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start_time;
+    self_.debug(fmt::format("Reloaded shaders of {} / {} stages{} in {:.1f} ms for the changed defines: {}",
+        reloaded_stages.size(), stage_mgr_->get_stages().size(), reload_effects ? " and the effects" : "",
+        duration.count(), boost::algorithm::join(changed_defines, ", ")));
+    if (!reloaded_stages.empty())
+        self_.debug(fmt::format("Reloaded stages: {}", boost::algorithm::join(reloaded_stages, ", ")));
+
+    if (reload_effects)
+        showbase_->get_messenger()->send(reload_shaders_event_name, false);
+}
+
 bool RenderPipeline::Impl::create(rppanda::ShowBase* base, PandaFramework* framework)
 {
     const auto& start_time = std::chrono::system_clock::now();
@@ -545,11 +754,7 @@ bool RenderPipeline::Impl::create(rppanda::ShowBase* base, PandaFramework* frame
 void RenderPipeline::Impl::apply_custom_shaders()
 {
     self_.debug(fmt::format("Re-applying {} custom shaders", applied_effects_.size()));
-    for (const auto& np_effect : applied_effects_)
-    {
-        const auto& effect_souce = np_effect.second.first;
-        internal_set_effect(np_effect.first, effect_souce.first, effect_souce.second, np_effect.second.second);
-    }
+    internal_set_effects({applied_effects_.begin(), applied_effects_.end()});
 }
 
 void RenderPipeline::Impl::create_managers()
@@ -557,6 +762,14 @@ void RenderPipeline::Impl::create_managers()
     self_.trace("Creating managers ...");
 
     task_scheduler_ = std::make_unique<TaskScheduler>();
+
+    profiler_ = std::make_unique<FrameProfiler>(get_setting<size_t>("pipeline.profiler_frames", 300));
+    task_scheduler_scope_ = profiler_->register_scope("TaskScheduler");
+    debugger_scope_ = profiler_->register_scope("Debugger");
+    daytime_mgr_scope_ = profiler_->register_scope("DayTimeManager");
+    light_mgr_scope_ = profiler_->register_scope("LightManager");
+    common_resources_scope_ = profiler_->register_scope("CommonResources");
+
     tag_mgr_ = std::make_unique<TagStateManager>(Globals::base->get_cam());
     plugin_mgr_ = std::make_unique<PluginManager>(self_);
     stage_mgr_ = std::make_unique<StageManager>(self_);
@@ -753,7 +966,28 @@ void RenderPipeline::Impl::init_bindings()
 
     // igloop has 50 sorting value.
     showbase_->add_task(std::bind(&Impl::plugin_post_render_update, this, std::placeholders::_1), "RP_Plugin_AfterRender", 55);
-    showbase_->get_task_mgr()->do_method_later(0.5f, std::bind(&Impl::clear_state_cache, this, std::placeholders::_1), "RP_ClearStateCache");
+
+    const std::string& state_cache_policy = get_setting<std::string>("pipeline.state_cache_policy", "flush");
+    if (state_cache_policy == "incremental")
+        state_cache_policy_ = StateCachePolicy::incremental;
+    else if (state_cache_policy == "size")
+        state_cache_policy_ = StateCachePolicy::size;
+    else if (state_cache_policy != "flush")
+        self_.warn(fmt::format("Unknown state cache policy '{}', using 'flush'.", state_cache_policy));
+
+    if (state_cache_policy_ == StateCachePolicy::incremental && !garbage_collect_states)
+    {
+        self_.warn("garbage-collect-states is disabled, so the state cache is flushed instead.");
+        state_cache_policy_ = StateCachePolicy::flush;
+    }
+
+    state_cache_budget_ = std::chrono::microseconds(get_setting<int>("pipeline.state_cache_budget", 200));
+    state_cache_max_size_ = get_setting<int>("pipeline.state_cache_max_size", 20000);
+
+    if (state_cache_policy_ == StateCachePolicy::flush)
+        showbase_->get_task_mgr()->do_method_later(0.5f, std::bind(&Impl::clear_state_cache, this, std::placeholders::_1), "RP_ClearStateCache");
+    else
+        showbase_->add_task(std::bind(&Impl::clear_state_cache, this, std::placeholders::_1), "RP_ClearStateCache", 60);
     showbase_->accept("window-event", [this](const Event* ev) { handle_window_event(ev); });
 }
 
@@ -846,6 +1080,162 @@ NodePath RenderPipeline::Impl::create_default_skybox(float size)
     return skybox;
 }
 
+void RenderPipeline::Impl::collect_scene_nodes(const NodePath& scene, SceneAnalysis& analysis)
+{
+    // Imported hierarchies can be very deep, so this uses an explicit stack
+    // instead of recursion. The children are pushed in reverse to visit the
+    // nodes in the same order as find_all_matches.
+    std::vector<std::pair<NodePath, bool>> stack = { { scene, false } };
+    while (!stack.empty())
+    {
+        const NodePath np = std::move(stack.back().first);
+        bool under_light = stack.back().second;
+        stack.pop_back();
+
+        PandaNode* node = np.node();
+        if (node->is_of_type(PointLight::get_class_type()))
+        {
+            analysis.point_lights.push_back(np);
+            under_light = true;
+        }
+        else if (node->is_of_type(Spotlight::get_class_type()))
+        {
+            analysis.spot_lights.push_back(np);
+            under_light = true;
+        }
+        else if (!under_light && node->is_of_type(GeomNode::get_class_type()))
+        {
+            // The lights are removed with their children, so skip the geoms under them.
+            analysis.geom_nodes.emplace_back();
+            analysis.geom_nodes.back().nodepath = np;
+        }
+
+        PandaNode::Children children = node->get_children();
+        for (int k = children.get_num_children() - 1; k >= 0; --k)
+            stack.emplace_back(NodePath(np, children.get_child(k)), under_light);
+    }
+}
+
+RenderPipeline::Impl::SceneAnalysis RenderPipeline::Impl::analyze_scene(const NodePath& scene)
+{
+    SceneAnalysis analysis;
+    collect_scene_nodes(scene, analysis);
+
+    // The nodes are only read here, and the decomposed geoms are copies which
+    // are set in apply_scene_analysis.
+    for (auto& result: analysis.geom_nodes)
+    {
+        const GeomNode* geom_node = DCAST(GeomNode, result.nodepath.node());
+
+        for (int i = 0, geom_count = geom_node->get_num_geoms(); i < geom_count; ++i)
+        {
+            const RenderState* state = geom_node->get_geom_state(i);
+            CPT(Geom) geom = geom_node->get_geom(i);
+
+            for (int prim_index = 0, prim_end = geom->get_num_primitives(); prim_index < prim_end; ++prim_index)
+            {
+                if (geom->get_primitive(prim_index)->is_of_type(GeomTristrips::get_class_type()))
+                {
+                    PT(Geom) decomposed = geom->make_copy();
+                    decomposed->decompose_in_place();
+                    result.decomposed_geoms.emplace_back(i, decomposed);
+                    break;
+                }
+            }
+
+            if (!state->has_attrib(MaterialAttrib::get_class_type()))
+            {
+                ++result.num_geoms_without_material;
+                continue;
+            }
+
+            // SHADING_MODEL_TRANSPARENT
+            const Material* material = DCAST(MaterialAttrib, state->get_attrib(MaterialAttrib::get_class_type()))->get_material();
+            if (material && material->get_emission().get_x() == 3)
+                result.has_transparency = true;
+        }
+    }
+
+    return analysis;
+}
+
+void RenderPipeline::Impl::apply_scene_analysis(const NodePath& scene, SceneAnalysis& analysis)
+{
+    const NodePath& render = Globals::base->get_render();
+
+    for (auto& light: analysis.point_lights)
+    {
+        PointLight* light_node = DCAST(PointLight, light.node());
+        PT(RPPointLight) rp_light = new RPPointLight;
+        rp_light->set_pos(light.get_pos(render));
+        rp_light->set_radius(light_node->get_max_distance());
+        rp_light->set_energy(20.0f * light_node->get_color().get_w());
+        rp_light->set_color(light_node->get_color().get_xyz());
+        rp_light->set_casts_shadows(light_node->is_shadow_caster());
+        rp_light->set_shadow_map_resolution(light_node->get_shadow_buffer_size().get_x());
+        rp_light->set_inner_radius(0.4);
+
+        self_.add_light(rp_light);
+        light.remove_node();
+    }
+
+    for (auto& light: analysis.spot_lights)
+    {
+        Spotlight* light_node = DCAST(Spotlight, light.node());
+        PT(RPSpotLight) rp_light = new RPSpotLight;
+        rp_light->set_pos(light.get_pos(render));
+        rp_light->set_radius(light_node->get_max_distance());
+        rp_light->set_energy(20.0f * light_node->get_color().get_w());
+        rp_light->set_color(light_node->get_color().get_xyz());
+        rp_light->set_casts_shadows(light_node->is_shadow_caster());
+        rp_light->set_shadow_map_resolution(light_node->get_shadow_buffer_size().get_x());
+        rp_light->set_fov(light_node->get_exponent() / MathNumbers::pi * 180.0f);
+        LVecBase3 lpoint = light.get_mat(render).xform_vec(LVecBase3(0, 0, -1));
+        rp_light->set_direction(lpoint);
+
+        self_.add_light(rp_light);
+        light.remove_node();
+    }
+
+    bool tristrips_warning_emitted = false;
+    std::vector<std::pair<NodePath, std::pair<Effect::SourceType, int>>> transparent_effects;
+    for (auto& result: analysis.geom_nodes)
+    {
+        GeomNode* geom_node = DCAST(GeomNode, result.nodepath.node());
+
+        if (!result.decomposed_geoms.empty() && !tristrips_warning_emitted)
+        {
+            self_.warn(fmt::format("At least one GeomNode ({} and possible more..) contains tristrips.", geom_node->get_name()));
+            self_.warn("Due to a NVIDIA Driver bug, we have to convert them to triangles now.");
+            self_.warn("Consider exporting your models with the Bam Exporter to avoid this.");
+            tristrips_warning_emitted = true;
+        }
+
+        for (auto& index_geom: result.decomposed_geoms)
+            geom_node->set_geom(index_geom.first, index_geom.second);
+
+        for (int k = 0; k < result.num_geoms_without_material; ++k)
+            self_.warn(fmt::format("Geom {} has no material! Please fix this.", geom_node->get_name()));
+
+        if (result.has_transparency)
+        {
+            if (geom_node->get_num_geoms() > 1)
+            {
+                self_.error(fmt::format("Transparent materials must be on their own geom!\n"
+                    "If you are exporting from blender, split them into\n"
+                    "seperate meshes, then re-export your scene. The\n"
+                    "problematic mesh is: {}", result.nodepath.get_name()));
+                continue;
+            }
+            transparent_effects.push_back({result.nodepath, {get_transparent_effect_source(), 100}});
+        }
+    }
+
+    self_.set_effects(transparent_effects);
+
+    plugin_mgr_->on_prepare_scene(scene);
+}
+
 void RenderPipeline::Impl::handle_window_resize()
 {
     adjust_lens_setting();
@@ -991,6 +1381,11 @@ void RenderPipeline::reload_shaders()
     impl_->reload_shaders();
 }
 
+void RenderPipeline::reload_changed_shaders()
+{
+    impl_->reload_changed_shaders();
+}
+
 bool RenderPipeline::pre_showbase_init()
 {
     if (!impl_->mount_mgr_->is_mounted())
@@ -1058,6 +1453,13 @@ void RenderPipeline::set_effect(const NodePath& nodepath, const Filename& effect
     impl_->internal_set_effect(nodepath, effect_src, options, sort);
 }
 
+void RenderPipeline::set_effects(const std::vector<std::pair<NodePath, std::pair<Effect::SourceType, int>>>& effects)
+{
+    for (const auto& np_effect: effects)
+        impl_->applied_effects_.insert_or_assign(np_effect.first, np_effect.second);
+    impl_->internal_set_effects(effects);
+}
+
 void RenderPipeline::clear_effect(NodePath& nodepath)
 {
     impl_->clear_effect(nodepath);
@@ -1073,119 +1475,68 @@ rpplugins::EnvironmentProbe* RenderPipeline::add_environment_probe()
 
 void RenderPipeline::prepare_scene(const NodePath& scene)
 {
-    std::vector<RPLight*> lights;
-
-    NodePathCollection pl_npc = scene.find_all_matches("**/+PointLight");
-    if (!scene.is_empty() && scene.node()->is_of_type(PointLight::get_class_type()))
-        pl_npc.add_path(scene);
-    for (int k=0, k_end=pl_npc.get_num_paths(); k < k_end; ++k)
-    {
-        NodePath light = pl_npc[k];
+    if (scene.is_empty())
+        return;
 
-        PointLight* light_node = DCAST(PointLight, light.node());
-        PT(RPPointLight) rp_light = new RPPointLight;
-        rp_light->set_pos(light.get_pos(Globals::base->get_render()));
-        rp_light->set_radius(light_node->get_max_distance());
-        rp_light->set_energy(20.0f * light_node->get_color().get_w());
-        rp_light->set_color(light_node->get_color().get_xyz());
-        rp_light->set_casts_shadows(light_node->is_shadow_caster());
-        rp_light->set_shadow_map_resolution(light_node->get_shadow_buffer_size().get_x());
-        rp_light->set_inner_radius(0.4);
+    Impl::SceneAnalysis analysis = Impl::analyze_scene(scene);
+    impl_->apply_scene_analysis(scene, analysis);
+}
 
-        add_light(rp_light);
-        light.remove_node();
-        lights.push_back(rp_light);
-    }
+std::future<void> RenderPipeline::prepare_scene_async(const NodePath& scene)
+{
+    auto promise = std::make_shared<std::promise<void>>();
+    std::future<void> result = promise->get_future();
 
-    NodePathCollection sp_npc = scene.find_all_matches("**/+Spotlight");
-    if (!scene.is_empty() && scene.node()->is_of_type(Spotlight::get_class_type()))
-        sp_npc.add_path(scene);
-    for (int k=0, k_end=sp_npc.get_num_paths(); k < k_end; ++k)
+    if (scene.is_empty())
     {
-        NodePath light = sp_npc[k];
-
-        Spotlight* light_node = DCAST(Spotlight, light.node());
-        PT(RPSpotLight) rp_light = new RPSpotLight;
-        rp_light->set_pos(light.get_pos(Globals::base->get_render()));
-        rp_light->set_radius(light_node->get_max_distance());
-        rp_light->set_energy(20.0f * light_node->get_color().get_w());
-        rp_light->set_color(light_node->get_color().get_xyz());
-        rp_light->set_casts_shadows(light_node->is_shadow_caster());
-        rp_light->set_shadow_map_resolution(light_node->get_shadow_buffer_size().get_x());
-        rp_light->set_fov(light_node->get_exponent() / MathNumbers::pi * 180.0f);
-        LVecBase3 lpoint = light.get_mat(Globals::base->get_render()).xform_vec(LVecBase3(0, 0, -1));
-        rp_light->set_direction(lpoint);
-
-        add_light(rp_light);
-        light.remove_node();
-        lights.push_back(rp_light);
+        promise->set_value();
+        return result;
     }
 
-    bool tristrips_warning_emitted = false;
-    NodePathCollection gn_npc = scene.find_all_matches("**/+GeomNode");
-    if (scene.node()->is_of_type(GeomNode::get_class_type()))
-        gn_npc.add_path(scene);
-    for (int k=0, k_end=gn_npc.get_num_paths(); k < k_end; ++k)
-    {
-        NodePath geom_np = gn_npc.get_path(k);
-        GeomNode* geom_node = DCAST(GeomNode, geom_np.node());
-        const int geom_count = geom_node->get_num_geoms();
-        bool has_transparency = false;
+    // The analysis uses Panda3D objects, so it runs on a thread of a task chain
+    // instead of the thread pool, which Panda3D does not know.
+    auto task_mgr = rppanda::TaskManager::get_global_instance();
+    if (!task_mgr->has_task_chain("RP_PrepareScene"))
+        task_mgr->setup_task_chain("RP_PrepareScene", 1, false, boost::none, boost::none, false);
 
-        for (int i = 0; i < geom_count; ++i)
+    auto analysis_promise = std::make_shared<std::promise<Impl::SceneAnalysis>>();
+    auto analysis = std::make_shared<std::future<Impl::SceneAnalysis>>(analysis_promise->get_future());
+    task_mgr->add([scene, analysis_promise](rppanda::FunctionalTask*) {
+        try
         {
-            const RenderState* state = geom_node->get_geom_state(i);
-            CPT(Geom) geom = geom_node->get_geom(i);
-
-            bool needs_conversion = false;
-            for (int prim_index=0, prim_end=geom->get_num_primitives(); prim_index < prim_end; ++prim_index)
-            {
-                CPT(GeomPrimitive) prim = geom->get_primitive(prim_index);
-                if (prim->is_of_type(GeomTristrips::get_class_type()))
-                {
-                    needs_conversion = true;
-                    if (!tristrips_warning_emitted)
-                    {
-                        warn(fmt::format("At least one GeomNode ({} and possible more..) contains tristrips.", geom_node->get_name()));
-                        warn("Due to a NVIDIA Driver bug, we have to convert them to triangles now.");
-                        warn("Consider exporting your models with the Bam Exporter to avoid this.");
-                        tristrips_warning_emitted = true;
-                        break;
-                    }
-                }
-            }
+            analysis_promise->set_value(Impl::analyze_scene(scene));
+        }
+        catch (...)
+        {
+            analysis_promise->set_exception(std::current_exception());
+        }
+        return AsyncTask::DS_done;
+    }, "RP_AnalyzeScene", boost::none, {}, boost::none, std::string("RP_PrepareScene"));
 
-            if (needs_conversion)
-                geom_node->modify_geom(i)->decompose_in_place();
+    // drop the finished tasks
+    auto& tasks = impl_->prepare_scene_tasks_;
+    tasks.erase(std::remove_if(tasks.begin(), tasks.end(), [](const PT(AsyncTask)& task) {
+        return !task->is_alive();
+    }), tasks.end());
 
-            if (!state->has_attrib(MaterialAttrib::get_class_type()))
-            {
-                warn(fmt::format("Geom {} has no material! Please fix this.", geom_node->get_name()));
-                continue;
-            }
+    tasks.push_back(impl_->showbase_->add_task([this, scene, analysis, promise](rppanda::FunctionalTask*) {
+        if (analysis->wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return AsyncTask::DS_cont;
 
-            Material* material = DCAST(MaterialAttrib, state->get_attrib(MaterialAttrib::get_class_type()))->get_material();
-            float shading_model = material->get_emission().get_x();
-            if (!has_transparency && shading_model == 3)
-                has_transparency = true;
+        try
+        {
+            Impl::SceneAnalysis result = analysis->get();
+            impl_->apply_scene_analysis(scene, result);
+            promise->set_value();
         }
-
-        // SHADING_MODEL_TRANSPARENT
-        if (has_transparency)
+        catch (...)
         {
-            if (geom_count > 1)
-            {
-                error(fmt::format("Transparent materials must be on their own geom!\n"
-                    "If you are exporting from blender, split them into\n"
-                    "seperate meshes, then re-export your scene. The\n"
-                    "problematic mesh is: {}", geom_np.get_name()));
-                continue;
-            }
-            set_effect(geom_np, get_transparent_effect_source(), 100);
+            promise->set_exception(std::current_exception());
         }
-    }
+        return AsyncTask::DS_done;
+    }, "RP_PrepareScene", 5));
 
-    impl_->plugin_mgr_->on_prepare_scene(scene);
+    return result;
 }
 
 void RenderPipeline::compute_render_resolution(float resolution_scale)
@@ -1341,6 +1692,11 @@ TaskScheduler* RenderPipeline::get_task_scheduler() const
     return impl_->task_scheduler_.get();
 }
 
+FrameProfiler* RenderPipeline::get_profiler() const
+{
+    return impl_->profiler_.get();
+}
+
 DayTimeManager* RenderPipeline::get_daytime_mgr() const
 {
     return impl_->daytime_mgr_.get();
@@ -1351,4 +1707,9 @@ Debugger* RenderPipeline::get_debugger() const
     return impl_->debugger_.get();
 }
 
+const RenderPipeline::StateCacheStats& RenderPipeline::get_state_cache_stats() const
+{
+    return impl_->state_cache_stats_;
+}
+
 }
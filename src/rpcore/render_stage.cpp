@@ -22,6 +22,8 @@
 
 #include "render_pipeline/rpcore/render_stage.hpp"
 
+#include <algorithm>
+
 #include <graphicsWindow.h>
 
 #include <fmt/format.h>
@@ -174,6 +176,12 @@ PT(Shader) RenderStage::get_shader_handle(const Filename& base_path, const std::
         }
     }
 
+    for (const auto& path: path_args)
+    {
+        if (std::find(shader_files_.begin(), shader_files_.end(), path) == shader_files_.end())
+            shader_files_.push_back(path);
+    }
+
     return RPLoader::load_shader(path_args);
 }
 
@@ -0,0 +1,124 @@
+/**
+ * Render Pipeline C++
+ *
+ * Copyright (c) 2014-2016 tobspr <tobias.springer1@gmail.com>
+ * Copyright (c) 2016-2017 Center of Human-centered Interaction for Coexistence.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "rpcore/stage_graph.hpp"
+
+namespace rpcore {
+
+StageGraph::StageGraph(): external_pipes_({ "ShadedScene", "Exposure" })
+{
+}
+
+size_t StageGraph::add_stage(const std::string& stage_id, const std::vector<std::string>& required_pipes,
+    const std::vector<std::string>& required_inputs, const std::vector<std::string>& produced_pipes,
+    bool is_root)
+{
+    Node node;
+    node.stage_id = stage_id;
+
+    for (const auto& pipe: required_pipes)
+        resolve(node, pipe, true);
+
+    // Input blocks produced as pipes can be bound as inputs, too.
+    for (const auto& input: required_inputs)
+        resolve(node, input, false);
+
+    node.produced_pipes = produced_pipes;
+    node.is_root = is_root || produced_pipes.empty();
+
+    const size_t index = nodes_.size();
+    for (const auto& pipe: node.produced_pipes)
+        pipe_producers_[pipe] = index;
+
+    nodes_.push_back(std::move(node));
+    return index;
+}
+
+void StageGraph::add_external_pipe(const std::string& pipe)
+{
+    external_pipes_.insert(pipe);
+}
+
+void StageGraph::compile()
+{
+    ordering_errors_.clear();
+    for (size_t k = 0, k_end = nodes_.size(); k < k_end; ++k)
+    {
+        for (const auto& pipe: nodes_[k].unresolved_pipes)
+        {
+            auto found = pipe_producers_.find(pipe);
+            if (found != pipe_producers_.end())
+                ordering_errors_.push_back({ k, pipe, found->second });
+        }
+    }
+
+    for (auto& node: nodes_)
+        node.is_live = false;
+
+    for (const auto& pipe: external_pipes_)
+    {
+        auto found = pipe_producers_.find(pipe);
+        if (found != pipe_producers_.end())
+            nodes_[found->second].is_live = true;
+    }
+
+    // Each node depends only on the previous nodes, so the stage order is
+    // a topological order and a reverse pass finds all used stages.
+    for (auto iter = nodes_.rbegin(), iter_end = nodes_.rend(); iter != iter_end; ++iter)
+    {
+        if (!iter->is_root && !iter->is_live)
+            continue;
+
+        iter->is_live = true;
+        for (const auto index: iter->dependencies)
+            nodes_[index].is_live = true;
+    }
+}
+
+std::vector<size_t> StageGraph::get_unused_nodes() const
+{
+    std::vector<size_t> unused_nodes;
+    for (size_t k = 0, k_end = nodes_.size(); k < k_end; ++k)
+    {
+        if (!nodes_[k].is_live)
+            unused_nodes.push_back(k);
+    }
+    return unused_nodes;
+}
+
+void StageGraph::resolve(Node& node, const std::string& name, bool is_pipe)
+{
+    const auto pos = name.rfind("::");
+    if (pos != std::string::npos && (name.find("PreviousFrame::") == 0 || name.find("FuturePipe::") == 0))
+    {
+        // These read the final version of the pipe.
+        external_pipes_.insert(name.substr(pos + 2));
+        return;
+    }
+
+    auto found = pipe_producers_.find(name);
+    if (found != pipe_producers_.end())
+        node.dependencies.push_back(found->second);
+    else if (is_pipe)
+        node.unresolved_pipes.push_back(name);
+}
+
+}
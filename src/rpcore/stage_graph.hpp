@@ -0,0 +1,130 @@
+/**
+ * Render Pipeline C++
+ *
+ * Copyright (c) 2014-2016 tobspr <tobias.springer1@gmail.com>
+ * Copyright (c) 2016-2017 Center of Human-centered Interaction for Coexistence.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <render_pipeline/rpcore/config.hpp>
+
+namespace rpcore {
+
+/**
+ * Dependency graph of the stages by their pipes.
+ *
+ * This uses only the stage ids and the names of the pipes, so it can be built
+ * and checked without creating the stages. StageManager builds it in the stage
+ * order after creating each stage.
+ */
+class RENDER_PIPELINE_DECL StageGraph
+{
+public:
+    struct Node
+    {
+        std::string stage_id;
+
+        /** Names of the pipes produced by the stage. */
+        std::vector<std::string> produced_pipes;
+
+        /** Indices of the nodes producing the pipes required by the stage. */
+        std::vector<size_t> dependencies;
+
+        /** Required pipes which are not produced by any previous stage. */
+        std::vector<std::string> unresolved_pipes;
+
+        /** Whether the stage has to run even if no other stage uses its pipes. */
+        bool is_root = false;
+
+        bool is_live = false;
+    };
+
+    /** Required pipe which is produced only by a later stage. */
+    struct OrderingError
+    {
+        size_t node;
+        std::string pipe;
+        size_t producer;
+    };
+
+    /** The final versions of ShadedScene and Exposure are used by the GUI. */
+    StageGraph();
+
+    /**
+     * Adds a node of the stage. The required pipes are resolved to the latest
+     * stage producing them, so this has to be called in the stage order.
+     *
+     * @param required_pipes    Pipes which are reported if no previous stage produces them.
+     * @param required_inputs   Inputs which may be produced by a previous stage as pipes.
+     * @param is_root           Whether the stage has to run, for example because it renders
+     *                          to the window or produces global inputs. A stage without
+     *                          produced pipes is always a root.
+     * @return  Index of the node.
+     */
+    size_t add_stage(const std::string& stage_id, const std::vector<std::string>& required_pipes,
+        const std::vector<std::string>& required_inputs, const std::vector<std::string>& produced_pipes,
+        bool is_root);
+
+    /** Marks the final version of the pipe as used, for example by the GUI. */
+    void add_external_pipe(const std::string& pipe);
+
+    /** Finds the ordering errors and the nodes whose pipes are used. */
+    void compile();
+
+    const std::vector<Node>& get_nodes() const;
+
+    /** Returns the ordering errors found by compile(). */
+    const std::vector<OrderingError>& get_ordering_errors() const;
+
+    /** Returns the indices of the nodes which are not used by compile(). */
+    std::vector<size_t> get_unused_nodes() const;
+
+private:
+    void resolve(Node& node, const std::string& name, bool is_pipe);
+
+    std::vector<Node> nodes_;
+    std::vector<OrderingError> ordering_errors_;
+
+    /** Index of the node producing the latest version of each pipe. */
+    std::unordered_map<std::string, size_t> pipe_producers_;
+
+    /**
+     * Pipes which are used outside of the stages or from other frames.
+     * The final versions of these pipes are always kept.
+     */
+    std::unordered_set<std::string> external_pipes_;
+};
+
+// ************************************************************************************************
+
+inline auto StageGraph::get_nodes() const -> const std::vector<Node>&
+{
+    return nodes_;
+}
+
+inline auto StageGraph::get_ordering_errors() const -> const std::vector<OrderingError>&
+{
+    return ordering_errors_;
+}
+
+}
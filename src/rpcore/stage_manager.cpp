@@ -23,6 +23,7 @@
 #include "render_pipeline/rpcore/stage_manager.hpp"
 
 #include <regex>
+#include <unordered_set>
 
 #include <boost/algorithm/string.hpp>
 
@@ -38,6 +39,8 @@
 #include "render_pipeline/rpcore/render_pipeline.hpp"
 #include "render_pipeline/rpcore/render_stage.hpp"
 #include "render_pipeline/rpcore/util/shader_input_blocks.hpp"
+#include "render_pipeline/rpcore/util/frame_profiler.hpp"
+#include "rpcore/stage_graph.hpp"
 
 namespace rpcore {
 
@@ -49,8 +52,23 @@ public:
     /** Loads the order of all stages from the stages.yaml configuration file. */
     void load_stage_order();
 
+    /** Removes disabled stages and sorts the others by the order in stages.yaml. */
     void prepare_stages();
 
+    /**
+     * Adds a node of the given stage to the stage graph. The required pipes
+     * are resolved to the latest stage producing them, so this has to be
+     * called in the stage order and after creating the stage.
+     */
+    void add_stage_node(RenderStage* stage);
+
+    /**
+     * Validates the stage graph and finds the stages whose results are not
+     * used by any other stage. If @p cull_unused is true, those stages are
+     * deactivated.
+     */
+    void compile_stage_graph(bool cull_unused);
+
     /** Sets all required pipes on a stage. */
     bool bind_pipes_to_stage(RenderStage* stage);
 
@@ -98,9 +116,21 @@ public:
     std::vector<std::pair<std::string, RenderStage*>> future_bindings_;
     DefinesType defines_;
 
+    /** Profiler scope of each stage, registered on the first update. */
+    std::unordered_map<RenderStage*, size_t> stage_scopes_;
+
+    /** Defines written to the shader config at last. */
+    DefinesType autoconfig_defines_;
+
     std::shared_ptr<UpdatePreviousPipesStage> prev_stage_;
 
     std::vector<std::string> stage_order_;
+    std::unordered_map<std::string, size_t> stage_order_index_;
+
+    StageGraph stage_graph_;
+
+    /** Stage of each node in the stage graph. */
+    std::vector<RenderStage*> stage_nodes_;
 };
 
 StageManager::Impl::Impl(StageManager& self, RenderPipeline& pipeline): self_(self), pipeline_(pipeline)
@@ -121,9 +151,13 @@ void StageManager::Impl::load_stage_order()
 
     const size_t stage_count = orders["global_stage_order"].size();
     stage_order_.reserve(stage_count);
-    const std::regex double_colon_re("::");
+    stage_order_index_.reserve(stage_count);
     for (auto stage_id: orders["global_stage_order"])
+    {
         stage_order_.push_back(stage_id.as<std::string>());
+        if (!stage_order_index_.emplace(stage_order_.back(), stage_order_.size() - 1).second)
+            self_.warn(fmt::format("Stage {} is listed more than once in the stage order.", stage_order_.back()));
+    }
 }
 
 void StageManager::Impl::prepare_stages()
@@ -138,11 +172,76 @@ void StageManager::Impl::prepare_stages()
             enabled_stages.push_back(stage);
     }
 
-    stages_.swap(enabled_stages);
+    // add_stage() accepts only the stages in the stage order.
+    std::vector<std::pair<size_t, RenderStage*>> ordered_stages;
+    ordered_stages.reserve(enabled_stages.size());
+    for (auto&& stage: enabled_stages)
+        ordered_stages.emplace_back(stage_order_index_.at(stage->get_stage_id()), stage);
 
-    std::sort(stages_.begin(), stages_.end(), [this](RenderStage* lhs, RenderStage* rhs) {
-        return std::find(stage_order_.begin(), stage_order_.end(), lhs->get_stage_id()) < std::find(stage_order_.begin(), stage_order_.end(), rhs->get_stage_id());
+    std::stable_sort(ordered_stages.begin(), ordered_stages.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first < rhs.first;
     });
+
+    stages_.clear();
+    for (const auto& order_stage: ordered_stages)
+        stages_.push_back(order_stage.second);
+}
+
+void StageManager::Impl::add_stage_node(RenderStage* stage)
+{
+    // Input blocks are bound like pipes, but those may be produced by no stage.
+    std::vector<std::string> required_pipes;
+    std::vector<std::string> required_inputs = stage->get_required_inputs();
+    for (const auto& pipe: stage->get_required_pipes())
+    {
+        if (input_blocks_.find(pipe) == input_blocks_.end())
+            required_pipes.push_back(pipe);
+        else
+            required_inputs.push_back(pipe);
+    }
+
+    std::vector<std::string> produced_pipes;
+    for (const auto& pipe_data: stage->get_produced_pipes())
+    {
+        if (auto data = boost::get<ShaderInput>(&pipe_data))
+            produced_pipes.push_back(data->get_name()->get_name());
+        else if (auto data = boost::get<std::shared_ptr<SimpleInputBlock>>(&pipe_data))
+            produced_pipes.push_back((*data)->get_name());
+        else if (auto data = boost::get<std::shared_ptr<GroupedInputBlock>>(&pipe_data))
+            produced_pipes.push_back((*data)->get_name());
+    }
+
+    // Stages without pipes render for their side effects (ex, to the window) and
+    // the inputs are used globally, so we cannot decide whether those are used.
+    stage_graph_.add_stage(stage->get_stage_id(), required_pipes, required_inputs, produced_pipes,
+        !stage->get_produced_inputs().empty());
+    stage_nodes_.push_back(stage);
+}
+
+void StageManager::Impl::compile_stage_graph(bool cull_unused)
+{
+    stage_graph_.compile();
+
+    for (const auto& error: stage_graph_.get_ordering_errors())
+    {
+        self_.error(fmt::format("Stage {} requires pipe {}, but the pipe is produced by the later stage {}. "
+            "Check the order of the stages in stages.yaml.",
+            stage_nodes_[error.node]->get_debug_name(), error.pipe, stage_nodes_[error.producer]->get_debug_name()));
+    }
+
+    for (const auto index: stage_graph_.get_unused_nodes())
+    {
+        RenderStage* stage = stage_nodes_[index];
+        if (cull_unused)
+        {
+            self_.debug(fmt::format("Deactivating stage ({}), none of its pipes is used.", stage->get_debug_name()));
+            stage->set_active(false);
+        }
+        else
+        {
+            self_.debug(fmt::format("Stage ({}) is not used by any other stage.", stage->get_debug_name()));
+        }
+    }
 }
 
 bool StageManager::Impl::bind_pipes_to_stage(RenderStage* stage)
@@ -387,7 +486,7 @@ void StageManager::add_stage(RenderStage* stage)
 {
     trace(fmt::format("Adding stage ({}) ...", stage->get_debug_name()));
 
-    if (std::find(impl_->stage_order_.begin(), impl_->stage_order_.end(), stage->get_stage_id()) == std::end(impl_->stage_order_))
+    if (impl_->stage_order_index_.find(stage->get_stage_id()) == impl_->stage_order_index_.end())
     {
         error(fmt::format("The stage type {} is not registered yet! Please add it to the StageManager!", stage->get_debug_name()));
         return;
@@ -444,6 +543,8 @@ void StageManager::setup()
         trace(fmt::format("Stage ({}) handles window re-sizing.", stage->get_debug_name()));
         stage->handle_window_resize();
 
+        impl_->add_stage_node(stage);
+
         // Rely on the methods to print an appropriate error message
         if (!impl_->bind_pipes_to_stage(stage))
             continue;
@@ -453,6 +554,8 @@ void StageManager::setup()
         impl_->register_stage_result(stage);
     }
 
+    impl_->compile_stage_graph(impl_->pipeline_.get_setting<bool>("pipeline.cull_unused_stages", false));
+
     impl_->create_previous_pipes();
     impl_->apply_future_bindings();
 }
@@ -466,10 +569,29 @@ void StageManager::reload_shaders()
 
 void StageManager::update()
 {
+    FrameProfiler* profiler = impl_->pipeline_.get_profiler();
+    if (!profiler->is_enabled())
+    {
+        for (const auto& stage: impl_->stages_)
+        {
+            if (stage->get_active())
+                stage->update();
+        }
+        return;
+    }
+
+    FrameProfiler::Scope stages_scope(profiler, profiler->register_scope("Stages"));
     for (const auto& stage: impl_->stages_)
     {
-        if (stage->get_active())
-            stage->update();
+        if (!stage->get_active())
+            continue;
+
+        auto found = impl_->stage_scopes_.find(stage);
+        if (found == impl_->stage_scopes_.end())
+            found = impl_->stage_scopes_.emplace(stage, profiler->register_scope("Stages:" + stage->get_stage_id())).first;
+
+        FrameProfiler::Scope scope(profiler, found->second);
+        stage->update();
     }
 }
 
@@ -494,6 +616,7 @@ void StageManager::write_autoconfig()
     try
     {
         (*rppanda::open_write_file("/$$rptemp/$$pipeline_shader_config.inc.glsl", false, true)) << output;
+        impl_->autoconfig_defines_ = impl_->defines_;
     }
     catch (const std::exception& err)
     {
@@ -501,4 +624,23 @@ void StageManager::write_autoconfig()
     }
 }
 
+std::unordered_set<std::string> StageManager::get_changed_defines() const
+{
+    std::unordered_set<std::string> changed_defines;
+    for (const auto& key_val: impl_->defines_)
+    {
+        auto found = impl_->autoconfig_defines_.find(key_val.first);
+        if (found == impl_->autoconfig_defines_.end() || found->second != key_val.second)
+            changed_defines.insert(key_val.first);
+    }
+
+    for (const auto& key_val: impl_->autoconfig_defines_)
+    {
+        if (impl_->defines_.find(key_val.first) == impl_->defines_.end())
+            changed_defines.insert(key_val.first);
+    }
+
+    return changed_defines;
+}
+
 }
@@ -0,0 +1,184 @@
+/**
+ * Render Pipeline C++
+ *
+ * Copyright (c) 2016-2017 Center of Human-centered Interaction for Coexistence.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "render_pipeline/rpcore/util/frame_profiler.hpp"
+
+#include <filename.h>
+
+#include <algorithm>
+
+#include <fmt/format.h>
+
+#include "render_pipeline/rppanda/stdpy/file.hpp"
+
+namespace rpcore {
+
+static std::string escape_json_string(const std::string& str)
+{
+    std::string result;
+    result.reserve(str.size());
+    for (const char c: str)
+    {
+        switch (c)
+        {
+        case '"':
+            result += "\\\"";
+            break;
+        case '\\':
+            result += "\\\\";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+                result += fmt::format("\\u{:04x}", static_cast<int>(c));
+            else
+                result += c;
+            break;
+        }
+    }
+    return result;
+}
+
+FrameProfiler::FrameProfiler(size_t num_frames): RPObject("FrameProfiler"), num_frames_(num_frames)
+{
+    epoch_ = std::chrono::steady_clock::now();
+    frame_events_.resize(num_frames_);
+}
+
+size_t FrameProfiler::register_scope(const std::string& name)
+{
+    const auto found = scope_ids_.find(name);
+    if (found != scope_ids_.end())
+        return found->second;
+
+    const size_t scope_id = scopes_.size();
+    scopes_.push_back(ScopeData{name, PStatCollector("App:Show code:RP:" + name), std::vector<double>(num_frames_, -1.0)});
+    scope_ids_.emplace(name, scope_id);
+    return scope_id;
+}
+
+void FrameProfiler::begin_frame()
+{
+    if (!is_enabled())
+        return;
+
+    current_frame_ = (current_frame_ + 1) % num_frames_;
+    frame_events_[current_frame_].clear();
+    for (auto& scope: scopes_)
+        scope.frame_ms[current_frame_] = -1.0;
+}
+
+std::vector<std::string> FrameProfiler::get_scope_names() const
+{
+    std::vector<std::string> names;
+    names.reserve(scopes_.size());
+    for (const auto& scope: scopes_)
+        names.push_back(scope.name);
+    return names;
+}
+
+FrameProfiler::Stats FrameProfiler::get_stats(const std::string& name) const
+{
+    Stats stats;
+
+    const auto found = scope_ids_.find(name);
+    if (found == scope_ids_.end())
+        return stats;
+
+    std::vector<double> samples;
+    samples.reserve(num_frames_);
+    const auto& frame_ms = scopes_[found->second].frame_ms;
+    for (size_t k = 0; k < num_frames_; ++k)
+    {
+        if (k != current_frame_ && frame_ms[k] >= 0)
+            samples.push_back(frame_ms[k]);
+    }
+
+    if (samples.empty())
+        return stats;
+
+    std::sort(samples.begin(), samples.end());
+
+    double sum = 0;
+    for (const double ms: samples)
+        sum += ms;
+
+    stats.min_ms = samples.front();
+    stats.max_ms = samples.back();
+    stats.avg_ms = sum / samples.size();
+    stats.p99_ms = samples[(std::min)(samples.size() - 1, samples.size() * 99 / 100)];
+    stats.num_frames = samples.size();
+
+    return stats;
+}
+
+bool FrameProfiler::export_chrome_trace(const Filename& path) const
+{
+    auto file = rppanda::open_write_file(path, false, true);
+    if (!file)
+    {
+        error(fmt::format("Failed to open {} to export the trace.", path.get_fullpath()));
+        return false;
+    }
+
+    *file << "{\"traceEvents\":[";
+
+    bool first = true;
+
+    // write from the oldest frame
+    for (size_t k = 1; k <= num_frames_; ++k)
+    {
+        for (const auto& ev: frame_events_[(current_frame_ + k) % num_frames_])
+        {
+            if (!first)
+                *file << ",";
+            first = false;
+
+            *file << fmt::format("\n{{\"name\":\"{}\",\"cat\":\"rpcore\",\"ph\":\"X\",\"ts\":{},\"dur\":{},\"pid\":0,\"tid\":0}}",
+                escape_json_string(scopes_[ev.scope_id].name), ev.start_us, ev.duration_us);
+        }
+    }
+
+    *file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    if (file->fail())
+    {
+        error(fmt::format("Failed to write the trace to {}.", path.get_fullpath()));
+        return false;
+    }
+
+    debug(fmt::format("Exported the trace to {}.", path.get_fullpath()));
+    return true;
+}
+
+void FrameProfiler::record(size_t scope_id, std::chrono::steady_clock::time_point start_time, std::chrono::steady_clock::time_point end_time)
+{
+    const auto duration = end_time - start_time;
+
+    double& frame_ms = scopes_[scope_id].frame_ms[current_frame_];
+    frame_ms = (std::max)(frame_ms, 0.0) + std::chrono::duration<double, std::milli>(duration).count();
+
+    frame_events_[current_frame_].push_back(Event{
+        scope_id,
+        std::chrono::duration_cast<std::chrono::microseconds>(start_time - epoch_).count(),
+        std::chrono::duration_cast<std::chrono::microseconds>(duration).count()});
+}
+
+}
@@ -22,11 +22,27 @@
 
 #include "rpcore/util/ies_profile_loader.hpp"
 
+#include <algorithm>
+#include <sstream>
+
 #include <shaderInput.h>
+#include <pnmImage.h>
+#include <virtualFileSystem.h>
+#include <virtualFileList.h>
+#include <config_putil.h>
+
+#include <boost/algorithm/string.hpp>
 
+#include <fmt/format.h>
+
+#include "render_pipeline/rppanda/stdpy/file.hpp"
 #include "render_pipeline/rpcore/render_pipeline.hpp"
 #include "render_pipeline/rpcore/stage_manager.hpp"
 #include "render_pipeline/rpcore/image.hpp"
+#include "render_pipeline/rpcore/mount_manager.hpp"
+#include "render_pipeline/rpcore/native/ies_dataset.h"
+
+#include "render_pipeline/rplibs/hash.hpp"
 
 namespace rpcore {
 
@@ -40,12 +56,296 @@ const std::vector<std::string> IESProfileLoader::PROFILES = {
     "ERCO Leuchten GmbH"
 };
 
+constexpr const char* IESProfileLoader::cache_dir_;
+
+/** Increase this when the format of the cache or the baked LUT changes. */
+static const uint64_t ies_cache_version = 1;
+
 IESProfileLoader::~IESProfileLoader() = default;
 
 size_t IESProfileLoader::load(const Filename& filename)
 {
-    // TODO: implement
-    return 0;
+    const size_t invalid_index = static_cast<size_t>(-1);
+
+    // Make filename unique
+    VirtualFileSystem* vfs = VirtualFileSystem::get_global_ptr();
+    Filename fname(filename);
+    if (!vfs->resolve_filename(fname, get_model_path().get_value(), "ies"))
+    {
+        error(fmt::format("Could not resolve {}", filename.to_os_specific()));
+        return invalid_index;
+    }
+
+    // Check for cache entries
+    auto found = std::find(entries_.begin(), entries_.end(), fname.get_fullpath());
+    if (found != entries_.end())
+        return std::distance(entries_.begin(), found);
+
+    // Check for out of bounds
+    if (entries_.size() >= static_cast<size_t>(max_entries_))
+    {
+        error(fmt::format("Cannot load IES Profile, too many loaded! (Maximum: {})", max_entries_));
+        return invalid_index;
+    }
+
+    std::string content;
+    if (!vfs->read_file(fname, content, true))
+    {
+        error(fmt::format("Could not read {}", fname.to_os_specific()));
+        return invalid_index;
+    }
+
+    Texture* storage = storage_tex_->get_texture();
+
+    // Candela values are stored flipped, see IESDataset::generate_dataset_texture_into
+    PNMImage lut(storage->get_y_size(), storage->get_x_size(), 1, 65535);
+
+    rplibs::FNV1aHash hash;
+    hash.update(ies_cache_version);
+    hash.update(content);
+    hash.update(static_cast<uint64_t>(lut.get_x_size()));
+    hash.update(static_cast<uint64_t>(lut.get_y_size()));
+
+    // The entries of a profile file share the prefix up to the last '-',
+    // which is used to remove the entries of older versions of the file.
+    const Filename cache_path = fmt::format("{}/{}-{:x}-{:016x}.bin", cache_dir_, fname.get_basename_wo_extension(),
+        fname.get_hash(), hash.get_digest());
+
+    // On the ramdisk, the cache would be lost at the exit anyway.
+    const bool use_cache = MountManager::is_write_path_persistent();
+    if (!use_cache || !read_cache(cache_path, lut))
+    {
+        if (!bake_profile(fname, content, lut))
+            return invalid_index;
+        if (use_cache)
+            write_cache(cache_path, lut);
+    }
+
+    // Dataset was loaded successfully, now copy it
+    storage->load(lut, static_cast<int>(entries_.size()), 0);
+    entries_.push_back(fname.get_fullpath());
+    return entries_.size() - 1;
+}
+
+bool IESProfileLoader::bake_profile(const Filename& filename, const std::string& content, PNMImage& lut) const
+{
+    std::vector<std::string> lines;
+    boost::split(lines, content, boost::is_any_of("\n"));
+    for (auto& line: lines)
+        boost::trim(line);
+
+    // Parse version header
+    if (lines.empty() || std::find(PROFILES.begin(), PROFILES.end(), lines[0]) == PROFILES.end())
+    {
+        warn(fmt::format("Failed to load profile from {}: Unsupported Profile: {}", filename.to_os_specific(), lines.empty() ? "" : lines[0]));
+        return false;
+    }
+
+    // Parse arbitrary amount of keywords, the next line should be TILT=NONE
+    // according to the spec
+    size_t line_index = 1;
+    for (; line_index < lines.size(); ++line_index)
+    {
+        const auto& line = lines[line_index];
+        if (line.empty() || line[0] != '[')
+        {
+            if (line == "TILT=NONE")
+                break;
+            continue;
+        }
+
+        const size_t close = line.find(']');
+        if (close == std::string::npos || close == 1)
+        {
+            warn(fmt::format("Failed to load profile from {}: Invalid keyword line: {}", filename.to_os_specific(), line));
+            return false;
+        }
+    }
+
+    if (line_index >= lines.size())
+    {
+        warn(fmt::format("Failed to load profile from {}: Expected TILT=NONE line, but none found!", filename.to_os_specific()));
+        return false;
+    }
+
+    // From now on, lines do not matter anymore, instead everything is
+    // space seperated
+    std::string data = boost::join(boost::make_iterator_range(lines.begin() + line_index + 1, lines.end()), " ");
+    std::replace(data.begin(), data.end(), ',', ' ');
+    std::istringstream parts(data);
+
+    auto read_int = [&parts]() {
+        int value;
+        if (!(parts >> value))
+            throw std::runtime_error("Unexpected end of data");
+        return value;
+    };
+    auto read_float = [&parts]() {
+        float value;
+        if (!(parts >> value))
+            throw std::runtime_error("Unexpected end of data");
+        return value;
+    };
+
+    IESDataset dataset;
+    try
+    {
+        // Amount of Lamps
+        if (read_int() != 1)
+            throw std::runtime_error("Only 1 Lamp supported!");
+
+        // Extract various properties
+        read_float();   // lumen per lamp
+        read_float();   // candela multiplier
+        const int num_vertical_angles = read_int();
+        const int num_horizontal_angles = read_int();
+        if (num_vertical_angles < 1 || num_horizontal_angles < 1)
+            throw std::runtime_error("Invalid of vertical/horizontal angles!");
+
+        read_int();     // photometric type
+
+        // Check for a correct unit type, should be 1 for meters and 2 for feet
+        const int unit_type = read_int();
+        if (unit_type != 1 && unit_type != 2)
+            throw std::runtime_error("Invalid unit type");
+
+        // width, length, height, ballast factor, future use, input watts
+        for (int k = 0; k < 6; ++k)
+            read_float();
+
+        PTA_float vertical_angles = PTA_float::empty_array(num_vertical_angles);
+        for (int k = 0; k < num_vertical_angles; ++k)
+            vertical_angles[k] = read_float();
+
+        PTA_float horizontal_angles = PTA_float::empty_array(num_horizontal_angles);
+        for (int k = 0; k < num_horizontal_angles; ++k)
+            horizontal_angles[k] = read_float();
+
+        PTA_float candela_values = PTA_float::empty_array(num_vertical_angles * num_horizontal_angles);
+        float candela_scale = 0.0f;
+        for (size_t k = 0, k_end = candela_values.size(); k < k_end; ++k)
+        {
+            candela_values[k] = read_float();
+            candela_scale = (std::max)(candela_scale, candela_values[k]);
+        }
+
+        if (candela_scale <= 0.0f)
+            throw std::runtime_error("All candela values are zero!");
+
+        // Rescale values, divide by maximum
+        for (auto& value: candela_values)
+            value /= candela_scale;
+
+        // Dont abort on data left at the file end, some formats like those
+        // from ERCO Leuchten GmbH have an END keyword.
+        std::string rest;
+        if (parts >> rest)
+            warn(fmt::format("Unhandled data at file-end left in {}", filename.to_os_specific()));
+
+        dataset.set_vertical_angles(vertical_angles);
+        dataset.set_horizontal_angles(horizontal_angles);
+        dataset.set_candela_values(candela_values);
+    }
+    catch (const std::exception& err)
+    {
+        warn(fmt::format("Failed to load profile from {}: {}", filename.to_os_specific(), err.what()));
+        return false;
+    }
+
+    dataset.generate_dataset_image(lut);
+    return true;
+}
+
+bool IESProfileLoader::read_cache(const Filename& cache_path, PNMImage& lut) const
+{
+    VirtualFileSystem* vfs = VirtualFileSystem::get_global_ptr();
+
+    std::string data;
+    const int x_size = lut.get_x_size();
+    const int y_size = lut.get_y_size();
+    if (!vfs->exists(cache_path) || !vfs->read_file(cache_path, data, true) || data.size() != size_t(x_size) * y_size * 2)
+        return false;
+
+    // 16-bit values in little endian, row by row
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data.data());
+    for (int y = 0; y < y_size; ++y)
+    {
+        for (int x = 0; x < x_size; ++x, bytes += 2)
+            lut.set_gray_val(x, y, static_cast<xelval>(bytes[0] | (bytes[1] << 8)));
+    }
+
+    return true;
+}
+
+void IESProfileLoader::write_cache(const Filename& cache_path, const PNMImage& lut) const
+{
+    const int x_size = lut.get_x_size();
+    const int y_size = lut.get_y_size();
+
+    std::string data;
+    data.reserve(size_t(x_size) * y_size * 2);
+    for (int y = 0; y < y_size; ++y)
+    {
+        for (int x = 0; x < x_size; ++x)
+        {
+            const xelval value = lut.get_gray_val(x, y);
+            data.push_back(static_cast<char>(value & 0xFF));
+            data.push_back(static_cast<char>((value >> 8) & 0xFF));
+        }
+    }
+
+    // Write to a temporary file first, so that an interrupted write does not
+    // leave a broken cache.
+    const Filename temp_path = Filename::binary_filename(cache_path.get_fullpath() + ".tmp");
+    try
+    {
+        VirtualFileSystem* vfs = VirtualFileSystem::get_global_ptr();
+        vfs->make_directory_full(cache_dir_);
+        {
+            auto file = rppanda::open_write_file(temp_path, false, true);
+            if (!file)
+                throw std::runtime_error("Failed to open " + temp_path.get_fullpath());
+            file->write(data.data(), data.size());
+            file->flush();
+            if (file->fail())
+                throw std::runtime_error("Failed to write " + temp_path.get_fullpath());
+        }
+
+        vfs->delete_file(cache_path);
+        if (!vfs->rename_file(temp_path, cache_path))
+            throw std::runtime_error("Failed to rename " + temp_path.get_fullpath());
+    }
+    catch (const std::exception& err)
+    {
+        warn(fmt::format("Error writing IES cache: {}", err.what()));
+        return;
+    }
+
+    remove_stale_cache(cache_path);
+}
+
+void IESProfileLoader::remove_stale_cache(const Filename& cache_path) const
+{
+    VirtualFileSystem* vfs = VirtualFileSystem::get_global_ptr();
+
+    PT(VirtualFileList) file_list = vfs->scan_directory(cache_dir_);
+    if (!file_list)
+        return;
+
+    const std::string& fullpath = cache_path.get_fullpath();
+    const size_t prefix_length = fullpath.rfind('-') + 1;
+
+    for (size_t k = 0, k_end = file_list->get_num_files(); k < k_end; ++k)
+    {
+        const Filename& path = file_list->get_file(k)->get_filename();
+        const std::string& other_path = path.get_fullpath();
+        if (other_path != fullpath && other_path.size() > prefix_length &&
+            other_path.compare(0, prefix_length, fullpath, 0, prefix_length) == 0)
+        {
+            debug(fmt::format("Removing stale IES cache {}", other_path));
+            vfs->delete_file(path);
+        }
+    }
 }
 
 void IESProfileLoader::create_storage()
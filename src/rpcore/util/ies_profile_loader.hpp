@@ -22,12 +22,14 @@
 
 #pragma once
 
+#include <string>
 #include <vector>
 #include <memory>
 
 #include <render_pipeline/rpcore/rpobject.hpp>
 
 class Filename;
+class PNMImage;
 
 namespace rpcore {
 
@@ -50,17 +52,34 @@ public:
 
     /**
      * Loads a profile from a given filename and returns the internal
-     * used index which can be assigned to a light.
+     * used index which can be assigned to a light. If the profile could not
+     * be loaded, this returns size_t(-1), which is -1 as the profile of a light.
+     *
+     * The baked LUT of each profile is cached in the write path, and the
+     * profile is parsed and baked again only if the file changed. The entry
+     * of the previous version is removed then.
      */
     size_t load(const Filename& filename);
 
 private:
+    static constexpr const char* cache_dir_ = "/$$rptemp/ies_cache";
+
     /** Internal method to create the storage for the profile dataset textures. */
     void create_storage();
 
+    /** Parses the IES file, and generates the LUT into @p lut. */
+    bool bake_profile(const Filename& filename, const std::string& content, PNMImage& lut) const;
+
+    bool read_cache(const Filename& cache_path, PNMImage& lut) const;
+    void write_cache(const Filename& cache_path, const PNMImage& lut) const;
+
+    /** Removes the cache entries of older versions of the profile of the given entry. */
+    void remove_stale_cache(const Filename& cache_path) const;
+
     RenderPipeline& pipeline_;
     int max_entries_ = 32;
     std::unique_ptr<Image> storage_tex_;
+    std::vector<std::string> entries_;
 };
 
 inline IESProfileLoader::IESProfileLoader(RenderPipeline& pipeline): RPObject("IESProfileLoader"), pipeline_(pipeline)
@@ -21,20 +21,40 @@
 
 #include "render_pipeline/rpcore/util/instancing_node.hpp"
 
+#include <limits>
+
 #include <omniBoundingVolume.h>
+#include <boundingBox.h>
+#include <boundingSphere.h>
+#include <boundingHexahedron.h>
+#include <camera.h>
+#include <lens.h>
 
 #include "render_pipeline/rpcore/render_pipeline.hpp"
+#include "render_pipeline/rpcore/globals.hpp"
+#include "render_pipeline/rppanda/showbase/showbase.hpp"
+#include "render_pipeline/rppanda/task/task_manager.hpp"
+
+#include "render_pipeline/rplibs/thread_pool.hpp"
 
 namespace rpcore {
 
 static_assert(std::is_standard_layout<LMatrix4f>::value, "std::is_standard_layout<LMatrix4f>::value");
 static_assert(sizeof(LMatrix4f) == sizeof(float)*16, "sizeof(LMatrix4f) == sizeof(float)*16");
 
+/** Count of instances processed by one job of the thread pool. */
+static constexpr size_t INSTANCE_CHUNK_SIZE = 4096;
+
 class InstancingNode::Impl
 {
 public:
+    ~Impl();
+
     void initilize(RenderPipeline& pipeline, NodePath np, const Filename& effect_path, GeomEnums::UsageHint buffer_hint);
 
+    /** Extends the range of the transforms to upload. */
+    void mark_dirty(size_t begin, size_t end);
+
     void set_instance_count(int instance_count);
 
     void set_transform(const LMatrix4f& transform, int instance_index);
@@ -42,13 +62,55 @@ public:
 
     void upload_transforms();
 
+    /** Updates the bounding spheres of the dirty instances and the bounds of the instanced node. */
+    void update_bounds();
+
+    /**
+     * Resizes the buffer texture to hold @p instance_count instances. The capacity grows geometrically,
+     * and returns true if the texture is resized, which clears its RAM image.
+     */
+    bool reserve_buffer(size_t instance_count);
+
+    void set_culling(bool enable, const NodePath& camera);
+
+    /** Culls the instances by the camera frustum and uploads the visible instances. */
+    AsyncTask::DoneStatus cull_instances();
+
 public:
-    bool dirty_ = true;
     NodePath instanced_np_;
     std::vector<LMatrix4f> transforms_;
     PT(Texture) buffer_texture_;
+    size_t buffer_capacity_ = 1;
+
+    /** Range of the transforms changed after the last upload. */
+    size_t dirty_begin_ = 0;
+    size_t dirty_end_ = 0;
+
+    /** Bounding sphere of the children in the space of the instanced node. */
+    LPoint3f geom_center_ = LPoint3f(0);
+    float geom_radius_ = 0;
+    bool has_geom_bounds_ = false;
+
+    /** Bounding spheres of the uploaded instances, stored per component for vectorized culling. */
+    std::vector<float> sphere_x_;
+    std::vector<float> sphere_y_;
+    std::vector<float> sphere_z_;
+    std::vector<float> sphere_radius_;
+
+    PT(AsyncTask) culling_task_;
+    NodePath culling_camera_;
+    bool transforms_changed_ = false;
+    std::vector<uint32_t> visible_indices_;
+    std::vector<uint32_t> culled_indices_;
+    std::vector<size_t> chunk_counts_;
 };
 
+InstancingNode::Impl::~Impl()
+{
+    if (culling_task_)
+        culling_task_->remove();
+}
+
 void InstancingNode::Impl::initilize(RenderPipeline& pipeline, NodePath np, const Filename& effect_path, GeomEnums::UsageHint buffer_hint)
 {
     instanced_np_ = np;
@@ -56,7 +118,7 @@ void InstancingNode::Impl::initilize(RenderPipeline& pipeline, NodePath np, cons
     // Allocate storage for the matrices, each matrix has 16 elements,
     // but because one pixel has four components, we need amount * 4 pixels.
     buffer_texture_ = Texture::make_texture();
-    buffer_texture_->setup_buffer_texture(4, Texture::T_float, Texture::F_rgba32, buffer_hint);
+    buffer_texture_->setup_buffer_texture(buffer_capacity_ * 4, Texture::T_float, Texture::F_rgba32, buffer_hint);
 
     // Load the effect
     Filename epath = effect_path;
@@ -68,48 +130,317 @@ void InstancingNode::Impl::initilize(RenderPipeline& pipeline, NodePath np, cons
     instanced_np_.set_shader_input("InstancingData", buffer_texture_);
     instanced_np_.set_shader_input("instanceNode", instanced_np_);
 
-    // We have do disable culling, so that all instances stay visible
-    instanced_np_.node()->set_bounds(new OmniBoundingVolume);
-    instanced_np_.node()->set_final(true);
+    // The bounds of the children are used for the bounds of each instance.
+    PandaNode* node = instanced_np_.node();
+    node->clear_bounds();
+    CPT(BoundingVolume) bounds = node->get_bounds();
+    if (const GeometricBoundingVolume* gbv = bounds->as_geometric_bounding_volume())
+    {
+        BoundingSphere sphere;
+        sphere.around(&gbv, &gbv + 1);
+        if (!sphere.is_empty() && !sphere.is_infinite())
+        {
+            const LPoint3& center = sphere.get_center();
+            geom_center_ = LPoint3f(center[0], center[1], center[2]);
+            geom_radius_ = static_cast<float>(sphere.get_radius());
+            has_geom_bounds_ = true;
+        }
+    }
+
+    // Without the bounds of the children, we have do disable culling, so that all instances stay visible.
+    // Otherwise, the bounds are set on upload.
+    node->set_bounds(has_geom_bounds_ ? static_cast<BoundingVolume*>(new BoundingBox) : new OmniBoundingVolume);
+    node->set_final(true);
+}
+
+void InstancingNode::Impl::mark_dirty(size_t begin, size_t end)
+{
+    if (dirty_begin_ >= dirty_end_)
+    {
+        dirty_begin_ = begin;
+        dirty_end_ = end;
+    }
+    else
+    {
+        dirty_begin_ = (std::min)(dirty_begin_, begin);
+        dirty_end_ = (std::max)(dirty_end_, end);
+    }
 }
 
 void InstancingNode::Impl::set_instance_count(int instance_count)
 {
-    dirty_ = true;
+    const size_t old_count = transforms_.size();
     transforms_.resize(instance_count);
+    if (transforms_.size() > old_count)
+        mark_dirty(old_count, transforms_.size());
 }
 
 void InstancingNode::Impl::set_transform(const LMatrix4f& transform, int instance_index)
 {
-    dirty_ = true;
+    mark_dirty(instance_index, instance_index + 1);
     transforms_[instance_index] = transform;
 }
 
 void InstancingNode::Impl::set_transforms(const std::vector<LMatrix4f>& transforms)
 {
-    dirty_ = true;
+    mark_dirty(0, transforms.size());
     transforms_ = transforms;
 }
 
 void InstancingNode::Impl::upload_transforms()
 {
-    if (!dirty_)
+    const size_t instance_count = transforms_.size();
+    if (dirty_begin_ >= dirty_end_ && instance_count == sphere_x_.size())
+        return;
+
+    update_bounds();
+
+    if (culling_task_)
+    {
+        // the culling task uploads the visible instances
+        reserve_buffer(instance_count);
+        transforms_changed_ = true;
+    }
+    else
+    {
+        size_t begin = (std::min)(dirty_begin_, instance_count);
+        size_t end = (std::min)(dirty_end_, instance_count);
+        if (reserve_buffer(instance_count))
+        {
+            begin = 0;
+            end = instance_count;
+        }
+
+        if (instanced_np_.get_instance_count() != static_cast<int>(instance_count))
+            instanced_np_.set_instance_count(static_cast<int>(instance_count));
+
+        if (begin < end)
+        {
+            auto ram_image = buffer_texture_->modify_ram_image();
+            std::memcpy(ram_image.p() + begin * sizeof(LMatrix4f), &transforms_[begin], (end - begin) * sizeof(LMatrix4f));
+        }
+    }
+
+    dirty_begin_ = 0;
+    dirty_end_ = 0;
+}
+
+void InstancingNode::Impl::update_bounds()
+{
+    const size_t instance_count = transforms_.size();
+    size_t begin = (std::min)(dirty_begin_, instance_count);
+    const size_t end = (std::min)(dirty_end_, instance_count);
+    if (sphere_x_.size() != instance_count)
+    {
+        begin = (std::min)(begin, sphere_x_.size());
+        sphere_x_.resize(instance_count);
+        sphere_y_.resize(instance_count);
+        sphere_z_.resize(instance_count);
+        sphere_radius_.resize(instance_count);
+    }
+
+    if (!has_geom_bounds_)
+        return;
+
+    if (begin < end)
+    {
+        rplibs::ThreadPool::get_global_pool().parallel_for(end - begin, INSTANCE_CHUNK_SIZE, [&](size_t chunk_begin, size_t chunk_end) {
+            for (size_t k = begin + chunk_begin, k_end = begin + chunk_end; k < k_end; ++k)
+            {
+                const LMatrix4f& mat = transforms_[k];
+                const LPoint3f center = mat.xform_point(geom_center_);
+                const float scale_squared = (std::max)({
+                    mat.get_row3(0).length_squared(),
+                    mat.get_row3(1).length_squared(),
+                    mat.get_row3(2).length_squared() });
+
+                sphere_x_[k] = center[0];
+                sphere_y_[k] = center[1];
+                sphere_z_[k] = center[2];
+                sphere_radius_[k] = geom_radius_ * std::sqrt(scale_squared);
+            }
+        });
+    }
+
+    if (instance_count == 0)
+    {
+        instanced_np_.node()->set_bounds(new BoundingBox);
+        return;
+    }
+
+    LPoint3f bounds_min((std::numeric_limits<float>::max)());
+    LPoint3f bounds_max(std::numeric_limits<float>::lowest());
+    for (size_t k = 0; k < instance_count; ++k)
+    {
+        const float radius = sphere_radius_[k];
+        bounds_min[0] = (std::min)(bounds_min[0], sphere_x_[k] - radius);
+        bounds_min[1] = (std::min)(bounds_min[1], sphere_y_[k] - radius);
+        bounds_min[2] = (std::min)(bounds_min[2], sphere_z_[k] - radius);
+        bounds_max[0] = (std::max)(bounds_max[0], sphere_x_[k] + radius);
+        bounds_max[1] = (std::max)(bounds_max[1], sphere_y_[k] + radius);
+        bounds_max[2] = (std::max)(bounds_max[2], sphere_z_[k] + radius);
+    }
+
+    instanced_np_.node()->set_bounds(new BoundingBox(
+        LPoint3(bounds_min[0], bounds_min[1], bounds_min[2]),
+        LPoint3(bounds_max[0], bounds_max[1], bounds_max[2])));
+}
+
+bool InstancingNode::Impl::reserve_buffer(size_t instance_count)
+{
+    if (instance_count > buffer_capacity_)
+        buffer_capacity_ = (std::max)(instance_count, buffer_capacity_ * 2);
+    else if (instance_count < buffer_capacity_ / 4)
+        buffer_capacity_ = (std::max)(instance_count, size_t(1));
+    else
+        return false;
+
+    // Allocate storage for the matrices, each matrix has 16 elements,
+    // but because one pixel has four components, we need amount * 4 pixels.
+    buffer_texture_->set_x_size(static_cast<int>(buffer_capacity_ * 4));
+
+    return true;
+}
+
+void InstancingNode::Impl::set_culling(bool enable, const NodePath& camera)
+{
+    culling_camera_ = camera;
+
+    if (enable == (culling_task_ != nullptr))
         return;
 
-    const int instance_count = static_cast<int>(transforms_.size());
-    if (instanced_np_.get_instance_count() != instance_count)
+    if (enable)
     {
-        instanced_np_.set_instance_count(instance_count);
+        if (!Globals::base)
+        {
+            RPObject::global_error("InstancingNode", "Culling of instances requires ShowBase.");
+            return;
+        }
+
+        transforms_changed_ = true;
+        culling_task_ = Globals::base->add_task([this](rppanda::FunctionalTask*) {
+            return cull_instances();
+        }, "RP_CullInstancingNode", 40);
+    }
+    else
+    {
+        culling_task_->remove();
+        culling_task_.clear();
+        visible_indices_.clear();
 
-        // Allocate storage for the matrices, each matrix has 16 elements,
-        // but because one pixel has four components, we need amount * 4 pixels.
-        buffer_texture_->set_x_size(instance_count * 4);
+        // restore all instances in the buffer
+        mark_dirty(0, transforms_.size());
+        upload_transforms();
     }
+}
+
+AsyncTask::DoneStatus InstancingNode::Impl::cull_instances()
+{
+    // Only the uploaded instances are culled. The instances can be removed
+    // before the next upload, so those are skipped, too.
+    const size_t instance_count = (std::min)(sphere_x_.size(), transforms_.size());
+
+    const NodePath camera = culling_camera_.is_empty() ? Globals::base->get_cam() : culling_camera_;
+    Camera* camera_node = DCAST(Camera, camera.node());
+    Lens* lens = camera_node ? camera_node->get_lens() : nullptr;
+    PT(BoundingVolume) frustum;
+    if (lens)
+        frustum = lens->make_bounds();
+
+    culled_indices_.resize(instance_count);
+    if (!has_geom_bounds_ || !frustum || !frustum->is_of_type(BoundingHexahedron::get_class_type()))
+    {
+        // cannot be culled, so all instances are visible
+        for (size_t k = 0; k < instance_count; ++k)
+            culled_indices_[k] = static_cast<uint32_t>(k);
+    }
+    else
+    {
+        BoundingHexahedron* hexahedron = DCAST(BoundingHexahedron, frustum);
+        hexahedron->xform(camera.get_mat(instanced_np_));
+
+        // The normals of the frustum planes point outward, so a sphere is
+        // outside if its distance to any plane is greater than its radius.
+        float planes[6][4];
+        for (int p = 0; p < 6; ++p)
+        {
+            const LPlane& plane = hexahedron->get_plane(p);
+            for (int c = 0; c < 4; ++c)
+                planes[p][c] = static_cast<float>(plane[c]);
+        }
+
+        const size_t num_chunks = (instance_count + INSTANCE_CHUNK_SIZE - 1) / INSTANCE_CHUNK_SIZE;
+        chunk_counts_.assign(num_chunks, 0);
+
+        // Each chunk writes the indices of its visible instances from its beginning,
+        // and then the chunks are compacted.
+        rplibs::ThreadPool::get_global_pool().parallel_for(num_chunks, 1, [&](size_t chunk_begin, size_t chunk_end) {
+            const float* sphere_x = sphere_x_.data();
+            const float* sphere_y = sphere_y_.data();
+            const float* sphere_z = sphere_z_.data();
+            const float* sphere_radius = sphere_radius_.data();
+            for (size_t chunk = chunk_begin; chunk < chunk_end; ++chunk)
+            {
+                const size_t begin = chunk * INSTANCE_CHUNK_SIZE;
+                const size_t end = (std::min)(begin + INSTANCE_CHUNK_SIZE, instance_count);
+                uint32_t* indices = culled_indices_.data() + begin;
+                size_t visible_count = 0;
+                for (size_t k = begin; k < end; ++k)
+                {
+                    bool visible = true;
+                    for (int p = 0; p < 6; ++p)
+                        visible &= planes[p][0] * sphere_x[k] + planes[p][1] * sphere_y[k] + planes[p][2] * sphere_z[k] + planes[p][3] <= sphere_radius[k];
+
+                    // branchless compaction
+                    indices[visible_count] = static_cast<uint32_t>(k);
+                    visible_count += visible;
+                }
+                chunk_counts_[chunk] = visible_count;
+            }
+        });
+
+        size_t visible_count = 0;
+        for (size_t chunk = 0; chunk < num_chunks; ++chunk)
+        {
+            const size_t begin = chunk * INSTANCE_CHUNK_SIZE;
+            if (visible_count != begin)
+                std::memmove(culled_indices_.data() + visible_count, culled_indices_.data() + begin, chunk_counts_[chunk] * sizeof(uint32_t));
+            visible_count += chunk_counts_[chunk];
+        }
+        culled_indices_.resize(visible_count);
+    }
+
+    if (!transforms_changed_ && culled_indices_ == visible_indices_)
+        return AsyncTask::DS_cont;
+
+    visible_indices_.swap(culled_indices_);
+    transforms_changed_ = false;
+
+    const size_t visible_count = visible_indices_.size();
 
     auto ram_image = buffer_texture_->modify_ram_image();
-    std::memcpy(ram_image.p(), &transforms_[0], instance_count * sizeof(LMatrix4f));
+    LMatrix4f* buffer = reinterpret_cast<LMatrix4f*>(ram_image.p());
+
+    // Zero instance count means non-instanced rendering, and hiding the node would override
+    // the visibility set by the user. So one instance with a zero matrix is drawn instead,
+    // which collapses the triangles into a point.
+    if (visible_count == 0)
+    {
+        buffer[0] = LMatrix4f::zeros_mat();
+        if (instanced_np_.get_instance_count() != 1)
+            instanced_np_.set_instance_count(1);
+        return AsyncTask::DS_cont;
+    }
+
+    rplibs::ThreadPool::get_global_pool().parallel_for(visible_count, INSTANCE_CHUNK_SIZE, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k)
+            buffer[k] = transforms_[visible_indices_[k]];
+    });
 
-    dirty_ = false;
+    if (instanced_np_.get_instance_count() != static_cast<int>(visible_count))
+        instanced_np_.set_instance_count(static_cast<int>(visible_count));
+
+    return AsyncTask::DS_cont;
 }
 
 // ************************************************************************************************
@@ -145,7 +476,7 @@ void InstancingNode::set_instance_count(int instance_count)
 
 void InstancingNode::add_instance(const LMatrix4f& transform, bool upload)
 {
-    impl_->dirty_ = true;
+    impl_->mark_dirty(impl_->transforms_.size(), impl_->transforms_.size() + 1);
     impl_->transforms_.push_back(transform);
 
     if (upload)
@@ -160,7 +491,7 @@ void InstancingNode::remove_instance(int instance_index, bool upload)
         return;
     }
 
-    impl_->dirty_ = true;
+    impl_->mark_dirty(instance_index, impl_->transforms_.size() - 1);
     impl_->transforms_.erase(impl_->transforms_.begin() + instance_index);
 
     if (upload)
@@ -179,7 +510,8 @@ const std::vector<LMatrix4f>& InstancingNode::get_transforms() const
 
 std::vector<LMatrix4f>& InstancingNode::modify_transforms()
 {
-    impl_->dirty_ = true;
+    // the size can be changed, so it is checked on upload
+    impl_->mark_dirty(0, (std::numeric_limits<size_t>::max)());
     return impl_->transforms_;
 }
 
@@ -204,6 +536,21 @@ void InstancingNode::upload_transforms()
     impl_->upload_transforms();
 }
 
+void InstancingNode::set_culling(bool enable, const NodePath& camera)
+{
+    impl_->set_culling(enable, camera);
+}
+
+bool InstancingNode::is_culling_enabled() const
+{
+    return impl_->culling_task_ != nullptr;
+}
+
+int InstancingNode::get_visible_instance_count() const
+{
+    return static_cast<int>(impl_->culling_task_ ? impl_->visible_indices_.size() : impl_->transforms_.size());
+}
+
 LMatrix4 InstancingNode::get_matrix_of_child(const NodePath& child, int instance_index, const NodePath& other) const
 {
     return child.get_mat(impl_->instanced_np_) * get_transform(instance_index) * impl_->instanced_np_.get_mat(other);
@@ -44,19 +44,35 @@ public:
 
     int get_active_point_count() const;
 
+    /** Extends the range of the positions to upload. */
+    void mark_dirty(size_t begin, size_t end);
+
+    /** Check if the count of points can be used in the primitive. */
+    bool check_point_count(size_t count) const;
+
     void set_position(const LPoint3& position, int point_index);
     void set_positions(const std::vector<LPoint3>& positions);
+    void set_positions(std::vector<LPoint3>&& positions);
 
     void set_radius(float radius);
 
+    void reserve(size_t capacity);
+
     void upload_positions();
 
     void set_active_point_count(int count);
 
 public:
-    bool dirty_ = true;
     NodePath points_np_;
     std::vector<LPoint3> positions_;
+
+    /** Count of rows in the vertex data and count of vertices in the primitive. */
+    size_t capacity_ = 0;
+    size_t uploaded_count_ = 0;
+
+    /** Range of the positions changed after the last upload. */
+    size_t dirty_begin_ = 0;
+    size_t dirty_end_ = 0;
 };
 
 void PointsNode::Impl::initialize(const std::string& name, const std::vector<LPoint3>& positions, float radius,
@@ -78,6 +94,10 @@ void PointsNode::Impl::initialize(const std::string& name, const std::vector<LPo
     prim->add_consecutive_vertices(0, count);
     prim->close_primitive();
 
+    capacity_ = positions_.size();
+    uploaded_count_ = positions_.size();
+    dirty_begin_ = dirty_end_ = 0;
+
     PT(Geom) geom = new Geom(vdata);
     geom->add_primitive(prim);
 
@@ -99,24 +119,55 @@ int PointsNode::Impl::get_active_point_count() const
     return DCAST(GeomNode, points_np_.node())->get_geom(0)->get_primitive(0)->get_num_vertices();
 }
 
+void PointsNode::Impl::mark_dirty(size_t begin, size_t end)
+{
+    if (dirty_begin_ >= dirty_end_)
+    {
+        dirty_begin_ = begin;
+        dirty_end_ = end;
+    }
+    else
+    {
+        dirty_begin_ = (std::min)(dirty_begin_, begin);
+        dirty_end_ = (std::max)(dirty_end_, end);
+    }
+}
+
+bool PointsNode::Impl::check_point_count(size_t count) const
+{
+    if (count > static_cast<size_t>((std::numeric_limits<int>::max)()))
+    {
+        RPObject::global_error("PointsNode", fmt::format("The size {} of points is more than the maximum size ({}).",
+            count, (std::numeric_limits<int>::max)()));
+        return false;
+    }
+    return true;
+}
+
 void PointsNode::Impl::set_position(const LPoint3& position, int point_index)
 {
-    dirty_ = true;
+    mark_dirty(point_index, point_index + 1);
     positions_[point_index] = position;
 }
 
 void PointsNode::Impl::set_positions(const std::vector<LPoint3>& positions)
 {
-    if (positions.size() > (std::numeric_limits<int>::max)())
-    {
-        RPObject::global_error("PointsNode", fmt::format("The size {} of points is more than the maximum size ({}).",
-            positions.size(), (std::numeric_limits<int>::max)()));
+    if (!check_point_count(positions.size()))
         return;
-    }
 
     positions_ = positions;
 
-    dirty_ = true;
+    mark_dirty(0, positions_.size());
+}
+
+void PointsNode::Impl::set_positions(std::vector<LPoint3>&& positions)
+{
+    if (!check_point_count(positions.size()))
+        return;
+
+    positions_ = std::move(positions);
+
+    mark_dirty(0, positions_.size());
 }
 
 void PointsNode::Impl::set_radius(float radius)
@@ -124,31 +175,56 @@ void PointsNode::Impl::set_radius(float radius)
     points_np_.set_shader_input("point_radius", LVecBase4(radius));
 }
 
+void PointsNode::Impl::reserve(size_t capacity)
+{
+    if (capacity <= capacity_ || !check_point_count(capacity))
+        return;
+
+    capacity_ = capacity;
+
+    // unclean_set_num_rows does not keep the old data, so all points are uploaded again.
+    DCAST(GeomNode, points_np_.node())->modify_geom(0)->modify_vertex_data()->unclean_set_num_rows(static_cast<int>(capacity_));
+    mark_dirty(0, positions_.size());
+}
+
 void PointsNode::Impl::upload_positions()
 {
-    if (!dirty_)
+    const size_t count = positions_.size();
+    if (dirty_begin_ >= dirty_end_ && count == uploaded_count_)
         return;
 
+    if (!check_point_count(count))
+        return;
+
+    // grow geometrically, so that appending points does not resize the vertex data every time.
+    if (count > capacity_)
+        reserve((std::min)((std::max)(count, capacity_ * 2), static_cast<size_t>((std::numeric_limits<int>::max)())));
+
     auto geom = DCAST(GeomNode, points_np_.node())->modify_geom(0);
-    auto vdata = geom->modify_vertex_data();
 
-    const int count = static_cast<int>(positions_.size());
-    if (vdata->get_num_rows() != count)
+    if (count != uploaded_count_)
     {
         auto prim = geom->modify_primitive(0);
 
-        vdata->unclean_set_num_rows(count);
-
         prim->clear_vertices();
-        prim->add_consecutive_vertices(0, count);
+        prim->add_consecutive_vertices(0, static_cast<int>(count));
         prim->close_primitive();
+
+        uploaded_count_ = count;
     }
 
-    vdata->modify_array(0)->modify_handle()->copy_data_from(
-        reinterpret_cast<const unsigned char*>(positions_.data()),
-        positions_.size() * sizeof(decltype(positions_)::value_type));
+    const size_t begin = (std::min)(dirty_begin_, count);
+    const size_t end = (std::min)(dirty_end_, count);
+    if (begin < end)
+    {
+        constexpr size_t stride = sizeof(decltype(positions_)::value_type);
+        geom->modify_vertex_data()->modify_array(0)->modify_handle()->copy_subdata_from(
+            begin * stride, (end - begin) * stride,
+            reinterpret_cast<const unsigned char*>(positions_.data()), begin * stride, (end - begin) * stride);
+    }
 
-    dirty_ = false;
+    dirty_begin_ = 0;
+    dirty_end_ = 0;
 }
 
 void PointsNode::Impl::set_active_point_count(int count)
@@ -191,6 +267,17 @@ int PointsNode::get_point_count() const
     return static_cast<int>(impl_->positions_.size());
 }
 
+int PointsNode::get_capacity() const
+{
+    return static_cast<int>(impl_->capacity_);
+}
+
+void PointsNode::reserve(int capacity)
+{
+    if (capacity > 0)
+        impl_->reserve(static_cast<size_t>(capacity));
+}
+
 int PointsNode::get_active_point_count() const
 {
     return impl_->get_active_point_count();
@@ -228,10 +315,23 @@ const std::vector<LPoint3>& PointsNode::get_positions() const
 
 std::vector<LPoint3>& PointsNode::modify_positions()
 {
-    impl_->dirty_ = true;
+    // the size can be changed, so it is checked on upload
+    impl_->mark_dirty(0, (std::numeric_limits<size_t>::max)());
     return impl_->positions_;
 }
 
+LPoint3* PointsNode::modify_positions(int begin, int count)
+{
+    if (begin < 0 || count < 0 || static_cast<size_t>(begin) + count > impl_->positions_.size())
+    {
+        RPObject::global_error("PointsNode", "Out of range of positions of PointsNode.");
+        return nullptr;
+    }
+
+    impl_->mark_dirty(begin, static_cast<size_t>(begin) + count);
+    return impl_->positions_.data() + begin;
+}
+
 void PointsNode::set_position(const LPoint3& position, int point_index)
 {
     if (point_index >= static_cast<int>(impl_->positions_.size()))
@@ -248,6 +348,11 @@ void PointsNode::set_positions(const std::vector<LPoint3>& positions)
     impl_->set_positions(positions);
 }
 
+void PointsNode::set_positions(std::vector<LPoint3>&& positions)
+{
+    impl_->set_positions(std::move(positions));
+}
+
 void PointsNode::upload_positions()
 {
     impl_->upload_positions();
@@ -30,8 +30,93 @@
 #include "render_pipeline/rpcore/rpobject.hpp"
 #include "render_pipeline/rpcore/util/rprender_state.hpp"
 
+#include "render_pipeline/rplibs/thread_pool.hpp"
+
 namespace rpcore {
 
+static_assert(sizeof(LVecBase3f) == sizeof(float)*3, "sizeof(LVecBase3f) == sizeof(float)*3");
+static_assert(sizeof(LVecBase2f) == sizeof(float)*2, "sizeof(LVecBase2f) == sizeof(float)*2");
+
+/** Vertices from this count are written on the thread pool. */
+static constexpr size_t PARALLEL_WRITE_MIN_COUNT = 1 << 16;
+static constexpr size_t PARALLEL_WRITE_CHUNK_SIZE = 1 << 14;
+
+/** Column which is copied directly from a packed source array into the vertex data. */
+struct BulkColumn
+{
+    int array_index;
+    size_t start;
+    const unsigned char* source;
+    size_t size;
+};
+
+/**
+ * Adds the column of @p name to @p columns, if the column consists of float32 components
+ * as same as the type of @p values.
+ */
+template <class T>
+static bool find_bulk_column(const GeomVertexFormat* format, const InternalName* name, const std::vector<T>& values,
+    std::vector<BulkColumn>& columns)
+{
+    const int array_index = format->get_array_with(name);
+    if (array_index < 0)
+        return false;
+
+    const GeomVertexColumn* column = format->get_column(name);
+    if (column->get_numeric_type() != GeomEnums::NT_float32 || column->get_num_components() * sizeof(float) != sizeof(T))
+        return false;
+
+    columns.push_back({ array_index, static_cast<size_t>(column->get_start()),
+        reinterpret_cast<const unsigned char*>(values.data()), sizeof(T) });
+    return true;
+}
+
+/** Copies the columns into the arrays of @p vdata, visiting each array once. */
+static void write_bulk_columns(GeomVertexData* vdata, const std::vector<BulkColumn>& columns, size_t count)
+{
+    if (count == 0)
+        return;
+
+    const GeomVertexFormat* format = vdata->get_format();
+    for (int array_index = 0, array_end = static_cast<int>(format->get_num_arrays()); array_index < array_end; ++array_index)
+    {
+        std::vector<BulkColumn> array_columns;
+        for (const auto& column: columns)
+        {
+            if (column.array_index == array_index)
+                array_columns.push_back(column);
+        }
+
+        if (array_columns.empty())
+            continue;
+
+        PT(GeomVertexArrayDataHandle) handle = vdata->modify_array_handle(array_index);
+        unsigned char* array_data = handle->get_write_pointer();
+        const size_t stride = format->get_array(array_index)->get_stride();
+
+        // a non-interleaved array is the same as the source array
+        if (array_columns.size() == 1 && array_columns[0].start == 0 && array_columns[0].size == stride)
+        {
+            std::memcpy(array_data, array_columns[0].source, count * stride);
+            continue;
+        }
+
+        const auto copy_rows = [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k)
+            {
+                unsigned char* row = array_data + k * stride;
+                for (const auto& column: array_columns)
+                    std::memcpy(row + column.start, column.source + k * column.size, column.size);
+            }
+        };
+
+        if (count >= PARALLEL_WRITE_MIN_COUNT)
+            rplibs::ThreadPool::get_global_pool().parallel_for(count, PARALLEL_WRITE_CHUNK_SIZE, copy_rows);
+        else
+            copy_rows(0, count);
+    }
+}
+
 RPGeomNode::RPGeomNode(const NodePath& nodepath)
 {
     if (!nodepath.node()->is_geom_node())
@@ -285,6 +370,16 @@ bool RPGeomNode::modify_vertex_data(const std::vector<LVecBase3>& vertices,
         return false;
     }
 
+    // write the float32 columns directly into the arrays
+    std::vector<BulkColumn> columns;
+    if (find_bulk_column(vdata->get_format(), InternalName::get_vertex(), vertices, columns) &&
+        find_bulk_column(vdata->get_format(), InternalName::get_normal(), normals, columns) &&
+        find_bulk_column(vdata->get_format(), InternalName::get_texcoord(), texcoords, columns))
+    {
+        write_bulk_columns(vdata, columns, vertices.size());
+        return true;
+    }
+
     GeomVertexWriter geom_vertices(vdata, InternalName::get_vertex());
     GeomVertexWriter geom_normals(vdata, InternalName::get_normal());
     GeomVertexWriter geom_texcoord0(vdata, InternalName::get_texcoord());
@@ -319,6 +414,13 @@ bool RPGeomNode::modify_vertex_data(const std::vector<LVecBase3>& vertices,
         return false;
     }
 
+    std::vector<BulkColumn> columns;
+    if (find_bulk_column(vdata->get_format(), InternalName::get_vertex(), vertices, columns))
+    {
+        write_bulk_columns(vdata, columns, vertices.size());
+        return true;
+    }
+
     GeomVertexWriter geom_vertices(vdata, InternalName::get_vertex());
 
     for (size_t k = 0, k_end = vertices.size(); k < k_end; ++k)
@@ -0,0 +1,160 @@
+/**
+ * Render Pipeline C++
+ *
+ * Copyright (c) 2016-2017 Center of Human-centered Interaction for Coexistence.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "rpcore/util/shader_define_tracker.hpp"
+
+#include <cctype>
+
+#include <virtualFileSystem.h>
+#include <config_putil.h>
+
+#include <fmt/format.h>
+
+namespace rpcore {
+
+/** The shader config contains all defines, so it is not searched. */
+static const char* shader_config_path = "/$$rptemp/$$pipeline_shader_config.inc.glsl";
+
+static bool is_identifier_char(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+ShaderDefineTracker::ShaderDefineTracker(): RPObject("ShaderDefineTracker")
+{
+}
+
+bool ShaderDefineTracker::uses_defines(const std::vector<Filename>& shader_paths, const std::unordered_set<std::string>& defines)
+{
+    if (defines.empty())
+        return false;
+
+    std::unordered_set<std::string> visited;
+    std::vector<Filename> pending(shader_paths.rbegin(), shader_paths.rend());
+    while (!pending.empty())
+    {
+        const Filename path = pending.back();
+        pending.pop_back();
+
+        if (path.empty() || path.get_fullpath() == shader_config_path || !visited.insert(path.get_fullpath()).second)
+            continue;
+
+        const ShaderFile* file = get_file(path);
+        if (!file)
+            return true;
+
+        for (const auto& define: defines)
+        {
+            if (file->identifiers.find(define) != file->identifiers.end())
+                return true;
+        }
+
+        pending.insert(pending.end(), file->includes.rbegin(), file->includes.rend());
+    }
+
+    return false;
+}
+
+const ShaderDefineTracker::ShaderFile* ShaderDefineTracker::get_file(const Filename& path)
+{
+    VirtualFileSystem* vfs = VirtualFileSystem::get_global_ptr();
+    PT(VirtualFile) vfile = vfs->get_file(path, true);
+    if (!vfile)
+    {
+        warn(fmt::format("Could not find shader file {}", path.get_fullpath()));
+        return nullptr;
+    }
+
+    const time_t mtime = vfile->get_timestamp();
+    auto found = files_.find(path.get_fullpath());
+    if (found != files_.end() && found->second.mtime == mtime)
+        return &found->second;
+
+    std::string source;
+    if (!vfile->read_file(source, true))
+    {
+        warn(fmt::format("Could not read shader file {}", path.get_fullpath()));
+        return nullptr;
+    }
+
+    ShaderFile file;
+    file.mtime = mtime;
+
+    static const std::string pragma_include = "#pragma include";
+    const size_t length = source.length();
+    size_t line_begin = 0;
+    while (line_begin < length)
+    {
+        size_t line_end = source.find('\n', line_begin);
+        if (line_end == std::string::npos)
+            line_end = length;
+
+        size_t k = source.find_first_not_of(" \t", line_begin);
+        if (k < line_end && source.compare(k, pragma_include.length(), pragma_include) == 0)
+        {
+            // #pragma include "file" or #pragma include <file>
+            const size_t open = source.find_first_of("\"<", k + pragma_include.length());
+            const size_t close = open < line_end ? source.find_first_of("\">", open + 1) : std::string::npos;
+            if (close < line_end)
+                file.includes.push_back(resolve_include(source.substr(open + 1, close - open - 1), path));
+            line_begin = line_end + 1;
+            continue;
+        }
+
+        for (k = line_begin; k < line_end;)
+        {
+            if (!is_identifier_char(source[k]))
+            {
+                ++k;
+                continue;
+            }
+
+            const size_t token_begin = k;
+            while (k < line_end && is_identifier_char(source[k]))
+                ++k;
+
+            if (!std::isdigit(static_cast<unsigned char>(source[token_begin])))
+                file.identifiers.emplace(source, token_begin, k - token_begin);
+        }
+
+        line_begin = line_end + 1;
+    }
+
+    return &(files_[path.get_fullpath()] = std::move(file));
+}
+
+Filename ShaderDefineTracker::resolve_include(const Filename& include, const Filename& parent) const
+{
+    VirtualFileSystem* vfs = VirtualFileSystem::get_global_ptr();
+
+    Filename path(include);
+    if (path.is_local())
+    {
+        Filename relative_path(Filename(parent.get_dirname()), include);
+        if (vfs->exists(relative_path))
+            return relative_path;
+        vfs->resolve_filename(path, get_model_path());
+    }
+
+    return path;
+}
+
+}
@@ -0,0 +1,69 @@
+/**
+ * Render Pipeline C++
+ *
+ * Copyright (c) 2016-2017 Center of Human-centered Interaction for Coexistence.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <filename.h>
+
+#include <render_pipeline/rpcore/rpobject.hpp>
+
+namespace rpcore {
+
+/**
+ * Finds out whether shaders reference some defines, by searching the
+ * identifiers in the shader files and in the files included by them.
+ * The identifiers of each file are cached until the file is modified.
+ */
+class ShaderDefineTracker : public RPObject
+{
+public:
+    ShaderDefineTracker();
+
+    /**
+     * Returns true if one of the given shader files or the files included by
+     * them uses one of @p defines. If a file cannot be read, this returns
+     * true, too.
+     */
+    bool uses_defines(const std::vector<Filename>& shader_paths, const std::unordered_set<std::string>& defines);
+
+private:
+    struct ShaderFile
+    {
+        time_t mtime;
+        std::vector<Filename> includes;
+        std::unordered_set<std::string> identifiers;
+    };
+
+    /** Returns the parsed file, or nullptr if the file cannot be read. */
+    const ShaderFile* get_file(const Filename& path);
+
+    /** Resolves the path of an include in the same way as the GLSL preprocessor of Panda3D. */
+    Filename resolve_include(const Filename& include, const Filename& parent) const;
+
+    std::unordered_map<std::string, ShaderFile> files_;
+};
+
+}
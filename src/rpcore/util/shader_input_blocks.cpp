@@ -60,10 +60,21 @@ GroupedInputBlock::GroupedInputBlock(const std::string& name): RPObject("Grouped
 
 #define MAKE_PTA(TYPE_NAME) \
     case PTA_ID::TYPE_NAME: \
-        ptas_.insert_or_assign(uniform_name, TYPE_NAME::empty_array(array_size)); \
-        break;
+        return &(ptas_.insert_or_assign(uniform_name, TYPE_NAME::empty_array(array_size)).first->second);
 
 void GroupedInputBlock::register_pta(const std::string& name, const std::string& input_type)
+{
+    const PTA_ID pta_id = glsl_type_to_pta(input_type);
+    if (pta_id == PTA_ID::INVALID)
+    {
+        nout << "Invalid Panda3D type for shader input: [" << input_type << "]" << std::endl;
+        return;
+    }
+
+    do_register_pta(name, pta_id);
+}
+
+GroupedInputBlock::PTA_Types* GroupedInputBlock::do_register_pta(const std::string& name, PTA_ID pta_id)
 {
     int array_size = 1;
     std::string uniform_name = name;
@@ -74,7 +85,7 @@ void GroupedInputBlock::register_pta(const std::string& name, const std::string&
     if (match.size() > 2)
     {
         warn(std::string("Invalid uniform array syntax: ") + name);
-        return;
+        return nullptr;
     }
     else if (match.size() == 2)
     {
@@ -82,31 +93,25 @@ void GroupedInputBlock::register_pta(const std::string& name, const std::string&
         if (array_size <= 0)
         {
             warn(std::string("Invalid uniform array size: ") + name);
-            return;
+            return nullptr;
         }
         uniform_name = match.prefix().str();
     }
 
-    try
+    switch (pta_id)
     {
-        switch (glsl_type_to_pta(input_type))
-        {
-        MAKE_PTA(PTA_int)
-        MAKE_PTA(PTA_float)
-        MAKE_PTA(PTA_LVecBase2f)
-        MAKE_PTA(PTA_LVecBase2i)
-        MAKE_PTA(PTA_LVecBase3f)
-        MAKE_PTA(PTA_LVecBase4f)
-        MAKE_PTA(PTA_LMatrix3f)
-        MAKE_PTA(PTA_LMatrix4f)
-
-        default:
-            throw std::out_of_range("Invalid type");
-        }
-    }
-    catch (const std::out_of_range&)
-    {
-        nout << "Invalid Panda3D type for shader input: [" << input_type << "]" << std::endl;
+    MAKE_PTA(PTA_int)
+    MAKE_PTA(PTA_float)
+    MAKE_PTA(PTA_LVecBase2f)
+    MAKE_PTA(PTA_LVecBase2i)
+    MAKE_PTA(PTA_LVecBase3f)
+    MAKE_PTA(PTA_LVecBase4f)
+    MAKE_PTA(PTA_LMatrix3f)
+    MAKE_PTA(PTA_LMatrix4f)
+
+    default:
+        error("Unrecognized PTA type.");
+        return nullptr;
     }
 }
 
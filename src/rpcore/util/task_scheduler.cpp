@@ -33,25 +33,35 @@ namespace rpcore {
 
 TaskScheduler::TaskScheduler(): RPObject("TaskScheduler")
 {
-    frame_index_ = 0;
-
     load_config();
 }
 
-bool TaskScheduler::is_scheduled(const std::string& task_name) const
+TaskScheduler::TaskID TaskScheduler::get_task_id(const std::string& task_name) const
 {
-    check_missing_schedule(task_name);
-    return std::find(tasks_[frame_index_].cbegin(), tasks_[frame_index_].cend(), task_name) != tasks_[frame_index_].cend();
+    const auto found = task_ids_.find(task_name);
+    if (found != task_ids_.end())
+        return found->second;
+
+    // The tasks in the config are interned while loading it, so the new
+    // task is never scheduled.
+    error(std::string("Task '") + task_name + "' is never scheduled and thus will never run!");
+
+    const TaskID task_id = task_ids_.size();
+    task_ids_.emplace(task_name, task_id);
+    return task_id;
 }
 
 void TaskScheduler::step()
 {
-    frame_index_ = (frame_index_ + 1) % tasks_.size();
+    if (frame_tasks_.empty())
+        return;
+
+    frame_index_ = (frame_index_ + 1) % frame_tasks_.size();
 }
 
 size_t TaskScheduler::get_num_tasks() const
 {
-    return std::accumulate(tasks_.begin(), tasks_.end(), size_t(0), [](const size_t& sum, const std::vector<std::string>& tasks) {
+    return std::accumulate(frame_tasks_.begin(), frame_tasks_.end(), size_t(0), [](const size_t& sum, const std::vector<TaskID>& tasks) {
         return sum + tasks.size();
     });
 }
@@ -65,31 +75,34 @@ void TaskScheduler::load_config()
     for (const auto& frame_node: config_node["frame_cycles"])
     {
         // add frame
-        tasks_.push_back({});
+        frame_tasks_.push_back({});
 
         // XXX: omap of yaml-cpp is list.
         for (const auto& frame_name_tasks: frame_node)
         {
             for (const auto& task_name: frame_name_tasks.second)
-                tasks_.back().push_back(task_name.as<std::string>());
+            {
+                const auto& task_id = task_ids_.emplace(task_name.as<std::string>(), task_ids_.size()).first->second;
+                frame_tasks_.back().push_back(task_id);
+            }
         }
     }
+
+    num_config_tasks_ = task_ids_.size();
+
+    update_frame_bits();
 }
 
-void TaskScheduler::check_missing_schedule(const std::string& task_name) const
+void TaskScheduler::update_frame_bits()
 {
-    bool found = false;
-    for (const auto& tasks: tasks_)
+    const size_t num_words = (num_config_tasks_ + 63) / 64;
+
+    frame_bits_.assign(frame_tasks_.size(), std::vector<uint64_t>(num_words, 0));
+    for (size_t frame = 0, frame_end = frame_tasks_.size(); frame < frame_end; ++frame)
     {
-        if (std::find(tasks.cbegin(), tasks.cend(), task_name) != tasks.cend())
-        {
-            found = true;
-            break;
-        }
+        for (const auto task_id: frame_tasks_[frame])
+            frame_bits_[frame][task_id / 64] |= uint64_t(1) << (task_id % 64);
     }
-
-    if (!found)
-        error(std::string("Task '") + task_name + "' is never scheduled and thus will never run!");
 }
 
 }
@@ -0,0 +1,149 @@
+/**
+ * Render Pipeline C++
+ *
+ * Copyright (c) 2016-2017 Center of Human-centered Interaction for Coexistence.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "bench.hpp"
+
+#include <algorithm>
+
+#include <fmt/format.h>
+
+#include <render_pipeline/rpcore/render_pipeline.hpp>
+
+namespace rpcore_bench {
+
+BenchState::BenchState(BenchResult& result, size_t repetitions): result_(result), repetitions_(repetitions)
+{
+}
+
+void BenchState::run(size_t iterations, const std::function<void()>& body)
+{
+    run(iterations, [] {}, body);
+}
+
+void BenchState::run(size_t iterations, const std::function<void()>& setup, const std::function<void()>& body)
+{
+    result_.iterations = iterations;
+    result_.repetition_ns.clear();
+
+    // the first repetition warms up the caches and is not recorded
+    for (size_t rep = 0; rep <= repetitions_; ++rep)
+    {
+        setup();
+
+        const auto start_time = std::chrono::steady_clock::now();
+        for (size_t k = 0; k < iterations; ++k)
+            body();
+        const auto end_time = std::chrono::steady_clock::now();
+
+        if (rep > 0)
+            result_.repetition_ns.push_back(std::chrono::duration<double, std::nano>(end_time - start_time).count() / iterations);
+    }
+}
+
+void BenchState::set_items_per_iteration(double items)
+{
+    result_.items_per_iteration = items;
+}
+
+void BenchState::set_counter(const std::string& name, double value)
+{
+    result_.counters[name] = value;
+}
+
+void BenchState::skip(const std::string& reason)
+{
+    result_.error_message = reason;
+}
+
+bool BenchState::check(bool condition, const std::string& message)
+{
+    if (!condition && !result_.failed)
+    {
+        result_.failed = true;
+        result_.error_message = "Check failed: " + message;
+    }
+    return condition;
+}
+
+// ************************************************************************************************
+
+static std::string escape_json_string(const std::string& str)
+{
+    std::string result;
+    result.reserve(str.size());
+    for (const char c: str)
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        result += c;
+    }
+    return result;
+}
+
+void write_json(std::ostream& os, const std::vector<BenchResult>& results, size_t repetitions)
+{
+    os << "{\n";
+    os << "  \"context\": {\n";
+    os << fmt::format("    \"library_version\": \"{}\",\n", rpcore::RenderPipeline::get_version().to_string());
+    os << fmt::format("    \"git_commit\": \"{}\",\n", rpcore::RenderPipeline::get_git_commit().to_string());
+    os << fmt::format("    \"repetitions\": {}\n", repetitions);
+    os << "  },\n";
+    os << "  \"benchmarks\": [";
+
+    for (size_t k = 0, k_end = results.size(); k < k_end; ++k)
+    {
+        const auto& result = results[k];
+
+        std::vector<double> sorted_ns = result.repetition_ns;
+        std::sort(sorted_ns.begin(), sorted_ns.end());
+        const double median_ns = sorted_ns.empty() ? 0.0 : sorted_ns[sorted_ns.size() / 2];
+
+        os << (k == 0 ? "\n" : ",\n");
+        os << "    {\n";
+        os << fmt::format("      \"name\": \"{}\",\n", escape_json_string(result.name));
+
+        if (!result.error_message.empty())
+        {
+            os << "      \"error_occurred\": true,\n";
+            os << fmt::format("      \"error_message\": \"{}\"\n", escape_json_string(result.error_message));
+            os << "    }";
+            continue;
+        }
+
+        os << fmt::format("      \"iterations\": {},\n", result.iterations);
+        os << fmt::format("      \"repetitions\": {},\n", sorted_ns.size());
+        os << fmt::format("      \"time_unit\": \"ns\",\n");
+        os << fmt::format("      \"median_time\": {:.3f},\n", median_ns);
+        os << fmt::format("      \"min_time\": {:.3f},\n", sorted_ns.empty() ? 0.0 : sorted_ns.front());
+        os << fmt::format("      \"max_time\": {:.3f},\n", sorted_ns.empty() ? 0.0 : sorted_ns.back());
+        os << fmt::format("      \"items_per_second\": {:.3f}", median_ns > 0 ? result.items_per_iteration * 1e9 / median_ns : 0.0);
+
+        for (const auto& counter: result.counters)
+            os << fmt::format(",\n      \"{}\": {}", escape_json_string(counter.first), counter.second);
+
+        os << "\n    }";
+    }
+
+    os << "\n  ]\n";
+    os << "}\n";
+}
+
+}
@@ -0,0 +1,132 @@
+/**
+ * Render Pipeline C++
+ *
+ * Copyright (c) 2016-2017 Center of Human-centered Interaction for Coexistence.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <graphicsOutput.h>
+#include <nodePath.h>
+
+namespace rpcore {
+class RenderPipeline;
+}
+
+namespace rpcore_bench {
+
+/** Objects shared by the benchmarks, which are created once in main. */
+struct BenchEnvironment
+{
+    /** Pipeline with the mounts and the settings, but without ShowBase. */
+    rpcore::RenderPipeline* pipeline = nullptr;
+
+    /**
+     * Offscreen buffer of the software renderer for the display regions of
+     * the shadow cameras, or nullptr if it is not available.
+     * Nothing is rendered in the benchmarks.
+     */
+    PT(GraphicsOutput) buffer;
+
+    /** Scene root and main camera, which replace those of ShowBase. */
+    NodePath render;
+    NodePath camera;
+};
+
+struct BenchResult
+{
+    std::string name;
+
+    size_t iterations = 0;      ///< Iterations in each repetition.
+    double items_per_iteration = 1;
+
+    /** Time per iteration of each repetition, in nanoseconds. */
+    std::vector<double> repetition_ns;
+
+    /** Extra values of the benchmark, like cache hits or atlas statistics. */
+    std::map<std::string, double> counters;
+
+    /** Reason why the benchmark was skipped, or empty if it ran. */
+    std::string error_message;
+
+    /** Whether a check of the benchmark failed, which fails the whole run. */
+    bool failed = false;
+};
+
+/**
+ * Runs the body of a benchmark and collects the timings.
+ *
+ * The body runs for the given iterations in each repetition, after one
+ * warm-up repetition which is not recorded. The workloads use fixed seeds,
+ * so the median over the repetitions is stable between runs.
+ */
+class BenchState
+{
+public:
+    BenchState(BenchResult& result, size_t repetitions);
+
+    /** Runs @p body @p iterations times in each repetition. */
+    void run(size_t iterations, const std::function<void()>& body);
+
+    /** Same as run(), but @p setup is called before each repetition and is not timed. */
+    void run(size_t iterations, const std::function<void()>& setup, const std::function<void()>& body);
+
+    /** Sets the number of processed items in an iteration, used for the throughput. */
+    void set_items_per_iteration(double items);
+
+    void set_counter(const std::string& name, double value);
+
+    /** Marks the benchmark as skipped, when its requirements are not available. */
+    void skip(const std::string& reason);
+
+    /**
+     * Checks a result of the benchmarked code. If @p condition is false,
+     * the benchmark fails with @p message and main returns an error.
+     *
+     * @return  @p condition
+     */
+    bool check(bool condition, const std::string& message);
+
+private:
+    BenchResult& result_;
+    size_t repetitions_;
+};
+
+using BenchFunction = std::function<void(BenchState&, BenchEnvironment&)>;
+
+struct BenchCase
+{
+    std::string name;
+    BenchFunction function;
+};
+
+void register_native_benchmarks(std::vector<BenchCase>& cases);
+void register_core_benchmarks(std::vector<BenchCase>& cases);
+void register_showbase_benchmarks(std::vector<BenchCase>& cases);
+
+/** Writes the results as JSON, in a layout similar to Google Benchmark. */
+void write_json(std::ostream& os, const std::vector<BenchResult>& results, size_t repetitions);
+
+}
@@ -0,0 +1,487 @@
+/**
+ * Render Pipeline C++
+ *
+ * Copyright (c) 2016-2017 Center of Human-centered Interaction for Coexistence.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "bench.hpp"
+
+#include <algorithm>
+#include <random>
+
+#include <fmt/format.h>
+
+#include <pnmImage.h>
+#include <texturePool.h>
+#include <virtualFileSystem.h>
+#include <virtualFileMountRamdisk.h>
+
+#include <render_pipeline/rpcore/effect.hpp>
+#include <render_pipeline/rpcore/loader.hpp>
+#include <render_pipeline/rpcore/util/shader_input_blocks.hpp>
+#include <render_pipeline/rpcore/util/points_node.hpp>
+
+#include "rplibs/yaml.hpp"
+#include "rpcore/stage_graph.hpp"
+
+namespace rpcore_bench {
+
+using namespace rpcore;
+
+static std::vector<Filename> list_files(const Filename& dir_path, const std::string& extension)
+{
+    std::vector<Filename> files;
+
+    PT(VirtualFileList) file_list = VirtualFileSystem::get_global_ptr()->scan_directory(dir_path);
+    if (!file_list)
+        return files;
+
+    for (size_t k = 0, k_end = file_list->get_num_files(); k < k_end; ++k)
+    {
+        const Filename& path = file_list->get_file(k)->get_filename();
+        if (extension.empty() || path.get_extension() == extension)
+            files.push_back(path);
+    }
+
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+static void remove_files(const Filename& dir_path)
+{
+    VirtualFileSystem* vfs = VirtualFileSystem::get_global_ptr();
+    for (const auto& path: list_files(dir_path, ""))
+        vfs->delete_file(path);
+}
+
+// ************************************************************************************************
+
+enum class EffectCacheState
+{
+    cold,       ///< The shaders are generated from the templates.
+    disk,       ///< The shaders generated in a previous run are reused.
+    memory,     ///< The effects are already loaded.
+};
+
+static void bench_effect_load(BenchState& state, BenchEnvironment& env, EffectCacheState cache_state, bool batch)
+{
+    const auto& effect_files = list_files("/$$rp/effects", "yaml");
+    if (effect_files.empty())
+    {
+        state.skip("No effect files in /$$rp/effects.");
+        return;
+    }
+
+    std::vector<Effect::SourceType> sources;
+    for (const auto& path: effect_files)
+        sources.emplace_back(path, Effect::OptionType{});
+
+    // fill the caches
+    Effect::load_many(*env.pipeline, sources);
+
+    const size_t memory_hits_before = Effect::get_num_memory_cache_hits();
+    const size_t disk_hits_before = Effect::get_num_disk_cache_hits();
+    const size_t misses_before = Effect::get_num_cache_misses();
+
+    size_t num_failed = 0;
+    state.run(1, [&] {
+        if (cache_state != EffectCacheState::memory)
+            Effect::clear_cache();
+        if (cache_state == EffectCacheState::cold)
+            remove_files("/$$rptemp/effect_cache");
+    }, [&] {
+        if (batch)
+        {
+            for (const auto& effect: Effect::load_many(*env.pipeline, sources))
+                num_failed += effect ? 0 : 1;
+        }
+        else
+        {
+            for (const auto& source: sources)
+                num_failed += Effect::load(*env.pipeline, source.first, source.second) ? 0 : 1;
+        }
+    });
+
+    state.set_items_per_iteration(static_cast<double>(sources.size()));
+    state.set_counter("effects", static_cast<double>(sources.size()));
+    state.set_counter("failed", static_cast<double>(num_failed));
+    state.set_counter("memory_cache_hits", static_cast<double>(Effect::get_num_memory_cache_hits() - memory_hits_before));
+    state.set_counter("disk_cache_hits", static_cast<double>(Effect::get_num_disk_cache_hits() - disk_hits_before));
+    state.set_counter("cache_misses", static_cast<double>(Effect::get_num_cache_misses() - misses_before));
+}
+
+// ************************************************************************************************
+
+/** Inputs of the MainSceneData block in CommonResources. */
+struct SceneDataInputs
+{
+    GroupedInputBlock::Handle<PTA_LMatrix4f> view_mat_z_up;
+    GroupedInputBlock::Handle<PTA_LMatrix4f> view_mat_billboard;
+    GroupedInputBlock::Handle<PTA_LMatrix4f> last_view_proj_mat_no_jitter;
+    GroupedInputBlock::Handle<PTA_LMatrix4f> last_inv_view_proj_mat_no_jitter;
+    GroupedInputBlock::Handle<PTA_LMatrix4f> proj_mat;
+    GroupedInputBlock::Handle<PTA_LMatrix4f> inv_proj_mat;
+    GroupedInputBlock::Handle<PTA_LMatrix4f> view_proj_mat_no_jitter;
+    GroupedInputBlock::Handle<PTA_LMatrix4f> vs_frustum_directions;
+    GroupedInputBlock::Handle<PTA_LMatrix4f> ws_frustum_directions;
+    GroupedInputBlock::Handle<PTA_LVecBase3f> camera_pos;
+    GroupedInputBlock::Handle<PTA_float> frame_delta;
+    GroupedInputBlock::Handle<PTA_float> smooth_frame_delta;
+    GroupedInputBlock::Handle<PTA_float> frame_time;
+    GroupedInputBlock::Handle<PTA_LVecBase2f> current_film_offset;
+    GroupedInputBlock::Handle<PTA_int> frame_index;
+    GroupedInputBlock::Handle<PTA_LVecBase2i> screen_size;
+};
+
+static constexpr size_t num_scene_data_inputs = 16;
+
+static void bench_input_block_update(BenchState& state, BenchEnvironment&, bool use_handles)
+{
+    GroupedInputBlock block("MainSceneData");
+
+    SceneDataInputs inputs;
+    inputs.view_mat_z_up = block.register_pta<PTA_LMatrix4f>("view_mat_z_up");
+    inputs.view_mat_billboard = block.register_pta<PTA_LMatrix4f>("view_mat_billboard");
+    inputs.last_view_proj_mat_no_jitter = block.register_pta<PTA_LMatrix4f>("last_view_proj_mat_no_jitter");
+    inputs.last_inv_view_proj_mat_no_jitter = block.register_pta<PTA_LMatrix4f>("last_inv_view_proj_mat_no_jitter");
+    inputs.proj_mat = block.register_pta<PTA_LMatrix4f>("proj_mat");
+    inputs.inv_proj_mat = block.register_pta<PTA_LMatrix4f>("inv_proj_mat");
+    inputs.view_proj_mat_no_jitter = block.register_pta<PTA_LMatrix4f>("view_proj_mat_no_jitter");
+    inputs.vs_frustum_directions = block.register_pta<PTA_LMatrix4f>("vs_frustum_directions");
+    inputs.ws_frustum_directions = block.register_pta<PTA_LMatrix4f>("ws_frustum_directions");
+    inputs.camera_pos = block.register_pta<PTA_LVecBase3f>("camera_pos");
+    inputs.frame_delta = block.register_pta<PTA_float>("frame_delta");
+    inputs.smooth_frame_delta = block.register_pta<PTA_float>("smooth_frame_delta");
+    inputs.frame_time = block.register_pta<PTA_float>("frame_time");
+    inputs.current_film_offset = block.register_pta<PTA_LVecBase2f>("current_film_offset");
+    inputs.frame_index = block.register_pta<PTA_int>("frame_index");
+    inputs.screen_size = block.register_pta<PTA_LVecBase2i>("screen_size");
+
+    int frame = 0;
+    state.run(100000, [&] {
+        const float t = static_cast<float>(frame);
+        const LMatrix4f mat = LMatrix4f::translate_mat(t, 0, 0);
+        const LVecBase3f pos(t, 1, 2);
+
+        if (use_handles)
+        {
+            block.update_input(inputs.view_mat_z_up, mat);
+            block.update_input(inputs.view_mat_billboard, mat);
+            block.update_input(inputs.last_view_proj_mat_no_jitter, mat);
+            block.update_input(inputs.last_inv_view_proj_mat_no_jitter, mat);
+            block.update_input(inputs.proj_mat, mat);
+            block.update_input(inputs.inv_proj_mat, mat);
+            block.update_input(inputs.view_proj_mat_no_jitter, mat);
+            block.update_input(inputs.vs_frustum_directions, mat);
+            block.update_input(inputs.ws_frustum_directions, mat);
+            block.update_input(inputs.camera_pos, pos);
+            block.update_input(inputs.frame_delta, t);
+            block.update_input(inputs.smooth_frame_delta, t);
+            block.update_input(inputs.frame_time, t);
+            block.update_input(inputs.current_film_offset, pos.get_xy());
+            block.update_input(inputs.frame_index, frame);
+            block.update_input(inputs.screen_size, LVecBase2i(1920, 1080));
+        }
+        else
+        {
+            block.update_input("view_mat_z_up", mat);
+            block.update_input("view_mat_billboard", mat);
+            block.update_input("last_view_proj_mat_no_jitter", mat);
+            block.update_input("last_inv_view_proj_mat_no_jitter", mat);
+            block.update_input("proj_mat", mat);
+            block.update_input("inv_proj_mat", mat);
+            block.update_input("view_proj_mat_no_jitter", mat);
+            block.update_input("vs_frustum_directions", mat);
+            block.update_input("ws_frustum_directions", mat);
+            block.update_input("camera_pos", pos);
+            block.update_input("frame_delta", t);
+            block.update_input("smooth_frame_delta", t);
+            block.update_input("frame_time", t);
+            block.update_input("current_film_offset", pos.get_xy());
+            block.update_input("frame_index", frame);
+            block.update_input("screen_size", LVecBase2i(1920, 1080));
+        }
+
+        ++frame;
+    });
+
+    state.set_items_per_iteration(static_cast<double>(num_scene_data_inputs));
+}
+
+// ************************************************************************************************
+
+static void bench_load_yaml_file(BenchState& state, BenchEnvironment&)
+{
+    const auto& config_files = list_files("/$$rpconfig", "yaml");
+    if (config_files.empty())
+    {
+        state.skip("No config files in /$$rpconfig.");
+        return;
+    }
+
+    state.run(10, [&] {
+        for (const auto& path: config_files)
+        {
+            YAML::Node node;
+            rplibs::load_yaml_file(path, node);
+        }
+    });
+
+    state.set_items_per_iteration(static_cast<double>(config_files.size()));
+}
+
+static void bench_load_yaml_file_flat(BenchState& state, BenchEnvironment&)
+{
+    state.run(10, [&] {
+        rplibs::load_yaml_file_flat("/$$rpconfig/pipeline.yaml");
+    });
+}
+
+// ************************************************************************************************
+
+static constexpr const char* sliced_texture_path = "/$$rp/rpplugins/color_correction/resources/film_luts/default_lut.png";
+static constexpr int sliced_texture_tile_size = 64;
+
+/**
+ * Loads a sliced 3D texture as RPLoader did before the slices were copied
+ * in memory: each slice is written as PNG to a ramdisk, and the 3D texture
+ * is loaded from the slices.
+ */
+static Texture* load_sliced_3d_texture_ramdisk(const Filename& filename, int tile_size_x, int tile_size_y, int num_tiles)
+{
+    double epoch_time = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::system_clock::now().time_since_epoch()).count();
+    const std::string tempfile_name = std::string("/$$slice_loader_temp-") + std::to_string(epoch_time) + "/";
+
+    PT(Texture) tex_handle = RPLoader::load_texture(filename);
+    PNMImage source;
+    tex_handle->store(source);
+    int width = source.get_x_size();
+
+    int num_cols = width / tile_size_x;
+    PNMImage temp_img(tile_size_x, tile_size_y, source.get_num_channels(), source.get_maxval());
+
+    VirtualFileSystem* vfs = VirtualFileSystem::get_global_ptr();
+    PT(VirtualFileMountRamdisk) ramdisk = new VirtualFileMountRamdisk;
+    vfs->mount(ramdisk, Filename(tempfile_name), 0);
+
+    for (int z_slice = 0; z_slice < num_tiles; ++z_slice)
+    {
+        int slice_x = (z_slice % num_cols) * tile_size_x;
+        int slice_y = (z_slice / num_cols) * tile_size_y;
+        temp_img.copy_sub_image(source, 0, 0, slice_x, slice_y, tile_size_x, tile_size_y);
+        temp_img.write(Filename(tempfile_name + std::to_string(z_slice) + ".png"));
+    }
+
+    Texture* texture_handle = RPLoader::load_3d_texture(Filename(tempfile_name + "/#.png"));
+    vfs->unmount(ramdisk);
+
+    return texture_handle;
+}
+
+enum class SlicedTextureLoader
+{
+    ramdisk,        ///< Previous implementation with PNG slices on a ramdisk.
+    copy,           ///< RPLoader without the txo cache.
+    cache,          ///< RPLoader with the txo cache of a previous run.
+};
+
+static void bench_load_sliced_3d_texture(BenchState& state, BenchEnvironment&, SlicedTextureLoader loader)
+{
+    if (!VirtualFileSystem::get_global_ptr()->exists(sliced_texture_path))
+    {
+        state.skip(std::string("No sliced texture at ") + sliced_texture_path);
+        return;
+    }
+
+    constexpr int size = sliced_texture_tile_size;
+
+    // fill the txo cache
+    RPLoader::load_sliced_3d_texture(sliced_texture_path, size);
+
+    // Each load starts with an empty texture pool, so the source image is
+    // decoded again as in the first load of a run.
+    state.run(1, [&] {
+        TexturePool::release_all_textures();
+        if (loader == SlicedTextureLoader::copy)
+            remove_files("/$$rptemp/texture_cache");
+    }, [&] {
+        if (loader == SlicedTextureLoader::ramdisk)
+            load_sliced_3d_texture_ramdisk(sliced_texture_path, size, size, size);
+        else
+            RPLoader::load_sliced_3d_texture(sliced_texture_path, size);
+    });
+
+    state.set_items_per_iteration(size);
+}
+
+// ************************************************************************************************
+
+enum class PointsUpload
+{
+    full,           ///< Set all positions and upload them, as before the ranges were tracked.
+    window,         ///< Write only the window through modify_positions.
+};
+
+/** Streams a window of new points into a point cloud, like a sensor. */
+static void bench_points_upload(BenchState& state, BenchEnvironment&, int point_count, PointsUpload upload)
+{
+    constexpr int window_size = 16384;
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+
+    std::vector<LPoint3> positions(point_count);
+    for (auto& pos: positions)
+        pos = LPoint3(dist(rng), dist(rng), dist(rng));
+
+    std::vector<LPoint3> window(window_size);
+    for (auto& pos: window)
+        pos = LPoint3(dist(rng), dist(rng), dist(rng));
+
+    PointsNode points("bench_points", positions, 1.0f, GeomEnums::UH_stream);
+
+    int window_begin = 0;
+    state.run(10, [&] {
+        if (upload == PointsUpload::full)
+        {
+            std::copy(window.begin(), window.end(), positions.begin() + window_begin);
+            points.set_positions(positions);
+        }
+        else
+        {
+            std::copy(window.begin(), window.end(), points.modify_positions(window_begin, window_size));
+        }
+
+        points.upload_positions();
+
+        window_begin += window_size;
+        if (window_begin + window_size > point_count)
+            window_begin = 0;
+    });
+
+    state.set_items_per_iteration(window_size);
+}
+
+/**
+ * Checks the ordering errors and the culling of a small stage graph, and then
+ * measures the compilation of a graph with many stages.
+ */
+static void bench_stage_graph_compile(BenchState& state, BenchEnvironment&)
+{
+    StageGraph graph;
+    const size_t gbuffer = graph.add_stage("GBufferStage", {}, {}, {"GBuffer"}, false);
+    const size_t depth = graph.add_stage("DownscaleZStage", {"GBuffer"}, {}, {"DownscaledDepth"}, false);
+    const size_t unused = graph.add_stage("UnusedStage", {"GBuffer"}, {}, {"UnusedPipe"}, false);
+    const size_t late_user = graph.add_stage("LateUserStage", {"LatePipe"}, {}, {"LateResult"}, false);
+    const size_t shading = graph.add_stage("ShadingStage", {"GBuffer", "DownscaledDepth", "LateResult"},
+        {"PreviousFrame::ShadedScene"}, {"ShadedScene"}, false);
+    const size_t late = graph.add_stage("LateStage", {"GBuffer"}, {}, {"LatePipe"}, false);
+    const size_t final_stage = graph.add_stage("FinalStage", {"ShadedScene"}, {}, {"ShadedScene"}, false);
+    const size_t display = graph.add_stage("DisplayStage", {"ShadedScene"}, {}, {}, false);
+    graph.compile();
+
+    const auto& nodes = graph.get_nodes();
+    state.check(nodes[shading].dependencies == std::vector<size_t>({gbuffer, depth, late_user}),
+        "ShadingStage depends on the producers of its pipes.");
+    state.check(nodes[display].dependencies == std::vector<size_t>({final_stage}),
+        "A pipe is resolved to its latest producer.");
+
+    const auto& errors = graph.get_ordering_errors();
+    state.check(errors.size() == 1 && errors[0].node == late_user && errors[0].pipe == "LatePipe" &&
+        errors[0].producer == late, "LatePipe is reported as produced by a later stage.");
+
+    state.check(graph.get_unused_nodes() == std::vector<size_t>({unused, late}),
+        "Only the stages whose pipes are not used are culled.");
+    state.check(nodes[final_stage].is_live && nodes[display].is_root, "The external pipes and the root stages are kept.");
+
+    // Chain of stages, where the odd stages except the last are not used.
+    constexpr int stage_count = 256;
+    std::vector<std::vector<std::string>> required_pipes(stage_count);
+    std::vector<std::vector<std::string>> produced_pipes(stage_count);
+    for (int k = 0; k < stage_count; ++k)
+    {
+        if (k > 0)
+            required_pipes[k].push_back(fmt::format("Pipe{}", (k - 1) & ~1));
+        produced_pipes[k].push_back(k + 1 == stage_count ? "ShadedScene" : fmt::format("Pipe{}", k));
+    }
+
+    size_t unused_count = 0;
+    state.run(100, [&] {
+        StageGraph chain;
+        for (int k = 0; k < stage_count; ++k)
+            chain.add_stage("Stage", required_pipes[k], {}, produced_pipes[k], false);
+        chain.compile();
+        unused_count = chain.get_unused_nodes().size();
+    });
+
+    state.check(unused_count == stage_count / 2 - 1, "The unused stages of the chain are culled.");
+    state.set_items_per_iteration(stage_count);
+}
+
+// ************************************************************************************************
+
+void register_core_benchmarks(std::vector<BenchCase>& cases)
+{
+    cases.push_back({"Effect/load/cold", [](BenchState& state, BenchEnvironment& env) {
+        bench_effect_load(state, env, EffectCacheState::cold, false);
+    }});
+    cases.push_back({"Effect/load/disk_cache", [](BenchState& state, BenchEnvironment& env) {
+        bench_effect_load(state, env, EffectCacheState::disk, false);
+    }});
+    cases.push_back({"Effect/load/memory_cache", [](BenchState& state, BenchEnvironment& env) {
+        bench_effect_load(state, env, EffectCacheState::memory, false);
+    }});
+    cases.push_back({"Effect/load_many/cold", [](BenchState& state, BenchEnvironment& env) {
+        bench_effect_load(state, env, EffectCacheState::cold, true);
+    }});
+
+    cases.push_back({"GroupedInputBlock/update_input/name", [](BenchState& state, BenchEnvironment& env) {
+        bench_input_block_update(state, env, false);
+    }});
+    cases.push_back({"GroupedInputBlock/update_input/handle", [](BenchState& state, BenchEnvironment& env) {
+        bench_input_block_update(state, env, true);
+    }});
+
+    cases.push_back({"StageGraph/compile", bench_stage_graph_compile});
+
+    cases.push_back({"rplibs/load_yaml_file/config", bench_load_yaml_file});
+    cases.push_back({"rplibs/load_yaml_file_flat/pipeline", bench_load_yaml_file_flat});
+
+    cases.push_back({"RPLoader/load_sliced_3d_texture/ramdisk_png", [](BenchState& state, BenchEnvironment& env) {
+        bench_load_sliced_3d_texture(state, env, SlicedTextureLoader::ramdisk);
+    }});
+    cases.push_back({"RPLoader/load_sliced_3d_texture/copy", [](BenchState& state, BenchEnvironment& env) {
+        bench_load_sliced_3d_texture(state, env, SlicedTextureLoader::copy);
+    }});
+    cases.push_back({"RPLoader/load_sliced_3d_texture/txo_cache", [](BenchState& state, BenchEnvironment& env) {
+        bench_load_sliced_3d_texture(state, env, SlicedTextureLoader::cache);
+    }});
+
+    for (const int point_count: {1000000, 10000000})
+    {
+        const std::string suffix = std::to_string(point_count / 1000000) + "M";
+        cases.push_back({"PointsNode/upload_positions/full/" + suffix, [point_count](BenchState& state, BenchEnvironment& env) {
+            bench_points_upload(state, env, point_count, PointsUpload::full);
+        }});
+        cases.push_back({"PointsNode/upload_positions/window/" + suffix, [point_count](BenchState& state, BenchEnvironment& env) {
+            bench_points_upload(state, env, point_count, PointsUpload::window);
+        }});
+    }
+}
+
+}
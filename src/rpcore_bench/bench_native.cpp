@@ -0,0 +1,407 @@
+/**
+ * Render Pipeline C++
+ *
+ * Copyright (c) 2016-2017 Center of Human-centered Interaction for Coexistence.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "bench.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+
+#include <pta_uchar.h>
+#include <deg_2_rad.h>
+
+#include <render_pipeline/rpcore/native/internal_light_manager.h>
+#include <render_pipeline/rpcore/native/ies_dataset.h>
+#include <render_pipeline/rpcore/native/pssm_camera_rig.h>
+#include <render_pipeline/rpcore/native/rp_point_light.h>
+#include <render_pipeline/rpcore/native/rp_spot_light.h>
+#include <render_pipeline/rpcore/native/tag_state_manager.h>
+
+namespace rpcore_bench {
+
+using namespace rpcore;
+
+// Slot storage of the lights, filled to a fixed load with every third slot freed.
+using LightSlotStorage = PointerSlotStorage<RPLight*, MAX_LIGHT_COUNT>;
+
+static std::unique_ptr<LightSlotStorage> make_fragmented_storage(std::vector<int>& used_slots)
+{
+    auto storage = std::make_unique<LightSlotStorage>();
+    RPLight* dummy = reinterpret_cast<RPLight*>(storage.get());
+
+    used_slots.clear();
+    for (int slot = 0; slot < 30000; ++slot)
+    {
+        if (slot % 3 == 0)
+            continue;
+        storage->reserve_slot(slot, dummy);
+        used_slots.push_back(slot);
+    }
+    return storage;
+}
+
+static void bench_slot_storage_find_slot(BenchState& state, BenchEnvironment&)
+{
+    std::vector<int> used_slots;
+    auto storage = make_fragmented_storage(used_slots);
+    RPLight* dummy = reinterpret_cast<RPLight*>(storage.get());
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> dist(0, used_slots.size() - 1);
+
+    state.run(100000, [&] {
+        // free a random slot, and reserve the first free slot instead
+        int& used_slot = used_slots[dist(rng)];
+        storage->free_slot(used_slot);
+
+        int slot;
+        if (storage->find_slot(slot))
+        {
+            storage->reserve_slot(slot, dummy);
+            used_slot = slot;
+        }
+    });
+}
+
+static void bench_slot_storage_find_consecutive_slots(BenchState& state, BenchEnvironment&)
+{
+    std::vector<int> used_slots;
+    auto storage = make_fragmented_storage(used_slots);
+    RPLight* dummy = reinterpret_cast<RPLight*>(storage.get());
+
+    // six consecutive slots, as the shadow sources of a point light
+    constexpr int num_consecutive = 6;
+
+    state.run(10000, [&] {
+        int slot;
+        if (storage->find_consecutive_slots(slot, num_consecutive))
+        {
+            for (int k = 0; k < num_consecutive; ++k)
+                storage->reserve_slot(slot + k, dummy);
+            storage->free_consecutive_slots(slot, num_consecutive);
+        }
+    });
+}
+
+// ************************************************************************************************
+
+/** Reserves a region of the size, or frees the region of the index. */
+struct AtlasOperation
+{
+    size_t tiles;
+    size_t free_index;
+};
+
+/**
+ * Generates an allocation trace like the light manager: shadow maps of
+ * 128 ~ 1024 pixels are reserved and freed, keeping the atlas about 70 % full.
+ */
+static std::vector<AtlasOperation> make_atlas_trace(size_t atlas_tiles, size_t num_operations)
+{
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> size_dist(0, 3);
+    std::uniform_real_distribution<float> unit_dist(0, 1);
+
+    std::vector<AtlasOperation> trace;
+    trace.reserve(num_operations);
+
+    size_t num_live = 0;
+    size_t used_tiles = 0;
+    std::vector<size_t> live_tiles;
+    for (size_t k = 0; k < num_operations; ++k)
+    {
+        const bool can_reserve = used_tiles < atlas_tiles * atlas_tiles * 7 / 10;
+        if (num_live == 0 || (can_reserve && unit_dist(rng) < 0.55f))
+        {
+            const size_t tiles = size_t(4) << size_dist(rng);
+            trace.push_back(AtlasOperation{tiles, 0});
+            live_tiles.push_back(tiles);
+            used_tiles += tiles * tiles;
+            ++num_live;
+        }
+        else
+        {
+            const size_t index = std::uniform_int_distribution<size_t>(0, num_live - 1)(rng);
+            trace.push_back(AtlasOperation{0, index});
+            used_tiles -= live_tiles[index] * live_tiles[index];
+            live_tiles[index] = live_tiles.back();
+            live_tiles.pop_back();
+            --num_live;
+        }
+    }
+
+    return trace;
+}
+
+static void bench_shadow_atlas(BenchState& state, BenchEnvironment&, ShadowAtlas::AllocationStrategy strategy)
+{
+    constexpr size_t atlas_size = 8192;
+    constexpr size_t tile_size = 32;
+
+    const auto& trace = make_atlas_trace(atlas_size / tile_size, 20000);
+
+    ShadowAtlas atlas(atlas_size, tile_size, strategy);
+    std::vector<LVecBase4i> live_regions;
+    live_regions.reserve(trace.size());
+
+    size_t num_failed = 0;
+    float max_coverage = 0;
+    float fragmentation = 0;
+
+    // The trace is replayed from an empty atlas in each iteration. The
+    // regions are freed in the same order as in the trace, so that the
+    // failed reservations do not change the trace.
+    state.run(5, [&] {
+        num_failed = 0;
+        max_coverage = 0;
+        live_regions.clear();
+
+        for (const auto& op: trace)
+        {
+            if (op.tiles > 0)
+            {
+                const LVecBase4i& region = atlas.find_and_reserve_region(op.tiles, op.tiles);
+                if (region.get_x() < 0)
+                    ++num_failed;
+                live_regions.push_back(region);
+                max_coverage = (std::max)(max_coverage, atlas.get_coverage());
+            }
+            else
+            {
+                const LVecBase4i region = live_regions[op.free_index];
+                live_regions[op.free_index] = live_regions.back();
+                live_regions.pop_back();
+                if (region.get_x() >= 0)
+                    atlas.free_region(region);
+            }
+        }
+
+        fragmentation = atlas.get_fragmentation();
+
+        for (const auto& region: live_regions)
+        {
+            if (region.get_x() >= 0)
+                atlas.free_region(region);
+        }
+    });
+
+    state.set_items_per_iteration(static_cast<double>(trace.size()));
+    state.set_counter("failed_reservations", static_cast<double>(num_failed));
+    state.set_counter("max_coverage", max_coverage);
+    state.set_counter("final_fragmentation", fragmentation);
+}
+
+// ************************************************************************************************
+
+static void bench_light_manager(BenchState& state, BenchEnvironment& env)
+{
+    if (!env.buffer)
+    {
+        state.skip("No offscreen buffer for the shadow cameras.");
+        return;
+    }
+
+    constexpr size_t num_point_lights = 2048;
+    constexpr size_t num_spot_lights = 512;
+    constexpr size_t num_moving_lights = 64;
+    constexpr size_t max_commands_per_frame = 1024;
+
+    TagStateManager tag_mgr(env.camera);
+
+    PT(ShadowManager) shadow_mgr = new ShadowManager;
+    shadow_mgr->set_max_updates(8);
+    shadow_mgr->set_scene(env.render);
+    shadow_mgr->set_tag_state_manager(&tag_mgr);
+    shadow_mgr->set_atlas_size(4096);
+    shadow_mgr->set_atlas_graphics_output(env.buffer);
+    shadow_mgr->init();
+
+    // The commands are written to memory instead of the command texture.
+    GPUCommandList cmd_list;
+    PTA_uchar command_buffer = PTA_uchar::empty_array(max_commands_per_frame * GPU_COMMAND_ENTRIES * sizeof(float));
+
+    InternalLightManager light_mgr;
+    light_mgr.set_command_list(&cmd_list);
+    light_mgr.set_shadow_manager(shadow_mgr);
+    light_mgr.set_shadow_update_distance(150.0f);
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> pos_dist(-500.0f, 500.0f);
+
+    std::vector<PT(RPLight)> lights;
+    lights.reserve(num_point_lights + num_spot_lights);
+    for (size_t k = 0; k < num_point_lights; ++k)
+    {
+        PT(RPPointLight) light = new RPPointLight;
+        light->set_pos(pos_dist(rng), pos_dist(rng), 5.0f);
+        light->set_radius(20.0f);
+        light->set_casts_shadows(k % 16 == 0);
+        light->set_shadow_map_resolution(256);
+        lights.push_back(light);
+    }
+    for (size_t k = 0; k < num_spot_lights; ++k)
+    {
+        PT(RPSpotLight) light = new RPSpotLight;
+        light->set_pos(pos_dist(rng), pos_dist(rng), 10.0f);
+        light->set_radius(40.0f);
+        light->set_fov(60.0f);
+        light->set_direction(0, 0, -1);
+        light->set_casts_shadows(k % 4 == 0);
+        light->set_shadow_map_resolution(512);
+        lights.push_back(light);
+    }
+
+    for (auto& light: lights)
+        light_mgr.add_light(light);
+
+    size_t frame = 0;
+    size_t num_commands = 0;
+    size_t num_skipped = 0;
+    auto update_frame = [&] {
+        // the camera moves through the scene, and some lights move with it
+        const float t = static_cast<float>(frame % 1000) / 1000.0f;
+        const LPoint3 camera_pos(-500.0f + 1000.0f * t, 0, 2.0f);
+        light_mgr.set_camera_pos(camera_pos);
+
+        for (size_t k = 0; k < num_moving_lights; ++k)
+        {
+            RPLight* light = lights[(frame * num_moving_lights + k) % lights.size()];
+            light->set_pos(light->get_pos() + LVecBase3f(0.1f, 0, 0));
+        }
+
+        light_mgr.update();
+        shadow_mgr->update();
+
+        while (cmd_list.get_num_commands() > 0)
+            num_commands += cmd_list.write_commands_to(command_buffer, max_commands_per_frame);
+
+        num_skipped += light_mgr.get_shadow_update_stats().num_skipped;
+        ++frame;
+    };
+
+    // send the initial light data before the measurement
+    update_frame();
+
+    state.run(200, [&] {
+        frame = 0;
+        num_commands = 0;
+        num_skipped = 0;
+    }, update_frame);
+
+    state.set_items_per_iteration(static_cast<double>(lights.size()));
+    state.set_counter("lights", static_cast<double>(light_mgr.get_num_lights()));
+    state.set_counter("shadow_sources", static_cast<double>(light_mgr.get_num_shadow_sources()));
+    state.set_counter("commands_per_frame", static_cast<double>(num_commands) / frame);
+    state.set_counter("skipped_shadow_updates_per_frame", static_cast<double>(num_skipped) / frame);
+    state.set_counter("atlas_coverage", shadow_mgr->get_atlas()->get_coverage());
+
+    for (auto& light: lights)
+        light_mgr.remove_light(light);
+
+    env.render.find_all_matches("ShadowCam-*").detach();
+    env.buffer->remove_all_display_regions();
+}
+
+// ************************************************************************************************
+
+static void bench_pssm_camera_rig(BenchState& state, BenchEnvironment& env)
+{
+    PSSMCameraRig rig(4);
+    rig.set_pssm_distance(200.0f);
+    rig.set_sun_distance(500.0f);
+    rig.set_resolution(2048);
+    rig.set_use_stable_csm(true);
+    rig.reparent_to(env.render);
+
+    size_t frame = 0;
+    state.run(10000, [&] {
+        // rotate the camera, so the splits are recomputed from a new frustum
+        env.camera.set_h(static_cast<float>(frame % 360));
+        rig.update(env.camera, LVecBase3(0.3f, 0.4f, 0.8f).normalized());
+        ++frame;
+    });
+
+    env.camera.set_h(0);
+    env.render.find_all_matches("pssm-cam-*").detach();
+}
+
+// ************************************************************************************************
+
+static void bench_ies_dataset(BenchState& state, BenchEnvironment&)
+{
+    // a synthetic type C profile with 2.5 degree vertical and 5 degree horizontal steps
+    constexpr size_t num_vertical = 73;
+    constexpr size_t num_horizontal = 72;
+
+    PTA_float vertical_angles = PTA_float::empty_array(num_vertical);
+    PTA_float horizontal_angles = PTA_float::empty_array(num_horizontal);
+    PTA_float candela_values = PTA_float::empty_array(num_vertical * num_horizontal);
+
+    for (size_t v = 0; v < num_vertical; ++v)
+        vertical_angles[v] = 2.5f * v;
+    for (size_t h = 0; h < num_horizontal; ++h)
+        horizontal_angles[h] = 5.0f * h;
+    for (size_t h = 0; h < num_horizontal; ++h)
+    {
+        for (size_t v = 0; v < num_vertical; ++v)
+        {
+            const float falloff = std::cos(deg_2_rad(vertical_angles[v]) * 0.5f);
+            candela_values[v + h * num_vertical] = falloff * falloff * (0.75f + 0.25f * std::cos(deg_2_rad(horizontal_angles[h]) * 2.0f));
+        }
+    }
+
+    IESDataset dataset;
+    dataset.set_vertical_angles(vertical_angles);
+    dataset.set_horizontal_angles(horizontal_angles);
+    dataset.set_candela_values(candela_values);
+
+    // same size as the IES storage of IESProfileLoader
+    PNMImage lut(512, 512, 1, 65535);
+
+    state.run(20, [&] {
+        dataset.generate_dataset_image(lut);
+    });
+
+    state.set_items_per_iteration(static_cast<double>(lut.get_x_size() * lut.get_y_size()));
+}
+
+// ************************************************************************************************
+
+void register_native_benchmarks(std::vector<BenchCase>& cases)
+{
+    cases.push_back({"PointerSlotStorage/find_slot", bench_slot_storage_find_slot});
+    cases.push_back({"PointerSlotStorage/find_consecutive_slots", bench_slot_storage_find_consecutive_slots});
+
+    cases.push_back({"ShadowAtlas/trace/tile_scan", [](BenchState& state, BenchEnvironment& env) {
+        bench_shadow_atlas(state, env, ShadowAtlas::AS_tile_scan);
+    }});
+    cases.push_back({"ShadowAtlas/trace/quadtree", [](BenchState& state, BenchEnvironment& env) {
+        bench_shadow_atlas(state, env, ShadowAtlas::AS_quadtree);
+    }});
+
+    cases.push_back({"InternalLightManager/update", bench_light_manager});
+
+    cases.push_back({"PSSMCameraRig/update", bench_pssm_camera_rig});
+    cases.push_back({"IESDataset/generate_dataset_image", bench_ies_dataset});
+}
+
+}
@@ -0,0 +1,187 @@
+/**
+ * Render Pipeline C++
+ *
+ * Copyright (c) 2016-2017 Center of Human-centered Interaction for Coexistence.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "bench.hpp"
+
+#include <thread>
+
+#include <eventHandler.h>
+
+#include <render_pipeline/rppanda/showbase/direct_object.hpp>
+#include <render_pipeline/rppanda/showbase/messenger.hpp>
+
+namespace rpcore_bench {
+
+using namespace rppanda;
+
+enum class EventKey
+{
+    name,
+    id,
+};
+
+static void bench_messenger_accept_ignore(BenchState& state, BenchEnvironment&, EventKey key)
+{
+    constexpr size_t object_count = 1000;
+
+    Messenger messenger;
+    const std::string event_name = "bench-accept";
+    const Messenger::EventID event_id = messenger.get_event_id(event_name);
+    std::vector<DirectObject> objects(object_count);
+
+    const Messenger::EventFunction func = [](const Event*) {};
+    state.run(10, [&] {
+        for (const auto& object: objects)
+        {
+            if (key == EventKey::name)
+                messenger.accept(event_name, func, &object);
+            else
+                messenger.accept(event_id, func, &object);
+        }
+        for (const auto& object: objects)
+        {
+            if (key == EventKey::name)
+                messenger.ignore(event_name, &object);
+            else
+                messenger.ignore(event_id, &object);
+        }
+    });
+
+    state.set_items_per_iteration(static_cast<double>(object_count * 2));
+}
+
+static void bench_messenger_send_direct(BenchState& state, BenchEnvironment&, EventKey key)
+{
+    constexpr size_t acceptor_count = 16;
+    constexpr size_t send_count = 10000;
+
+    Messenger messenger;
+    const std::string event_name = "bench-send-direct";
+    const Messenger::EventID event_id = messenger.get_event_id(event_name);
+    std::vector<DirectObject> objects(acceptor_count);
+
+    size_t num_called = 0;
+    for (const auto& object: objects)
+        messenger.accept(event_id, [&](const Event*) { ++num_called; }, &object);
+
+    state.run(10, [&] {
+        for (size_t k = 0; k < send_count; ++k)
+        {
+            if (key == EventKey::name)
+                messenger.send(event_name, EventParameter(static_cast<int>(k)));
+            else
+                messenger.send(event_id, EventParameter(static_cast<int>(k)));
+        }
+    });
+
+    state.set_items_per_iteration(static_cast<double>(send_count));
+    state.set_counter("acceptors", static_cast<double>(acceptor_count));
+    state.set_counter("calls", static_cast<double>(num_called));
+}
+
+/**
+ * Events are sent from @p thread_count threads and dispatched once, like a frame.
+ * By name, the events go through the queue of Panda3D EventHandler.
+ */
+static void bench_messenger_send_queued(BenchState& state, BenchEnvironment&, EventKey key, size_t thread_count)
+{
+    constexpr size_t acceptor_count = 16;
+    constexpr size_t send_count = 10000;
+
+    Messenger messenger;
+    const std::string event_name = "bench-send-queued";
+    const Messenger::EventID event_id = messenger.get_event_id(event_name);
+    std::vector<DirectObject> objects(acceptor_count);
+
+    size_t num_called = 0;
+    for (const auto& object: objects)
+        messenger.accept(event_id, [&](const Event*) { ++num_called; }, &object);
+
+    EventHandler* handler = EventHandler::get_global_event_handler();
+
+    const auto send_events = [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k)
+        {
+            if (key == EventKey::name)
+                messenger.send(event_name, EventParameter(static_cast<int>(k)), true);
+            else
+                messenger.send(event_id, EventParameter(static_cast<int>(k)), true);
+        }
+    };
+
+    state.run(10, [&] {
+        if (thread_count == 1)
+        {
+            send_events(0, send_count);
+        }
+        else
+        {
+            std::vector<std::thread> producers;
+            for (size_t t = 0; t < thread_count; ++t)
+                producers.emplace_back(send_events, send_count * t / thread_count, send_count * (t + 1) / thread_count);
+            for (auto& producer: producers)
+                producer.join();
+        }
+
+        if (key == EventKey::name)
+            handler->process_events();
+        else
+            messenger.process_queued_events();
+    });
+
+    state.set_items_per_iteration(static_cast<double>(send_count));
+    state.set_counter("acceptors", static_cast<double>(acceptor_count));
+    state.set_counter("threads", static_cast<double>(thread_count));
+    state.set_counter("calls", static_cast<double>(num_called));
+}
+
+// ************************************************************************************************
+
+void register_showbase_benchmarks(std::vector<BenchCase>& cases)
+{
+    cases.push_back({"Messenger/accept_ignore/name", [](BenchState& state, BenchEnvironment& env) {
+        bench_messenger_accept_ignore(state, env, EventKey::name);
+    }});
+    cases.push_back({"Messenger/accept_ignore/id", [](BenchState& state, BenchEnvironment& env) {
+        bench_messenger_accept_ignore(state, env, EventKey::id);
+    }});
+
+    cases.push_back({"Messenger/send/direct/name", [](BenchState& state, BenchEnvironment& env) {
+        bench_messenger_send_direct(state, env, EventKey::name);
+    }});
+    cases.push_back({"Messenger/send/direct/id", [](BenchState& state, BenchEnvironment& env) {
+        bench_messenger_send_direct(state, env, EventKey::id);
+    }});
+
+    // Panda3D EventQueue is drained on the main thread, so only one thread sends by name.
+    cases.push_back({"Messenger/send/queued/name", [](BenchState& state, BenchEnvironment& env) {
+        bench_messenger_send_queued(state, env, EventKey::name, 1);
+    }});
+    for (const size_t thread_count: {1, 4})
+    {
+        cases.push_back({"Messenger/send/queued/id/threads:" + std::to_string(thread_count), [thread_count](BenchState& state, BenchEnvironment& env) {
+            bench_messenger_send_queued(state, env, EventKey::id, thread_count);
+        }});
+    }
+}
+
+}
@@ -0,0 +1,206 @@
+/**
+ * Render Pipeline C++
+ *
+ * Copyright (c) 2016-2017 Center of Human-centered Interaction for Coexistence.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Headless CPU benchmarks of the render pipeline core.
+ *
+ * The benchmarks do not create ShowBase or a window, so they run on the
+ * machines without GPU. The results are written as JSON to the standard
+ * output or to the file of --output, and the progress to the standard error.
+ * Some benchmarks also check their results, and a failed check returns 1.
+ *
+ * Usage: rpcore_bench [--filter REGEX] [--repetitions N] [--output PATH]
+ *                     [--base-path PATH] [--list]
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <regex>
+
+#include <camera.h>
+#include <clockObject.h>
+#include <graphicsEngine.h>
+#include <graphicsPipeSelection.h>
+#include <load_prc_file.h>
+#include <perspectiveLens.h>
+
+#include <fmt/format.h>
+
+#include <render_pipeline/rpcore/globals.hpp>
+#include <render_pipeline/rpcore/mount_manager.hpp>
+#include <render_pipeline/rpcore/render_pipeline.hpp>
+
+#include "bench.hpp"
+
+using namespace rpcore_bench;
+
+/** Creates a small offscreen buffer of the software renderer, which does not need GPU. */
+static PT(GraphicsOutput) create_offscreen_buffer()
+{
+    GraphicsPipeSelection* selection = GraphicsPipeSelection::get_global_ptr();
+    PT(GraphicsPipe) pipe = selection->make_pipe("TinyOffscreenGraphicsPipe", "p3tinydisplay");
+    if (!pipe || !pipe->is_valid())
+        pipe = selection->make_module_pipe("p3tinydisplay");
+    if (!pipe || !pipe->is_valid())
+        return nullptr;
+
+    FrameBufferProperties fb_props;
+    fb_props.set_rgb_color(true);
+    fb_props.set_depth_bits(1);
+
+    return GraphicsEngine::get_global_ptr()->make_output(pipe, "rpcore_bench", 0, fb_props,
+        WindowProperties::size(64, 64), GraphicsPipe::BF_refuse_window);
+}
+
+int main(int argc, char* argv[])
+{
+    std::string filter;
+    size_t repetitions = 5;
+    std::string output_path;
+    std::string base_path;
+    std::string write_path;
+    bool list_only = false;
+
+    for (int k = 1; k < argc; ++k)
+    {
+        const std::string arg = argv[k];
+        const bool has_value = k + 1 < argc;
+        if (arg == "--filter" && has_value)
+            filter = argv[++k];
+        else if (arg == "--repetitions" && has_value)
+            repetitions = (std::max)(1, std::stoi(argv[++k]));
+        else if (arg == "--output" && has_value)
+            output_path = argv[++k];
+        else if (arg == "--base-path" && has_value)
+            base_path = argv[++k];
+        else if (arg == "--write-path" && has_value)
+            write_path = argv[++k];
+        else if (arg == "--list")
+            list_only = true;
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--filter REGEX] [--repetitions N] [--output PATH] [--base-path PATH] [--write-path PATH] [--list]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<BenchCase> cases;
+    register_native_benchmarks(cases);
+    register_core_benchmarks(cases);
+    register_showbase_benchmarks(cases);
+
+    const std::regex filter_regex(filter);
+    cases.erase(std::remove_if(cases.begin(), cases.end(), [&](const BenchCase& bench_case) {
+        return !std::regex_search(bench_case.name, filter_regex);
+    }), cases.end());
+
+    if (list_only)
+    {
+        for (const auto& bench_case: cases)
+            std::cout << bench_case.name << std::endl;
+        return 0;
+    }
+
+    // The pipeline is used for the mounts, the settings and the effects.
+    // It is not created, so there is no ShowBase and window.
+    BenchEnvironment env;
+    rpcore::RenderPipeline pipeline;
+    if (!base_path.empty())
+        pipeline.get_mount_mgr()->set_base_path(Filename::from_os_specific(base_path));
+
+    // The disk caches are used only on a write path, not on the ramdisk.
+    if (write_path.empty())
+        pipeline.get_mount_mgr()->set_write_path(Filename(Filename::get_temp_directory(), "rpcore_bench"));
+    else
+        pipeline.get_mount_mgr()->set_write_path(Filename::from_os_specific(write_path));
+    if (!pipeline.pre_showbase_init())
+    {
+        std::cerr << "Failed to initialize the pipeline." << std::endl;
+        return 1;
+    }
+    env.pipeline = &pipeline;
+
+    env.render = NodePath("render");
+    PT(PerspectiveLens) lens = new PerspectiveLens;
+    lens->set_near_far(0.1f, 1000.0f);
+    env.camera = env.render.attach_new_node(new Camera("camera", lens));
+
+    rpcore::Globals::render = env.render;
+    rpcore::Globals::clock = ClockObject::get_global_clock();
+
+    env.buffer = create_offscreen_buffer();
+    if (!env.buffer)
+        std::cerr << "The software renderer is not available, so the benchmarks with shadow cameras are skipped." << std::endl;
+
+    std::vector<BenchResult> results;
+    bool failed = false;
+    for (const auto& bench_case: cases)
+    {
+        std::cerr << bench_case.name << " ..." << std::flush;
+
+        BenchResult result;
+        result.name = bench_case.name;
+        BenchState state(result, repetitions);
+        bench_case.function(state, env);
+
+        if (result.failed)
+        {
+            std::cerr << " failed: " << result.error_message << std::endl;
+            failed = true;
+        }
+        else if (!result.error_message.empty())
+        {
+            std::cerr << " skipped: " << result.error_message << std::endl;
+        }
+        else
+        {
+            std::vector<double> sorted_ns = result.repetition_ns;
+            std::sort(sorted_ns.begin(), sorted_ns.end());
+            const double median_ns = sorted_ns.empty() ? 0.0 : sorted_ns[sorted_ns.size() / 2];
+            std::cerr << fmt::format(" {:.3f} us", median_ns / 1000.0) << std::endl;
+        }
+
+        results.push_back(std::move(result));
+    }
+
+    if (output_path.empty())
+    {
+        write_json(std::cout, results, repetitions);
+    }
+    else
+    {
+        std::ofstream output_file(output_path);
+        write_json(output_file, results, repetitions);
+        if (!output_file)
+        {
+            std::cerr << "Failed to write the results to " << output_path << std::endl;
+            return 1;
+        }
+    }
+
+    if (env.buffer)
+        GraphicsEngine::get_global_ptr()->remove_window(env.buffer);
+
+    rpcore::Globals::unload();
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,148 @@
+/**
+ * Render Pipeline C++
+ *
+ * Copyright (c) 2016-2017 Center of Human-centered Interaction for Coexistence.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "render_pipeline/rplibs/thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+namespace rplibs {
+
+ThreadPool& ThreadPool::get_global_pool()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::ThreadPool(size_t num_threads)
+{
+    if (num_threads == 0)
+    {
+        const size_t hardware_threads = std::thread::hardware_concurrency();
+        num_threads = hardware_threads > 1 ? hardware_threads - 1 : 0;
+    }
+
+    workers_.reserve(num_threads);
+    for (size_t k = 0; k < num_threads; ++k)
+        workers_.emplace_back(&ThreadPool::run_worker, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    condition_.notify_all();
+
+    for (auto& worker: workers_)
+        worker.join();
+}
+
+void ThreadPool::parallel_for(size_t count, size_t grain_size, const std::function<void(size_t, size_t)>& func)
+{
+    if (count == 0)
+        return;
+
+    grain_size = (std::max)(grain_size, size_t(1));
+    const size_t num_chunks = (count + grain_size - 1) / grain_size;
+
+    if (num_chunks == 1 || workers_.empty())
+    {
+        func(0, count);
+        return;
+    }
+
+    // The state is shared, because helpers may start after this call returned.
+    struct State
+    {
+        std::atomic<size_t> next_chunk{ 0 };
+        size_t finished_chunks = 0;
+        std::exception_ptr exception;
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+    auto state = std::make_shared<State>();
+
+    auto process_chunks = [state, count, grain_size, num_chunks, &func]() {
+        size_t chunk;
+        while ((chunk = state->next_chunk.fetch_add(1)) < num_chunks)
+        {
+            std::exception_ptr exception;
+            try
+            {
+                const size_t begin = chunk * grain_size;
+                func(begin, (std::min)(begin + grain_size, count));
+            }
+            catch (...)
+            {
+                exception = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (exception && !state->exception)
+                state->exception = exception;
+            if (++state->finished_chunks == num_chunks)
+                state->condition.notify_all();
+        }
+    };
+
+    // "func" is only used while chunks are left, and the chunks are finished before returning.
+    const size_t num_helpers = (std::min)(workers_.size(), num_chunks - 1);
+    for (size_t k = 0; k < num_helpers; ++k)
+        enqueue(process_chunks);
+
+    process_chunks();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->condition.wait(lock, [&state, num_chunks]() { return state->finished_chunks == num_chunks; });
+
+    if (state->exception)
+        std::rethrow_exception(state->exception);
+}
+
+void ThreadPool::enqueue(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(std::move(job));
+    }
+    condition_.notify_one();
+}
+
+void ThreadPool::run_worker()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+            if (jobs_.empty())
+                return;
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+        job();
+    }
+}
+
+}
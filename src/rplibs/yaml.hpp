@@ -26,18 +26,20 @@
 
 #include <yaml-cpp/yaml.h>
 
+#include <render_pipeline/rpcore/config.hpp>
+
 class Filename;
 
 namespace rplibs {
 
 /** This method is a wrapper arround yaml_load, and provides error checking. */
-bool load_yaml_file(const Filename& filename, YAML::Node& result);
+RENDER_PIPELINE_DECL bool load_yaml_file(const Filename& filename, YAML::Node& result);
 
 /**
  * Behaves like load_yaml_file, but instead of creating nested dictionaries
  * it connects keys via '.'.
  */
 using YamlFlatType = std::unordered_map<std::string, YAML::Node>;
-YamlFlatType load_yaml_file_flat(const Filename& filename);
+RENDER_PIPELINE_DECL YamlFlatType load_yaml_file_flat(const Filename& filename);
 
 }    // namespace rplibs
@@ -37,13 +37,12 @@
 
 #include "render_pipeline/rppanda/showbase/messenger.hpp"
 
+#include <algorithm>
+
 #include "rppanda/showbase/config_rppanda_showbase.hpp"
 
 namespace rppanda {
 
-const Messenger::AcceptorMap Messenger::empty_acceptor_;
-const Messenger::EventSetType Messenger::empty_events_;
-
 Messenger::Messenger() : handler_(EventHandler::get_global_event_handler())
 {
 }
@@ -51,6 +50,15 @@ Messenger::Messenger() : handler_(EventHandler::get_global_event_handler())
 Messenger::~Messenger()
 {
     clear();
+
+    // drop events which are not dispatched.
+    QueuedEvent* node = queue_head_.exchange(nullptr, std::memory_order_acquire);
+    while (node)
+    {
+        QueuedEvent* next = node->next;
+        delete node;
+        node = next;
+    }
 }
 
 Messenger* Messenger::get_global_instance()
@@ -59,67 +67,447 @@ Messenger* Messenger::get_global_instance()
     return &instance;
 }
 
+auto Messenger::get_event_id(const EventName& event_name) -> EventID
+{
+    std::lock_guard<std::mutex> lock(event_ids_mutex_);
+
+    const auto found = event_ids_.find(event_name);
+    if (found != event_ids_.end())
+        return found->second;
+
+    const EventID event_id = event_names_.size();
+    event_names_.push_back(event_name);
+    event_ids_.emplace(event_name, event_id);
+    return event_id;
+}
+
+auto Messenger::get_event_name(EventID event_id) const -> const EventName&
+{
+    std::lock_guard<std::mutex> lock(event_ids_mutex_);
+    return event_names_.at(event_id);
+}
+
+size_t Messenger::get_num_listners() const
+{
+    size_t count = 0;
+    for (const auto& callbacks: callbacks_)
+        count += callbacks.acceptors.size() - callbacks.num_removed;
+    return count;
+}
+
+size_t Messenger::get_num_listners(const EventName& event_name) const
+{
+    EventID event_id;
+    if (find_event_id(event_name, event_id))
+        return get_num_listners(event_id);
+    else
+        return 0;
+}
+
+size_t Messenger::get_num_listners(EventID event_id) const
+{
+    if (const auto callbacks = find_callbacks(event_id))
+        return callbacks->acceptors.size() - callbacks->num_removed;
+    else
+        return 0;
+}
+
 void Messenger::accept(const EventName& event_name, const EventFunction& method,
     const DirectObject* object, bool persistent)
+{
+    accept(get_event_id(event_name), method, object, persistent);
+}
+
+void Messenger::accept(EventID event_id, const EventFunction& method,
+    const DirectObject* object, bool persistent)
 {
     if (!object)
     {
-        rppanda_showbase_cat.error() << "Messenger::accept is called with null DirectObject: " << event_name << std::endl;
+        rppanda_showbase_cat.error() << "Messenger::accept is called with null DirectObject: " << get_event_name(event_id) << std::endl;
+        return;
+    }
+
+    auto& callbacks = get_callbacks(event_id);
+
+    // acceptors cannot be changed while they are called.
+    if (dispatch_depth_ > 0)
+    {
+        pending_accepts_.emplace_back(event_id, Acceptor{ object, method, persistent, false });
         return;
     }
 
-    add_hook(event_name);
+    add_acceptor(callbacks, Acceptor{ object, method, persistent, false });
+}
+
+void Messenger::ignore(const EventName& event_name, const DirectObject* object)
+{
+    EventID event_id;
+    if (find_event_id(event_name, event_id))
+        ignore(event_id, object);
+}
 
-    auto& object_callbacks = callbacks_[event_name];
+void Messenger::ignore(EventID event_id, const DirectObject* object)
+{
+    pending_accepts_.erase(std::remove_if(pending_accepts_.begin(), pending_accepts_.end(), [&](const std::pair<EventID, Acceptor>& pending) {
+        return pending.first == event_id && pending.second.object == object;
+    }), pending_accepts_.end());
 
-    auto found = object_callbacks.find(object);
-    if (found == object_callbacks.end())
+    if (event_id >= callbacks_.size())
+        return;
+
+    auto& callbacks = callbacks_[event_id];
+    const size_t index = find_acceptor(callbacks, object);
+    if (index < callbacks.acceptors.size())
+        remove_acceptor(callbacks, index);
+}
+
+void Messenger::ignore_all(const EventName& event_name)
+{
+    EventID event_id;
+    if (find_event_id(event_name, event_id))
+        ignore_all(event_id);
+}
+
+void Messenger::ignore_all(EventID event_id)
+{
+    pending_accepts_.erase(std::remove_if(pending_accepts_.begin(), pending_accepts_.end(), [&](const std::pair<EventID, Acceptor>& pending) {
+        return pending.first == event_id;
+    }), pending_accepts_.end());
+
+    if (event_id >= callbacks_.size())
+        return;
+
+    auto& callbacks = callbacks_[event_id];
+    for (size_t k = callbacks.acceptors.size(); k-- > 0;)
     {
-        object_callbacks.emplace(object, AcceptorType{ method, persistent });
+        if (!callbacks.acceptors[k].removed)
+            remove_acceptor(callbacks, k);
     }
-    else
+}
+
+void Messenger::ignore_all(const DirectObject* object)
+{
+    pending_accepts_.erase(std::remove_if(pending_accepts_.begin(), pending_accepts_.end(), [&](const std::pair<EventID, Acceptor>& pending) {
+        return pending.second.object == object;
+    }), pending_accepts_.end());
+
+    auto found = object_events_.find(object);
+    if (found == object_events_.end())
+        return;
+
+    // remove_acceptor modifies the list of the object.
+    const std::vector<EventID> event_ids = found->second;
+    for (const auto event_id: event_ids)
     {
-        if (rppanda_showbase_cat.is_debug())
-            rppanda_showbase_cat.warning() << "object: Messenger accept: \"" << event_name << "\" new callback" << std::endl;
+        auto& callbacks = callbacks_[event_id];
+        const size_t index = find_acceptor(callbacks, object);
+        if (index < callbacks.acceptors.size())
+            remove_acceptor(callbacks, index);
+    }
+}
+
+auto Messenger::get_all_accepting(const DirectObject* object) const -> EventSetType
+{
+    EventSetType events;
 
-        found->second = AcceptorType{ method, persistent };
+    auto found = object_events_.find(object);
+    if (found != object_events_.end())
+    {
+        for (const auto event_id: found->second)
+            events.insert(*callbacks_[event_id].event_name);
     }
 
-    object_events_[object].insert(event_name);
+    return events;
 }
 
-auto Messenger::who_accepts(const EventName& event_name) const -> const AcceptorMap&
+bool Messenger::is_accepting(const EventName& event_name, const DirectObject* object) const
 {
-    auto found = callbacks_.find(event_name);
-    if (found != callbacks_.end())
-        return found->second;
+    EventID event_id;
+    if (find_event_id(event_name, event_id))
+        return is_accepting(event_id, object);
     else
-        return empty_acceptor_;
+        return false;
 }
 
-void Messenger::process_event(const Event* ev, void* user_data)
+bool Messenger::is_accepting(EventID event_id, const DirectObject* object) const
+{
+    if (const auto callbacks = find_callbacks(event_id))
+        return find_acceptor(*callbacks, object) < callbacks->acceptors.size();
+    else
+        return false;
+}
+
+auto Messenger::who_accepts(const EventName& event_name) const -> AcceptorMap
+{
+    AcceptorMap acceptor_map;
+
+    EventID event_id;
+    if (!find_event_id(event_name, event_id))
+        return acceptor_map;
+
+    if (const auto callbacks = find_callbacks(event_id))
+    {
+        for (const auto& acceptor: callbacks->acceptors)
+        {
+            if (!acceptor.removed)
+                acceptor_map.emplace(acceptor.object, AcceptorType{ acceptor.function, acceptor.persistent });
+        }
+    }
+
+    return acceptor_map;
+}
+
+size_t Messenger::process_queued_events()
 {
-    const auto& event_name = ev->get_name();
+    QueuedEvent* node = queue_head_.exchange(nullptr, std::memory_order_acquire);
+    if (!node)
+        return 0;
 
-    auto self = reinterpret_cast<Messenger*>(user_data);
-    auto& acceptor_map = self->callbacks_.at(event_name);
+    // the queue is LIFO, so reverse it to sending order.
+    QueuedEvent* ordered = nullptr;
+    size_t count = 0;
+    while (node)
+    {
+        QueuedEvent* next = node->next;
+        node->next = ordered;
+        ordered = node;
+        node = next;
+        ++count;
+    }
 
-    // call in object_callbacks
+    // acceptors changed by the events are applied once after the batch.
+    ++dispatch_depth_;
+    for (node = ordered; node;)
     {
-        auto iter = acceptor_map.cbegin();
-        auto iter_end = acceptor_map.cend();
-        for (; iter != iter_end; ++iter)
+        if (node->event_id < callbacks_.size())
         {
-            iter->second.first(ev);
+            auto& callbacks = callbacks_[node->event_id];
+            if (callbacks.acceptors.size() > callbacks.num_removed)
+            {
+                node->event->set_name(*callbacks.event_name);
+                dispatch(callbacks, node->event);
+            }
+        }
+
+        QueuedEvent* next = node->next;
+        delete node;
+        node = next;
+    }
+    if (--dispatch_depth_ == 0)
+        flush_pending();
 
-            // NOTE: the erased element is only invalidated, so we can use the iterator.
-            if (!iter->second.second)
-                acceptor_map.erase(iter);
+    return count;
+}
+
+void Messenger::clear()
+{
+    pending_accepts_.clear();
+    for (auto& callbacks: callbacks_)
+    {
+        for (size_t k = callbacks.acceptors.size(); k-- > 0;)
+        {
+            if (!callbacks.acceptors[k].removed)
+                remove_acceptor(callbacks, k);
         }
     }
+    object_events_.clear();
+}
+
+auto Messenger::get_events() const -> std::vector<EventName>
+{
+    std::vector<EventName> events;
+    for (const auto& callbacks: callbacks_)
+    {
+        if (callbacks.acceptors.size() > callbacks.num_removed)
+            events.push_back(*callbacks.event_name);
+    }
+    return events;
+}
+
+void Messenger::process_event(const Event* ev, void* user_data)
+{
+    auto callbacks = reinterpret_cast<EventCallbacks*>(user_data);
+    callbacks->messenger->dispatch(*callbacks, ev);
+}
+
+bool Messenger::find_event_id(const EventName& event_name, EventID& event_id) const
+{
+    std::lock_guard<std::mutex> lock(event_ids_mutex_);
+
+    const auto found = event_ids_.find(event_name);
+    if (found == event_ids_.end())
+        return false;
+
+    event_id = found->second;
+    return true;
+}
+
+auto Messenger::find_callbacks(EventID event_id) const -> const EventCallbacks*
+{
+    if (event_id < callbacks_.size())
+        return &callbacks_[event_id];
+    else
+        return nullptr;
+}
+
+auto Messenger::get_callbacks(EventID event_id) -> EventCallbacks&
+{
+    while (callbacks_.size() <= event_id)
+    {
+        callbacks_.emplace_back();
+        auto& callbacks = callbacks_.back();
+        callbacks.messenger = this;
+        callbacks.event_id = callbacks_.size() - 1;
+        callbacks.event_name = &get_event_name(callbacks.event_id);
+    }
+    return callbacks_[event_id];
+}
+
+size_t Messenger::find_acceptor(const EventCallbacks& callbacks, const DirectObject* object) const
+{
+    const auto& acceptors = callbacks.acceptors;
+    for (size_t k = 0, k_end = acceptors.size(); k < k_end; ++k)
+    {
+        if (acceptors[k].object == object && !acceptors[k].removed)
+            return k;
+    }
+    return acceptors.size();
+}
+
+void Messenger::add_acceptor(EventCallbacks& callbacks, Acceptor&& acceptor)
+{
+    const size_t index = find_acceptor(callbacks, acceptor.object);
+    if (index == callbacks.acceptors.size())
+    {
+        object_events_[acceptor.object].push_back(callbacks.event_id);
+        callbacks.acceptors.push_back(std::move(acceptor));
+    }
+    else
+    {
+        if (rppanda_showbase_cat.is_debug())
+            rppanda_showbase_cat.warning() << "object: Messenger accept: \"" << *callbacks.event_name << "\" new callback" << std::endl;
+
+        callbacks.acceptors[index] = std::move(acceptor);
+    }
+
+    add_hook(callbacks);
+}
+
+void Messenger::remove_acceptor(EventCallbacks& callbacks, size_t index)
+{
+    auto& acceptor = callbacks.acceptors[index];
+
+    auto found = object_events_.find(acceptor.object);
+    if (found != object_events_.end())
+    {
+        auto& event_ids = found->second;
+        auto id_found = std::find(event_ids.begin(), event_ids.end(), callbacks.event_id);
+        if (id_found != event_ids.end())
+            event_ids.erase(id_found);
+        if (event_ids.empty())
+            object_events_.erase(found);
+    }
+
+    // the function may be running now, so it is removed after dispatching.
+    if (dispatch_depth_ > 0)
+    {
+        acceptor.removed = true;
+        if (callbacks.num_removed++ == 0)
+            dirty_events_.push_back(callbacks.event_id);
+        return;
+    }
+
+    callbacks.acceptors.erase(callbacks.acceptors.begin() + index);
+    if (callbacks.acceptors.empty())
+        remove_hook(callbacks);
+}
+
+void Messenger::dispatch(EventCallbacks& callbacks, const Event* ev)
+{
+    ++dispatch_depth_;
+
+    // acceptors added during dispatching are pending, so the size is not changed.
+    for (size_t k = 0, k_end = callbacks.acceptors.size(); k < k_end; ++k)
+    {
+        auto& acceptor = callbacks.acceptors[k];
+        if (acceptor.removed)
+            continue;
+
+        if (!acceptor.persistent)
+            remove_acceptor(callbacks, k);
+
+        acceptor.function(ev);
+    }
+
+    if (--dispatch_depth_ == 0)
+        flush_pending();
+}
+
+void Messenger::flush_pending()
+{
+    for (const auto event_id: dirty_events_)
+        compact(callbacks_[event_id]);
+    dirty_events_.clear();
+
+    if (pending_accepts_.empty())
+        return;
+
+    auto pending_accepts = std::move(pending_accepts_);
+    pending_accepts_.clear();
+    for (auto& pending: pending_accepts)
+        add_acceptor(callbacks_[pending.first], std::move(pending.second));
+}
+
+void Messenger::send_event(EventID event_id, Event* ev, bool queuing)
+{
+    if (queuing)
+    {
+        auto node = new QueuedEvent{ event_id, ev, queue_head_.load(std::memory_order_relaxed) };
+        while (!queue_head_.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+            ;
+        return;
+    }
+
+    PT(Event) holder = ev;
+    if (event_id >= callbacks_.size())
+        return;
+
+    auto& callbacks = callbacks_[event_id];
+    if (callbacks.acceptors.size() > callbacks.num_removed)
+    {
+        ev->set_name(*callbacks.event_name);
+        dispatch(callbacks, ev);
+    }
+}
+
+void Messenger::compact(EventCallbacks& callbacks)
+{
+    auto& acceptors = callbacks.acceptors;
+    acceptors.erase(std::remove_if(acceptors.begin(), acceptors.end(), [](const Acceptor& acceptor) {
+        return acceptor.removed;
+    }), acceptors.end());
+    callbacks.num_removed = 0;
+
+    if (acceptors.empty())
+        remove_hook(callbacks);
+}
+
+void Messenger::add_hook(EventCallbacks& callbacks)
+{
+    if (callbacks.hooked)
+        return;
+
+    handler_->add_hook(*callbacks.event_name, &Messenger::process_event, &callbacks);
+    callbacks.hooked = true;
+}
+
+void Messenger::remove_hook(EventCallbacks& callbacks)
+{
+    if (!callbacks.hooked)
+        return;
 
-    if (acceptor_map.empty())
-        self->remove_hook(event_name);
+    handler_->remove_hook(*callbacks.event_name, &Messenger::process_event, &callbacks);
+    callbacks.hooked = false;
 }
 
 }
@@ -61,6 +61,7 @@ namespace rppanda {
 class ShowBase::Impl
 {
 public:
+    AsyncTask::DoneStatus messenger_loop();
     AsyncTask::DoneStatus ival_loop();
     AsyncTask::DoneStatus audio_loop();
 
@@ -182,6 +183,13 @@ public:
 
 ShowBase* ShowBase::Impl::global_ptr = nullptr;
 
+AsyncTask::DoneStatus ShowBase::Impl::messenger_loop()
+{
+    // Dispatch the events queued by Messenger::send with EventID.
+    messenger_->process_queued_events();
+    return AsyncTask::DS_cont;
+}
+
 AsyncTask::DoneStatus ShowBase::Impl::ival_loop()
 {
     // Execute all intervals in the global ivalMgr.
@@ -1163,6 +1171,10 @@ void ShowBase::restart()
     // so that it will get run before most tasks
     add_task(impl_->task_data_loop_, "data_loop", -50);
 
+    // the messengerLoop dispatches the events queued from other threads
+    // once per frame, like the eventManager.
+    add_task(std::bind(&Impl::messenger_loop, impl_.get()), "messenger_loop", 0);
+
     // spawn the ivalLoop with a later sort, so that it will
     // run after most tasks, but before igLoop.
     add_task(std::bind(&Impl::ival_loop, impl_.get()), "ival_loop", 20);
@@ -1177,6 +1189,7 @@ void ShowBase::shutdown()
     rppanda_showbase_cat.debug() << "Shutdown ShowBase ..." << std::endl;
 
     impl_->task_mgr_->remove("data_loop");
+    impl_->task_mgr_->remove("messenger_loop");
     impl_->task_mgr_->remove("audio_loop");
     impl_->task_mgr_->remove("ival_loop");
 }
@@ -68,6 +68,8 @@ public:
     std::shared_ptr<rpcore::SimpleInputBlock> data_ubo_;
 
     EnvironmentCaptureStage* capture_stage_;
+
+    rpcore::TaskScheduler::TaskID task_select_;
 };
 
 EnvProbesPlugin::RequrieType EnvProbesPlugin::Impl::require_plugins_;
@@ -93,6 +95,8 @@ void EnvProbesPlugin::Impl::on_stage_setup()
     probe_mgr_->set_max_probes(self_.get_setting<rpcore::IntType>("max_probes"));
     probe_mgr_->init();
 
+    task_select_ = self_.pipeline_.get_task_scheduler()->get_task_id("envprobes_select_and_cull");
+
     setup_stages();
 }
 
@@ -171,7 +175,8 @@ void EnvProbesPlugin::on_prepare_scene(NodePath scene)
 
 void EnvProbesPlugin::on_pre_render_update()
 {
-    if (pipeline_.get_task_scheduler()->is_scheduled("envprobes_select_and_cull"))
+    auto task_scheduler = pipeline_.get_task_scheduler();
+    if (task_scheduler->is_scheduled(impl_->task_select_))
     {
         impl_->probe_mgr_->update();
         impl_->pta_probes_[0] = impl_->probe_mgr_->get_num_probes();
@@ -95,6 +95,12 @@ void PSSMDistShadowStage::create()
 
     // Register shadow camera
     pipeline_.get_tag_mgr()->register_camera("shadow", _camera);
+
+    auto task_scheduler = pipeline_.get_task_scheduler();
+    _task_shadows = task_scheduler->get_task_id("pssm_distant_shadows");
+    _task_convert = task_scheduler->get_task_id("pssm_convert_distant_to_esm");
+    _task_blur_v = task_scheduler->get_task_id("pssm_blur_distant_vert");
+    _task_blur_h = task_scheduler->get_task_id("pssm_blur_distant_horiz");
 }
 
 void PSSMDistShadowStage::update()
@@ -105,9 +111,10 @@ void PSSMDistShadowStage::update()
     _target_blur_h->set_active(false);
 
     const auto& mvp = get_mvp();
+    const auto task_scheduler = pipeline_.get_task_scheduler();
 
     // Query scheduled tasks
-    if (pipeline_.get_task_scheduler()->is_scheduled("pssm_distant_shadows"))
+    if (task_scheduler->is_scheduled(_task_shadows))
     {
         _target->set_active(true);
 
@@ -120,13 +127,13 @@ void PSSMDistShadowStage::update()
         rpcore::snap_shadow_map(mvp, _cam_node, _resolution);
     }
 
-    if (pipeline_.get_task_scheduler()->is_scheduled("pssm_convert_distant_to_esm"))
+    if (task_scheduler->is_scheduled(_task_convert))
         _target_convert->set_active(true);
 
-    if (pipeline_.get_task_scheduler()->is_scheduled("pssm_blur_distant_vert"))
+    if (task_scheduler->is_scheduled(_task_blur_v))
         _target_blur_v->set_active(true);
 
-    if (pipeline_.get_task_scheduler()->is_scheduled("pssm_blur_distant_horiz"))
+    if (task_scheduler->is_scheduled(_task_blur_h))
     {
         _target_blur_h->set_active(true);
 
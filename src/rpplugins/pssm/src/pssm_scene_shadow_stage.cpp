@@ -94,11 +94,13 @@ void PSSMSceneShadowStage::create()
 
     // Register shadow camera
     pipeline_.get_tag_mgr()->register_camera("shadow", _camera);
+
+    _task_shadows = pipeline_.get_task_scheduler()->get_task_id("pssm_scene_shadows");
 }
 
 void PSSMSceneShadowStage::update()
 {
-    if (pipeline_.get_task_scheduler()->is_scheduled("pssm_scene_shadows"))
+    if (pipeline_.get_task_scheduler()->is_scheduled(_task_shadows))
     {
         if (!_focus)
         {